@@ -1,7 +1,11 @@
 #ifndef COMMAND_H
 #define COMMAND_H
 
+#include <CCommandResult.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <future>
 #include <string>
 #include <vector>
 #include <list>
@@ -15,6 +19,17 @@ class CCommandPipe;
 class CCommandSrc;
 class CCommandDest;
 class CCommandPipeDest;
+class CCommandTeeDest;
+class CCommandCallbackDest;
+class CCommandTailDest;
+class CCommandCompressDest;
+class CCommandMapFileSrc;
+class CCommandBufferSrc;
+class CCommandGeneratorSrc;
+class CCommandRangeFileSrc;
+class CCommandStdio;
+class CCommandOutputDest;
+class CCommandThreadJob;
 
 class CCommand {
  public:
@@ -25,6 +40,12 @@ class CCommand {
   using CallbackData = void *;
   using CallbackProc = void (*)(const Args &args, CallbackData data);
 
+  // thread command run on a pool thread with private stdio (returns exit code)
+  using ThreadProc = int (*)(const Args &args, CCommandStdio &stdio, CallbackData data);
+
+  // builtin command run on a pool thread with private stdio fds (returns exit code)
+  using BuiltinProc = int (*)(const Args &args, int in, int out, int err);
+
   enum class State {
     NONE,
     IDLE,
@@ -43,6 +64,9 @@ class CCommand {
   CCommand(const std::string &name, CallbackProc proc, CallbackData data,
            const Args &args=Args(), bool doFork=false);
 
+  CCommand(const std::string &name, ThreadProc proc, CallbackData data,
+           const Args &args=Args());
+
   virtual ~CCommand();
 
   const std::string &getName() const { return name_; }
@@ -51,12 +75,24 @@ class CCommand {
   uint getId() const { return id_; }
   void setId(uint id) { id_ = id; }
 
-  bool getDoFork() const { return doFork_; }
+  // thread commands are handled by srcs/dests like forked commands (thread
+  // gets private copies of child fds, parent side processed as after fork)
+  bool getDoFork() const { return (doFork_ || isThread()); }
   void setDoFork(bool doFork) { doFork_ = doFork; }
 
+  // allow command to be run as registered builtin (see CCommandMgr::addBuiltin)
+  bool getAllowBuiltin() const { return allowBuiltin_; }
+  void setAllowBuiltin(bool allow) { allowBuiltin_ = allow; }
+
+  bool isBuiltin() const { return (builtinProc_ != nullptr); }
+
+  bool isThread() const { return (threadProc_ || builtinProc_); }
+
   CallbackProc getCallbackProc() const { return callbackProc_; }
   CallbackData getCallbackData() const { return callbackData_; }
 
+  ThreadProc getThreadProc() const { return threadProc_; }
+
   const Args        &getArgs  ()      const { return args_; }
   int               getNumArgs()      const { return int(args_.size()); }
   const std::string &getArg   (int i) const { assert(i >= 0); return args_[size_t(i)]; }
@@ -65,6 +101,9 @@ class CCommand {
 
   pid_t getPid() const { return pid_ ; }
 
+  // process group (0 if not set)
+  pid_t getProcessGroupId() const { return pgid_; }
+
   bool isChild() const { return child_; }
 
   State getState() const { return state_; }
@@ -74,10 +113,24 @@ class CCommand {
 
   int getSignalNum() const { return signalNum_ ; }
 
+  // resource usage of reaped process (only user/system time for thread command)
+  const rusage &getUsage() const { return usage_; }
+
   std::string getCommandString() const;
 
+  // command whose callback or thread proc is running on this thread (so a
+  // callback can reach its srcs, e.g. the mapped file of getMapFileSrc)
+  static CCommand *getCurrent();
+
   //---
 
+  // add source/dest object (command takes ownership)
+  void addSrc (CCommandSrc  *src );
+  void addDest(CCommandDest *dest);
+
+  const SrcList  &getSrcs () const { return srcList_ ; }
+  const DestList &getDests() const { return destList_; }
+
   // add source (file, pipe output, string)
   void addFileSrc(const std::string &filename);
   void addFileSrc(FILE *fp);
@@ -86,6 +139,24 @@ class CCommand {
 
   void addStringSrc(const std::string &str);
 
+  // add memory mapped file source (data passed directly to callback command)
+  CCommandMapFileSrc *addMapFileSrc(const std::string &filename);
+
+  // first memory mapped file source (nullptr if none)
+  CCommandMapFileSrc *getMapFileSrc() const;
+
+  // add source from list of caller owned buffers (added to returned source)
+  CCommandBufferSrc *addBufferSrc();
+
+  // add source which pulls stdin data from generator (returns 0 at end)
+  using SrcGeneratorProc = size_t (*)(char *buffer, size_t size, CallbackData data);
+
+  CCommandGeneratorSrc *addGeneratorSrc(SrcGeneratorProc proc, CallbackData data);
+
+  // add source from record aligned byte range of file
+  CCommandRangeFileSrc *addRangeFileSrc(const std::string &filename, off_t start,
+                                        off_t end, char delim='\n');
+
   // add dest (file, pipe input, string)
   void addFileDest(const std::string &filename, int fd=1);
   void addFileDest(FILE *fp, int fd=1);
@@ -94,24 +165,59 @@ class CCommand {
 
   void addStringDest(std::string &str, int fd=1);
 
+  // add dest which fans out to several pipes, files and strings
+  CCommandTeeDest *addTeeDest(int fd=1);
+
+  // add dest which passes output chunks (or lines) to callback as they arrive
+  using DestCallbackProc = void (*)(const char *buffer, size_t len, CallbackData data);
+
+  CCommandCallbackDest *addCallbackDest(DestCallbackProc proc, CallbackData data,
+                                        bool lines=false, int fd=1);
+
+  // add dest which keeps only first headSize and last tailSize bytes of output
+  CCommandTailDest *addTailDest(std::string &str, size_t tailSize,
+                                size_t headSize=0, int fd=1);
+
+  // add dest whose output is read by the caller from a non-blocking pipe
+  CCommandOutputDest *addOutputDest(int fd=1);
+
+  // add dest which writes gzip (or zstd) compressed output to file
+  CCommandCompressDest *addCompressFileDest(const std::string &filename, int level=-1,
+                                            bool zstd=false, int fd=1);
+
   //--
 
   // set dest overwrite/depend
   void setFileDestOverwrite(bool overwrite, int fd=1);
   void setFileDestAppend(bool append, int fd=1);
 
+  // set dest sink mode (see CCommandFileDest::setSinkMode)
+  void setFileDestSinkMode(bool sinkMode, off_t sizeHint=0, int fd=1);
+
   //---
 
   void start ();
   void stop  ();
   void tstop ();
-  void pause ();
-  void resume();
-  void wait  ();
 
-  void waitpid();
+  // stop/continue command (and its process group if group is true)
+  void pause (bool group=false);
+  void resume(bool group=false);
+
+  // wait for command to exit (or stop), if the command was reaped by the
+  // SIGCHLD handler its sources and destinations are terminated here
+  void wait    ();
+  void waitpid ();
   void waitpgid();
 
+  // check if command has exited without blocking (terminates it if so)
+  bool tryWait();
+
+  // start command and return future set (by the CCommandMgr reaper thread)
+  // when it has exited, optionally capturing stdout/stderr in the result.
+  // Command must not be waited for or deleted until the future is ready.
+  std::future<CCommandResult> startAsync(bool captureOutput=false, bool captureError=false);
+
   void setProcessGroupLeader();
   void setProcessGroup(CCommand *command);
 
@@ -134,6 +240,9 @@ class CCommand {
   void initChildSrcs();
   void initChildDests();
 
+  void initThreadSrcs();
+  void initThreadDests();
+
   void processSrcs();
   void processDests();
 
@@ -152,19 +261,38 @@ class CCommand {
 
   void setForegroundProcessGroup();
 
+  void processStatus(int status, bool inSignal);
+
+  void exited(bool inSignal);
+  void termPending();
+
+  bool reapAsync();
+
+  void startThread();
+  void waitThread();
+
+  static void runThread(void *data);
+
   static void signalChild  (int sig);
   static void signalGeneric(int sig);
   static void signalStop   (int sig);
 
-  static void wait_pid(pid_t pid, bool nohang);
+  void reapProcess(bool nohang);
+
+  static void wait_pgid(pid_t pgid);
 
  private:
+  friend class CCommandReaper;
+  friend class CCommandPipeline;
+  friend class CCommandScheduler;
+
   std::string  name_;
   std::string  path_;
   uint         id_           { 0 };
   bool         doFork_       { false };
   CallbackProc callbackProc_ { nullptr };
   CallbackData callbackData_ { nullptr };
+  ThreadProc   threadProc_   { nullptr };
   Args         args_;
   pid_t        pid_          { 0 };
   pid_t        pgid_         { 0 };
@@ -172,9 +300,19 @@ class CCommand {
   uint         groupId_      { 0 };
   bool         child_        { false };
 
-  State        state_        { State::NONE };
-  int          returnCode_   { -1 };
-  int          signalNum_    { -1 };
+  State             state_        { State::NONE };
+  int               returnCode_   { -1 };
+  int               signalNum_    { -1 };
+  bool              termPending_  { false };
+  bool              allowBuiltin_ { true };
+  BuiltinProc       builtinProc_  { nullptr };
+  std::atomic<bool> async_        { false }; // read by SIGCHLD handler on any thread
+  std::atomic<bool> reaping_      { false }; // claimed by thread reaping process
+  rusage            usage_        { };
+
+  CCommandStdio     *stdio_     { nullptr };
+  CCommandThreadJob *threadJob_ { nullptr };
+  int                threadRc_  { 0 };
 
   SrcList      srcList_;
   DestList     destList_;
@@ -0,0 +1,42 @@
+#ifndef CCommandBufferSrc_H
+#define CCommandBufferSrc_H
+
+#include <CCommandStreamSrc.h>
+#include <vector>
+#include <sys/uio.h>
+
+// Source which writes a list of caller owned buffers to the command's stdin
+// (writev, or vmsplice on linux) from the stream thread, so any amount of
+// data can be fed before the reader starts. Buffers are not copied so must
+// stay valid and unchanged until the command has exited.
+class CCommandBufferSrc : public CCommandStreamSrc {
+ public:
+  CCommandBufferSrc(CCommand *command);
+
+ ~CCommandBufferSrc();
+
+  void addBuffer(const char *data, size_t len);
+  void addBuffer(const std::string &str) { addBuffer(str.c_str(), str.size()); }
+
+  size_t getNumBuffers() const { return iovs_.size(); }
+
+  // use vmsplice (pipe references buffer pages) if supported
+  bool getUseSplice() const { return useSplice_; }
+  void setUseSplice(bool b) { useSplice_ = b; }
+
+  bool hashData(CCommandHash &hash) const override;
+
+ protected:
+  void writeStream(int fd) override;
+
+ private:
+  using IOVecs = std::vector<iovec>;
+
+  bool writeBuffers(int fd);
+
+ private:
+  IOVecs iovs_;
+  bool   useSplice_ { true };
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CCommandBuiltins_H
+#define CCommandBuiltins_H
+
+#include <CCommand.h>
+
+// Standard builtin commands (see CCommandMgr::addStdBuiltins).
+//
+// Each runs on a thread reading from in and writing to out/err and supports
+// the common subset of options, the check procs return false for anything
+// else so the real command is used.
+class CCommandBuiltins {
+ public:
+  using Args = CCommand::Args;
+
+ public:
+  // cat [file ...]
+  static int  cat     (const Args &args, int in, int out, int err);
+  static bool catCheck(const Args &args);
+
+  // head [-n N|-N|-c N] [file]
+  static int  head     (const Args &args, int in, int out, int err);
+  static bool headCheck(const Args &args);
+
+  // tail [-n [+]N|-N|-c [+]N] [file]
+  static int  tail     (const Args &args, int in, int out, int err);
+  static bool tailCheck(const Args &args);
+
+  // wc [-lwc] [file]
+  static int  wc     (const Args &args, int in, int out, int err);
+  static bool wcCheck(const Args &args);
+
+  // tee [-a] [file ...]
+  static int  tee     (const Args &args, int in, int out, int err);
+  static bool teeCheck(const Args &args);
+
+  // grep -F [-vcxqi] [-e] pattern [file]
+  static int  grep     (const Args &args, int in, int out, int err);
+  static bool grepCheck(const Args &args);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CCommandCallbackDest_H
+#define CCommandCallbackDest_H
+
+#include <CCommandStreamDest.h>
+#include <vector>
+
+// Pass command output to a user callback as it arrives, either as raw chunks
+// or as complete lines (newline stripped). The callback is called on the
+// stream thread while the command is running.
+class CCommandCallbackDest : public CCommandStreamDest {
+ public:
+  using CallbackData = void *;
+  using CallbackProc = void (*)(const char *buffer, size_t len, CallbackData data);
+
+  enum class Mode {
+    CHUNK,
+    LINE
+  };
+
+ public:
+  CCommandCallbackDest(CCommand *command, CallbackProc proc, CallbackData data,
+                       Mode mode=Mode::CHUNK, int dest_fd=1);
+
+ ~CCommandCallbackDest();
+
+  Mode getMode() const { return mode_; }
+  void setMode(Mode mode) { mode_ = mode; }
+
+  // read size for chunks
+  size_t getChunkSize() const { return chunkSize_; }
+  void setChunkSize(size_t size) { chunkSize_ = (size > 0 ? size : 1); }
+
+  // max line length (longer lines are passed in pieces)
+  size_t getMaxLineLen() const { return maxLineLen_; }
+  void setMaxLineLen(size_t len) { maxLineLen_ = (len > 0 ? len : 1); }
+
+ protected:
+  void readStream(int fd) override;
+
+ private:
+  void addLineData(const char *buffer, size_t len);
+
+  void flushLine();
+
+ private:
+  CallbackProc      proc_       { nullptr };
+  CallbackData      data_       { nullptr };
+  Mode              mode_       { Mode::CHUNK };
+  size_t            chunkSize_  { 65536 };
+  size_t            maxLineLen_ { 65536 };
+  std::vector<char> line_;
+};
+
+#endif
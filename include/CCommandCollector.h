@@ -0,0 +1,132 @@
+#ifndef CCommandCollector_H
+#define CCommandCollector_H
+
+#include <CCommandStreamDest.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CCommandCollector;
+
+// Dest added to each collected command (output buffered by collector)
+class CCommandCollectorDest : public CCommandStreamDest {
+ public:
+  CCommandCollectorDest(CCommand *command, CCommandCollector *collector, int ind,
+                        int dest_fd=1);
+
+ ~CCommandCollectorDest();
+
+  int getInd() const { return ind_; }
+
+ protected:
+  void readStream(int fd) override;
+
+ private:
+  friend class CCommandCollector;
+
+  CCommandCollector *collector_ { nullptr };
+  int                ind_       { 0 };
+};
+
+//---
+
+// Collects the output of many (concurrent) commands and writes each
+// command's output to one fd as a single block so outputs never interleave
+// (like parallel --group, or --keep-order for SUBMISSION order).
+//
+// Output is buffered in memory up to a limit shared by all commands, after
+// which the command adding data is spilled to an (unlinked) temporary file.
+// In SUBMISSION order the oldest unfinished command streams its output
+// directly as nothing can be written before it.
+//
+// Commands are added before they are started. The collector must outlive
+// the collected commands' output (i.e. until they have been waited for).
+class CCommandCollector {
+ public:
+  enum class Order {
+    SUBMISSION, // order commands were added
+    COMPLETION  // order command output finished
+  };
+
+ public:
+  CCommandCollector(int fd=1, Order order=Order::SUBMISSION);
+
+ ~CCommandCollector();
+
+  int getFd() const { return fd_; }
+
+  Order getOrder() const { return order_; }
+
+  // total output buffered in memory before spilling to disk
+  size_t getMemoryLimit() const { return memoryLimit_; }
+  void setMemoryLimit(size_t limit) { memoryLimit_ = limit; }
+
+  // directory for spill files (default $TMPDIR or /tmp)
+  const std::string &getSpillDir() const { return spillDir_; }
+  void setSpillDir(const std::string &dir) { spillDir_ = dir; }
+
+  // add command whose output (dest_fd) is collected
+  CCommandCollectorDest *addCommand(CCommand *command, int dest_fd=1);
+
+  size_t getMemoryUsed() const;
+
+  // number of commands (and bytes) spilled to disk
+  size_t getNumSpilled  () const;
+  size_t getBytesSpilled() const;
+
+ private:
+  friend class CCommandCollectorDest;
+
+  struct Slot {
+    CCommandCollectorDest *dest    { nullptr };
+    std::string            buffer;
+    int                    spillFd { -1 };
+    bool                   done    { false };
+  };
+
+  // data (or spill file) queued for output
+  struct Output {
+    std::string buffer;
+    int         spillFd { -1 };
+  };
+
+  bool addData(int ind, const char *data, size_t len, std::string &error);
+
+  bool finish(int ind, std::string &error);
+
+  void emitReady();
+
+  void emitSlot(Slot &slot);
+
+  bool spill(Slot &slot, std::string &error);
+
+  bool writeSpill(Slot &slot, const char *data, size_t len, std::string &error);
+
+  bool flushOutput(std::string &error);
+
+  bool writeSpillOutput(int spillFd, std::string &error);
+
+  bool writeOutput(const char *data, size_t len, std::string &error);
+
+  void removeDest(CCommandCollectorDest *dest);
+
+ private:
+  using Slots   = std::vector<Slot>;
+  using Outputs = std::deque<Output>;
+
+  mutable std::mutex mutex_;       // slots, queued outputs and counts
+  std::mutex         outputMutex_; // writes to fd (in queued order)
+  int                fd_            { 1 };
+  Order              order_         { Order::SUBMISSION };
+  size_t             memoryLimit_   { 64*1024*1024 };
+  std::string        spillDir_;
+  Slots              slots_;
+  Outputs            outputs_;
+  size_t             next_          { 0 }; // next slot to emit (SUBMISSION)
+  size_t             memoryUsed_    { 0 };
+  size_t             numSpilled_    { 0 };
+  size_t             bytesSpilled_  { 0 };
+};
+
+#endif
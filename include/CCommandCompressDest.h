@@ -0,0 +1,69 @@
+#ifndef CCommandCompressDest_H
+#define CCommandCompressDest_H
+
+#include <CCommandStreamDest.h>
+#include <vector>
+
+// Compress command output into a file (gzip or zstd) as it arrives.
+// Compression runs on the stream thread. zstd support needs CCOMMAND_ZSTD.
+class CCommandCompressDest : public CCommandStreamDest {
+ public:
+  enum class Format {
+    GZIP,
+    ZSTD
+  };
+
+ public:
+  CCommandCompressDest(CCommand *command, const std::string &file,
+                       Format format=Format::GZIP, int dest_fd=1);
+
+ ~CCommandCompressDest();
+
+  static bool isFormatSupported(Format format);
+
+  Format getFormat() const { return format_; }
+
+  // compression level (-1 for format default)
+  int getLevel() const { return level_; }
+  void setLevel(int level) { level_ = level; }
+
+  // size of input blocks passed to compressor
+  size_t getBlockSize() const { return blockSize_; }
+  void setBlockSize(size_t size) { blockSize_ = (size > 0 ? size : 1); }
+
+  void setAppend(bool append) { append_ = append; }
+
+  // total uncompressed/compressed sizes
+  size_t getInputSize () const { return inputSize_; }
+  size_t getOutputSize() const { return outputSize_; }
+
+ protected:
+  void initStream() override;
+  void readStream(int fd) override;
+  void termStream() override;
+
+ private:
+  using Buffer = std::vector<char>;
+
+  bool readBlock(int fd, Buffer &buffer, size_t &len);
+
+  void readGzip(int fd);
+  void readZstd(int fd);
+
+  bool writeData(const char *data, size_t len);
+
+  // discard rest of output (no file or write error)
+  void drainStream(int fd);
+
+ private:
+  std::string file_;
+  Format      format_     { Format::GZIP };
+  int         level_      { -1 };
+  size_t      blockSize_  { 131072 };
+  bool        append_     { false };
+  int         file_fd_    { -1 };
+  size_t      inputSize_  { 0 };
+  size_t      outputSize_ { 0 };
+};
+
+#endif
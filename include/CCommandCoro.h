@@ -0,0 +1,375 @@
+#ifndef CCommandCoro_H
+#define CCommandCoro_H
+
+// C++20 coroutine interface for running commands on a CCommandExecutor.
+//
+//   CCommandTask<int> count(CCommandExecutor &executor) {
+//     CCommand command("ls", "ls", {"-l"});
+//
+//     CCommandLines lines(executor, command);
+//     CCommandAsync async(executor, command);
+//
+//     command.start();
+//
+//     int n = 0;
+//
+//     while (auto line = co_await lines.next())
+//       ++n;
+//
+//     auto result = co_await async.run();
+//
+//     co_return (result.isSuccess() ? n : -1);
+//   }
+//
+//   auto task = count(executor);
+//
+//   task.start();
+//
+//   executor.run();
+//
+// Header only (the library itself is built as C++17) and only available
+// when the compiler supports coroutines.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <CCommand.h>
+#include <CCommandExecutor.h>
+#include <CCommandOutputDest.h>
+#include <CCommandResult.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <utility>
+
+#define CCOMMAND_CORO 1
+
+template<typename T=void>
+class CCommandTask;
+
+namespace CCommandCoroUtil {
+
+struct PromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template<typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      auto continuation = h.promise().continuation;
+
+      return (continuation ? continuation : std::noop_coroutine());
+    }
+
+    void await_resume() const noexcept { }
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() { error = std::current_exception(); }
+
+  void rethrow() const { if (error) std::rethrow_exception(error); }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr      error;
+};
+
+template<typename T>
+struct Promise : public PromiseBase {
+  CCommandTask<T> get_return_object();
+
+  void return_value(T value) { value_ = std::move(value); }
+
+  T result() { rethrow(); return std::move(*value_); }
+
+  std::optional<T> value_;
+};
+
+template<>
+struct Promise<void> : public PromiseBase {
+  CCommandTask<void> get_return_object();
+
+  void return_void() { }
+
+  void result() { rethrow(); }
+};
+
+}
+
+//---
+
+// Lazily started coroutine returning T. Can be co_awaited from another task
+// or started as a root task with start() and run by the executor.
+template<typename T>
+class CCommandTask {
+ public:
+  using promise_type = CCommandCoroUtil::Promise<T>;
+  using Handle       = std::coroutine_handle<promise_type>;
+
+ public:
+  explicit CCommandTask(Handle h) : h_(h) { }
+
+  CCommandTask(CCommandTask &&rhs) noexcept : h_(std::exchange(rhs.h_, {})) { }
+
+  CCommandTask &operator=(CCommandTask &&rhs) noexcept {
+    if (this != &rhs) {
+      if (h_) h_.destroy();
+
+      h_ = std::exchange(rhs.h_, {});
+    }
+
+    return *this;
+  }
+
+ ~CCommandTask() {
+    if (h_) h_.destroy();
+  }
+
+  // start root task (runs until first suspension)
+  void start() { h_.resume(); }
+
+  bool done() const { return (! h_ || h_.done()); }
+
+  // result of finished task (rethrows exception)
+  T result() { return h_.promise().result(); }
+
+  // co_await task
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+    h_.promise().continuation = continuation;
+
+    return h_;
+  }
+
+  T await_resume() { return h_.promise().result(); }
+
+ private:
+  CCommandTask(const CCommandTask &) = delete;
+  CCommandTask &operator=(const CCommandTask &) = delete;
+
+ private:
+  Handle h_;
+};
+
+template<typename T>
+inline CCommandTask<T>
+CCommandCoroUtil::Promise<T>::
+get_return_object()
+{
+  return CCommandTask<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline CCommandTask<void>
+CCommandCoroUtil::Promise<void>::
+get_return_object()
+{
+  return CCommandTask<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+//---
+
+// Await command exit: co_await async.run() starts the command (if not already
+// started) and resumes with its result once it has exited and any captured
+// output has been read.
+class CCommandAsync {
+ public:
+  class RunAwaiter {
+   public:
+    explicit RunAwaiter(CCommandAsync *async) : async_(async) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      async_->handle_ = h;
+
+      async_->startRun();
+    }
+
+    CCommandResult await_resume() { return std::move(async_->result_); }
+
+   private:
+    CCommandAsync *async_ { nullptr };
+  };
+
+ public:
+  CCommandAsync(CCommandExecutor &executor, CCommand &command) :
+   executor_(executor), command_(command) {
+  }
+
+  // capture command output (fd) into result output (call before start)
+  void setCapture(int fd=1) {
+    if (! capture_)
+      capture_ = command_.addOutputDest(fd);
+  }
+
+  RunAwaiter run() { return RunAwaiter(this); }
+
+ private:
+  void startRun() {
+    // (already started command is timed from run)
+    result_.startTime = CCommandResult::Clock::now();
+
+    if (command_.isState(CCommand::State::IDLE) || command_.isState(CCommand::State::NONE))
+      command_.start();
+
+    exited_ = false;
+    eof_    = (capture_ == nullptr);
+
+    if (! eof_)
+      readOutput();
+
+    executor_.watchExit(&command_, exitProc, this);
+  }
+
+  void readOutput() {
+    // no data yet
+    if (! capture_->readAvailable(result_.output)) {
+      executor_.watchRead(capture_->getFd(), readProc, this);
+      return;
+    }
+
+    capture_->close();
+
+    eof_ = true;
+  }
+
+  void checkDone() {
+    if (! exited_ || ! eof_)
+      return;
+
+    result_.returnCode = command_.getReturnCode();
+    result_.signalNum  = command_.getSignalNum();
+    result_.usage      = command_.getUsage();
+
+    handle_.resume();
+  }
+
+  static void readProc(void *data) {
+    auto *async = static_cast<CCommandAsync *>(data);
+
+    async->readOutput();
+
+    async->checkDone();
+  }
+
+  static void exitProc(void *data) {
+    auto *async = static_cast<CCommandAsync *>(data);
+
+    async->exited_ = true;
+
+    async->result_.endTime = CCommandResult::Clock::now();
+
+    async->checkDone();
+  }
+
+ private:
+  CCommandExecutor        &executor_;
+  CCommand                &command_;
+  CCommandOutputDest      *capture_ { nullptr };
+  CCommandResult           result_;
+  std::coroutine_handle<>  handle_;
+  bool                     exited_  { false };
+  bool                     eof_     { false };
+};
+
+//---
+
+// Read command output incrementally: co_await lines.next() resumes with the
+// next line (without newline) or std::nullopt at EOF. Must be created before
+// the command is started.
+class CCommandLines {
+ public:
+  class NextAwaiter {
+   public:
+    explicit NextAwaiter(CCommandLines *lines) : lines_(lines) { }
+
+    bool await_ready() { return lines_->readLine(); }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      lines_->handle_ = h;
+
+      lines_->executor_.watchRead(lines_->dest_->getFd(), readProc, lines_);
+    }
+
+    std::optional<std::string> await_resume() { return std::move(lines_->line_); }
+
+   private:
+    CCommandLines *lines_ { nullptr };
+  };
+
+ public:
+  CCommandLines(CCommandExecutor &executor, CCommand &command, int fd=1, char delim='\n') :
+   executor_(executor), delim_(delim) {
+    dest_ = command.addOutputDest(fd);
+  }
+
+  NextAwaiter next() { return NextAwaiter(this); }
+
+ private:
+  // get next line from buffered data (reading what is available), returns
+  // false if more data is needed
+  bool readLine() {
+    line_.reset();
+
+    for (;;) {
+      auto p = buffer_.find(delim_, pos_);
+
+      if (p != std::string::npos) {
+        line_ = buffer_.substr(pos_, p - pos_);
+        pos_  = p + 1;
+
+        return true;
+      }
+
+      if (eof_) {
+        // last line with no delimiter
+        if (pos_ < buffer_.size()) {
+          line_ = buffer_.substr(pos_);
+          pos_  = buffer_.size();
+        }
+
+        return true;
+      }
+
+      buffer_.erase(0, pos_);
+
+      pos_ = 0;
+
+      auto size = buffer_.size();
+
+      if (dest_->readAvailable(buffer_)) {
+        dest_->close();
+
+        eof_ = true;
+      }
+      // no data yet
+      else if (buffer_.size() == size)
+        return false;
+    }
+  }
+
+  static void readProc(void *data) {
+    auto *lines = static_cast<CCommandLines *>(data);
+
+    if (lines->readLine())
+      lines->handle_.resume();
+    else
+      lines->executor_.watchRead(lines->dest_->getFd(), readProc, lines);
+  }
+
+ private:
+  CCommandExecutor           &executor_;
+  CCommandOutputDest         *dest_   { nullptr };
+  char                        delim_  { '\n' };
+  std::string                 buffer_;
+  size_t                      pos_    { 0 };
+  bool                        eof_    { false };
+  std::optional<std::string>  line_;
+  std::coroutine_handle<>     handle_;
+};
+
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 #include <cstdio>
 
 class CCommand;
+class CCommandStdio;
 
 class CCommandDest {
  public:
@@ -20,6 +21,9 @@ class CCommandDest {
   virtual void term() = 0;
   virtual void process() { }
 
+  // set up private stdio of thread command (instead of initChild)
+  virtual void initThread(CCommandStdio &) { }
+
  protected:
   void throwError(const std::string &msg);
 
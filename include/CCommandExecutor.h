@@ -0,0 +1,65 @@
+#ifndef CCommandExecutor_H
+#define CCommandExecutor_H
+
+#include <deque>
+#include <vector>
+
+class CCommand;
+
+// Single threaded event loop which runs callbacks when fds become readable
+// or commands exit, so many commands can be waited for without blocking a
+// thread per command (see CCommandCoro.h for the coroutine interface).
+//
+// Process exit is watched with a pidfd (polled every 10ms if not available,
+// and for thread commands).
+class CCommandExecutor {
+ public:
+  using Proc = void (*)(void *data);
+
+ public:
+  CCommandExecutor();
+ ~CCommandExecutor();
+
+  // call proc from run loop
+  void post(Proc proc, void *data);
+
+  // call proc once when fd is readable (or at EOF)
+  void watchRead(int fd, Proc proc, void *data);
+
+  // call proc once when started command has exited (and been terminated)
+  void watchExit(CCommand *command, Proc proc, void *data);
+
+  // run until there are no posted procs or watches left
+  void run();
+
+  // run ready procs waiting up to timeout ms (-1 for no limit) for events,
+  // returns false if there is nothing left to wait for
+  bool runOnce(int timeout=-1);
+
+  bool isIdle() const;
+
+ private:
+  CCommandExecutor(const CCommandExecutor &) = delete;
+  CCommandExecutor &operator=(const CCommandExecutor &) = delete;
+
+  struct Watch;
+
+  void addPoll(Watch *watch);
+  void checkPolls();
+
+ private:
+  struct Posted {
+    Proc  proc { nullptr };
+    void *data { nullptr };
+  };
+
+  using PostedList = std::deque<Posted>;
+  using Watches    = std::vector<Watch *>;
+
+  int        epfd_       { -1 };
+  PostedList posted_;
+  Watches    polls_;
+  int        numWatches_ { 0 };
+};
+
+#endif
@@ -2,6 +2,10 @@
 #define CCommandFileDest_H
 
 #include <CCommandDest.h>
+#include <sys/types.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 class CCommandFileDest : public CCommandDest {
  public:
@@ -15,15 +19,53 @@ class CCommandFileDest : public CCommandDest {
   void setOverwrite(bool overwrite) { overwrite_ = overwrite; }
   void setAppend(bool append) { append_ = append; }
 
+  // sink mode for large outputs: file is written to an unnamed (O_TMPFILE) or
+  // temporary file which is linked/renamed into place when the command exits
+  // successfully, optionally preallocated from a size hint, and written pages
+  // are flushed and dropped from the page cache as the command writes them
+  bool getSinkMode() const { return sinkMode_; }
+  void setSinkMode(bool sinkMode) { sinkMode_ = sinkMode; }
+
+  off_t getSizeHint() const { return sizeHint_; }
+  void setSizeHint(off_t size) { sizeHint_ = size; }
+
+  bool getDropCache() const { return dropCache_; }
+  void setDropCache(bool dropCache) { dropCache_ = dropCache; }
+
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
   void term() override;
 
+  void process() override;
+
+ private:
+  void initSink();
+  void termSink();
+
+  void startWriteBehind();
+  void stopWriteBehind();
+
+  void writeBehind(bool final);
+
+  static void writeBehindThread(CCommandFileDest *dest);
+
  private:
   std::string *file_      { nullptr };
   int          dest_fd_   { 0 };
   bool         overwrite_ { true };
   bool         append_    { false };
+
+  bool                    sinkMode_      { false };
+  off_t                   sizeHint_      { 0 };
+  bool                    dropCache_     { true };
+  std::string             tmpFile_;
+  off_t                   flushPos_      { 0 };
+  off_t                   dropPos_       { 0 };
+  std::thread             thread_;
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+  bool                    stopThread_    { false };
 };
 
 #endif
@@ -12,8 +12,11 @@ class CCommandFileSrc : public CCommandSrc {
 
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
   void term() override;
 
+  bool hashData(CCommandHash &hash) const override;
+
  private:
   std::string *file_ { nullptr };
 };
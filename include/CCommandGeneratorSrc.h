@@ -0,0 +1,39 @@
+#ifndef CCommandGeneratorSrc_H
+#define CCommandGeneratorSrc_H
+
+#include <CCommandStreamSrc.h>
+
+// Source which pulls stdin data from a user generator as the command reads it.
+// The generator fills the buffer and returns the number of bytes (0 for end)
+// and is only called again once the previous chunk has been written to the
+// pipe, so a slow reader holds back the generator. It is called on the
+// stream thread.
+class CCommandGeneratorSrc : public CCommandStreamSrc {
+ public:
+  using CallbackData = void *;
+  using CallbackProc = size_t (*)(char *buffer, size_t size, CallbackData data);
+
+ public:
+  CCommandGeneratorSrc(CCommand *command, CallbackProc proc, CallbackData data);
+
+ ~CCommandGeneratorSrc();
+
+  // max bytes requested from generator per call
+  size_t getChunkSize() const { return chunkSize_; }
+  void setChunkSize(size_t size) { chunkSize_ = (size > 0 ? size : 1); }
+
+  // total bytes written to command
+  size_t getNumWritten() const { return numWritten_; }
+
+ protected:
+  void initStream() override;
+  void writeStream(int fd) override;
+
+ private:
+  CallbackProc proc_       { nullptr };
+  CallbackData data_       { nullptr };
+  size_t       chunkSize_  { 65536 };
+  size_t       numWritten_ { 0 };
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CCommandHash_H
+#define CCommandHash_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class CCommand;
+
+// Streaming 128 bit hash (MurmurHash3 x64 128) used to identify commands and
+// their inputs (see CCommandResultCache and CCommandMgr::runShared). Not
+// cryptographic, only for identifying non-adversarial inputs.
+class CCommandHash {
+ public:
+  struct Key {
+    uint64_t h1 { 0 };
+    uint64_t h2 { 0 };
+
+    bool operator==(const Key &key) const { return (h1 == key.h1 && h2 == key.h2); }
+    bool operator!=(const Key &key) const { return ! (*this == key); }
+
+    // 32 hex digits
+    std::string toString() const;
+  };
+
+  // for unordered containers
+  struct KeyHash {
+    size_t operator()(const Key &key) const { return size_t(key.h1); }
+  };
+
+ public:
+  CCommandHash();
+
+  // add raw bytes (consecutive calls hash as one stream)
+  void addData(const void *data, size_t len);
+
+  // add length prefixed string/integer (so adjacent values can't run together)
+  void addString(const std::string &str);
+  void addInt(uint64_t i);
+
+  // add contents of file, returns false if it can't be read
+  bool addFile(const std::string &filename);
+
+  // add command spec and inputs: the executable (resolved path, device,
+  // inode, size and mtime), name and args, current directory, values of
+  // envVars and stdin data (see CCommandSrc::hashData). Returns false if
+  // command output isn't determined by these (thread or callback proc,
+  // unknown stdin data or dests)
+  bool addCommand(CCommand *command, const std::vector<std::string> &envVars);
+
+  Key getKey() const;
+
+ private:
+  void addBlock(const unsigned char *block);
+
+ private:
+  uint64_t      h1_        { 0 };
+  uint64_t      h2_        { 0 };
+  uint64_t      len_       { 0 };
+  unsigned char buffer_[16];
+  size_t        bufferLen_ { 0 };
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CCommandHedger_H
+#define CCommandHedger_H
+
+#include <CCommand.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Runs commands with hedging to cut tail latency: if a command hasn't
+// finished within a percentile (default 95th) of the recorded latencies of
+// commands with the same name, a duplicate is started and the result of
+// whichever finishes first is used. The other is killed (SIGKILL to its
+// process group, so any children it started are killed too).
+//
+// No duplicate is started until enough latencies have been recorded (see
+// setMinHistory). Only idempotent commands with no side effects should be
+// hedged as both copies may run to completion.
+//
+// A hedger may be shared by several threads.
+class CCommandHedger {
+ public:
+  CCommandHedger(double percentile=95.0, size_t historySize=100);
+
+  // latency percentile used as hedge delay
+  double getPercentile() const { return percentile_; }
+  void setPercentile(double percentile) { percentile_ = percentile; }
+
+  // number of recorded latencies kept per command name
+  size_t getHistorySize() const { return historySize_; }
+  void setHistorySize(size_t size) { historySize_ = size; }
+
+  // number of latencies needed before hedging
+  size_t getMinHistory() const { return minHistory_; }
+  void setMinHistory(size_t size) { minHistory_ = size; }
+
+  // minimum hedge delay (ms)
+  int getMinDelay() const { return minDelay_; }
+  void setMinDelay(int delay) { minDelay_ = delay; }
+
+  // run command (args[0] is name) capturing stdout/stderr in result,
+  // returns true if the result is from the duplicate
+  bool run(const CCommand::Args &args, CCommandResult &result);
+
+  // hedge delay (ms) for command name, -1 if not enough history
+  int getDelay(const std::string &name) const;
+
+  // record latency (seconds) of command name
+  void addLatency(const std::string &name, double latency);
+
+  void clearHistory();
+
+  size_t getNumRuns     () const;
+  size_t getNumHedged   () const;
+  size_t getNumHedgeWins() const;
+
+ private:
+  using Latencies = std::deque<double>;
+  using History   = std::map<std::string, Latencies>;
+
+  CCommandHedger(const CCommandHedger &) = delete;
+  CCommandHedger &operator=(const CCommandHedger &) = delete;
+
+ private:
+  mutable std::mutex mutex_;
+  double             percentile_   { 95.0 };
+  size_t             historySize_  { 100 };
+  size_t             minHistory_   { 20 };
+  int                minDelay_     { 1 };
+  History            history_;
+  size_t             numRuns_      { 0 };
+  size_t             numHedged_    { 0 };
+  size_t             numHedgeWins_ { 0 };
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CCommandMapFileSrc_H
+#define CCommandMapFileSrc_H
+
+#include <CCommandFileSrc.h>
+
+// File source for callback commands which memory maps the file so the
+// callback can read it directly (getData/getSize) instead of from stdin.
+// Commands which exec a program get the file on stdin as for CCommandFileSrc.
+//
+// The running callback gets the source with CCommandMapFileSrc::current()
+// (if not mapped, e.g. not a regular file, the data is on stdin).
+class CCommandMapFileSrc : public CCommandFileSrc {
+ public:
+  CCommandMapFileSrc(CCommand *command, const std::string &file);
+
+ ~CCommandMapFileSrc();
+
+  // mapped source of command whose callback is running on this thread
+  // (nullptr if none or file couldn't be mapped)
+  static CCommandMapFileSrc *current();
+
+  // mapped file data (valid while callback is running)
+  bool isMapped() const { return mapped_; }
+
+  const char *getData() const { return data_; }
+  size_t      getSize() const { return size_; }
+
+  void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+  void term() override;
+
+ private:
+  bool mapFile();
+  void unmapFile();
+
+ private:
+  const char *data_   { nullptr };
+  size_t      size_   { 0 };
+  bool        mapped_ { false };
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef CCommandMerge_H
+#define CCommandMerge_H
+
+#include <CCommand.h>
+#include <CCommandDest.h>
+#include <vector>
+
+class CCommandMerge;
+class CCommandPipe;
+
+// Dest added to each merge input command (output written to merge pipe)
+class CCommandMergeDest : public CCommandDest {
+ public:
+  CCommandMergeDest(CCommand *command, CCommandMerge *merge, int dest_fd=1);
+
+ ~CCommandMergeDest();
+
+  CCommandPipe *getPipe() const { return pipe_; }
+
+  void initParent() override;
+  void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+  void term() override;
+
+  void process() override;
+
+ private:
+  friend class CCommandMerge;
+
+  CCommandMerge *merge_   { nullptr };
+  int            dest_fd_ { 1 };
+  CCommandPipe  *pipe_    { nullptr };
+};
+
+//---
+
+// Command which merges the sorted outputs of several commands into one
+// sorted stream written to its stdout (so can be sent to any dest), like
+// sort -m. Runs in process by default. Input commands must be started
+// before the merge command.
+class CCommandMerge : public CCommand {
+ public:
+  // compare keys (< 0, 0, > 0)
+  using CompareProc = int (*)(const char *key1, size_t len1, const char *key2, size_t len2,
+                              CallbackData data);
+
+ public:
+  CCommandMerge(const std::string &name="merge", bool doFork=false);
+
+ ~CCommandMerge();
+
+  // add command whose output (fd) is merged
+  void addInput(CCommand *command, int fd=1);
+
+  char getDelim() const { return delim_; }
+  void setDelim(char delim) { delim_ = delim; }
+
+  // key is field number (1 based) separated by sep (0 for whole line)
+  void setKeyField(int field, char sep='\t') { keyField_ = field; keySep_ = sep; }
+
+  bool getNumeric() const { return numeric_; }
+  void setNumeric(bool numeric) { numeric_ = numeric; }
+
+  bool getReverse() const { return reverse_; }
+  void setReverse(bool reverse) { reverse_ = reverse; }
+
+  void setCompareProc(CompareProc proc, CallbackData data) {
+    compareProc_ = proc; compareData_ = data;
+  }
+
+ protected:
+  void died() override;
+
+ private:
+  friend class CCommandMergeDest;
+
+  struct Input;
+
+  void removeInput(CCommandMergeDest *dest);
+
+  void merge();
+
+  bool nextLine(Input &input);
+
+  void setKey(Input &input);
+
+  int compare(const Input &input1, const Input &input2) const;
+
+  static void mergeProc(const Args &args, CallbackData data);
+
+ private:
+  using Dests = std::vector<CCommandMergeDest *>;
+
+  Dests        dests_;
+  char         delim_       { '\n' };
+  int          keyField_    { 0 };
+  char         keySep_      { '\t' };
+  bool         numeric_     { false };
+  bool         reverse_     { false };
+  CompareProc  compareProc_ { nullptr };
+  CallbackData compareData_ { nullptr };
+};
+
+#endif
@@ -2,11 +2,18 @@
 #define CCommandMgr_H
 
 #include <CCommand.h>
+#include <CCommandHash.h>
 #include <CSingleton.h>
+#include <atomic>
 #include <map>
 #include <list>
+#include <mutex>
+#include <unordered_map>
 
 class CCommandPipeDest;
+class CCommandThreadPool;
+class CCommandReaper;
+class CCommandParser;
 
 #define CCommandMgrInst CCommandMgr::getInstancePtr()
 
@@ -18,6 +25,7 @@ class CCommandMgr : public CSingleton<CCommandMgr> {
  public:
   CCommandMgr();
 
+  // add/delete command (commands can be created on any thread)
   void addCommand   (CCommand *);
   void deleteCommand(CCommand *);
 
@@ -26,6 +34,10 @@ class CCommandMgr : public CSingleton<CCommandMgr> {
   CommandMap::iterator commandsBegin() { return command_map_.begin(); }
   CommandMap::iterator commandsEnd  () { return command_map_.end  (); }
 
+  // lock for command map changes (SIGCHLD handler, which may run on any
+  // thread, only tries to lock it)
+  std::mutex &getMapMutex() { return mapMutex_; }
+
   CCommandPipeDest *getPipeDest() const {
     return pipe_dest_;
   }
@@ -36,14 +48,80 @@ class CCommandMgr : public CSingleton<CCommandMgr> {
 
   std::string getLastError() const { return last_error_; }
 
+  // connect piped thread commands with in memory queue instead of pipe
+  bool getUseQueues() const { return useQueues_; }
+  void setUseQueues(bool useQueues) { useQueues_ = useQueues; }
+
   void setThrowOnError(bool flag) { throwOnError_ = flag; }
 
   bool getDebug() const { return debug_; }
 
   void setDebug(bool debug) { debug_ = debug; }
 
+  // parse (see CCommandParser) and run command line, waiting for it to finish
   bool execCommand(const std::string &cmd);
 
+  // run command over numParts record aligned parts of file in parallel
+  // (like parallel --pipepart), outputs are returned in part order
+  bool execFileParts(const std::string &name, const CCommand::Args &args,
+                     const std::string &filename, int numParts,
+                     StringVectorT &outputs, char delim='\n');
+
+  // run command template (name and args) once for each input with at most
+  // numJobs commands running at once (0 for number of cpus), like parallel
+  // or xargs -P. {} in the template is replaced by the input (input is added
+  // as the last arg if there is no {}). Results (with captured stdout) are
+  // returned in input order, returns false if any command failed
+  bool mapParallel(const CCommand::Args &templ, const StringVectorT &inputs, int numJobs,
+                   std::vector<CCommandResult> &results);
+
+  // run command template (name and args) with args appended, split into as
+  // few invocations as fit in the exec argument space (like xargs) with at
+  // most numJobs running at once (0 for number of cpus). Nothing is run for
+  // no args. stdout of the invocations is concatenated in order, returns
+  // false if any failed
+  bool execBatched(const CCommand::Args &templ, const StringVectorT &args, int numJobs,
+                   std::string &output, std::vector<CCommandResult> *results=nullptr);
+
+  // space available for exec args (ARG_MAX less environment and headroom)
+  static size_t getMaxArgSize();
+
+  // split args into batches (each template plus args) which fit in maxSize
+  static void batchArgs(const CCommand::Args &templ, const StringVectorT &args,
+                        size_t maxSize, std::vector<CCommand::Args> &batches);
+
+  // run command capturing stdout/stderr in result or, if an identical
+  // command (same spec and inputs, see CCommandHash::addCommand) is already
+  // being run by runShared, wait for and return its result instead (the
+  // command is not started). Returns true if the result was shared
+  bool runShared(CCommand *command, CCommandResult &result);
+
+  // builtin commands run on a thread in process instead of fork/exec when a
+  // started command name matches (check proc returns false for unsupported
+  // args so command is run normally)
+  using BuiltinCheckProc = bool (*)(const CCommand::Args &args);
+
+  void addBuiltin(const std::string &name, CCommand::BuiltinProc proc,
+                  BuiltinCheckProc check=nullptr);
+  void removeBuiltin(const std::string &name);
+
+  // add cat, head, tail, wc, tee and grep -F builtins
+  void addStdBuiltins();
+
+  CCommand::BuiltinProc getBuiltin(const std::string &name, const CCommand::Args &args) const;
+
+  // pool of threads used to run thread and builtin commands
+  CCommandThreadPool *getThreadPool();
+
+  // thread which reaps async commands (see CCommand::startAsync)
+  CCommandReaper *getReaper();
+
+  bool hasReaper() const { return (reaper_ != nullptr); }
+
+  // command line parser (with cache of parsed lines)
+  CCommandParser *getParser();
+
+  // command with process id (map mutex must be held)
   CCommand *lookup(pid_t pid);
 
   CommandList getCommands();
@@ -52,12 +130,36 @@ class CCommandMgr : public CSingleton<CCommandMgr> {
   void throwError(const std::string &msg);
 
  private:
-  CommandMap        command_map_;
-  CCommandPipeDest *pipe_dest_    { nullptr };
-  std::string       last_error_;
-  uint              last_id_      { 0 };
-  bool              throwOnError_ { false };
-  bool              debug_        { false };
+  struct Builtin {
+    CCommand::BuiltinProc proc  { nullptr };
+    BuiltinCheckProc      check { nullptr };
+  };
+
+  using BuiltinMap = std::map<std::string, Builtin>;
+
+  using SharedResult  = std::shared_future<CCommandResult>;
+  using SharedResults = std::unordered_map<CCommandHash::Key, SharedResult,
+                                           CCommandHash::KeyHash>;
+
+ private:
+  CommandMap          command_map_;
+  std::mutex          mapMutex_;
+  BuiltinMap          builtins_;
+  mutable std::mutex  builtinMutex_;
+  SharedResults       sharedResults_;
+  std::mutex          sharedMutex_;
+  std::atomic<CCommandThreadPool *> threadPool_ { nullptr };
+  std::mutex          threadPoolMutex_; // not mapMutex_ (try locked by SIGCHLD handler)
+  std::atomic<CCommandReaper *> reaper_ { nullptr }; // read by SIGCHLD handler
+  std::mutex          reaperMutex_;
+  CCommandParser     *parser_       { nullptr };
+  std::mutex          parserMutex_;
+  CCommandPipeDest   *pipe_dest_    { nullptr };
+  std::string         last_error_;
+  uint                last_id_      { 0 };
+  bool                throwOnError_ { false };
+  bool                debug_        { false };
+  bool                useQueues_    { true };
 };
 
 #endif
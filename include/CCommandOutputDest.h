@@ -0,0 +1,42 @@
+#ifndef CCommandOutputDest_H
+#define CCommandOutputDest_H
+
+#include <CCommandDest.h>
+#include <string>
+
+class CCommandPipe;
+
+// Dest whose output is read by the caller from a pipe (read end is non
+// blocking so it can be polled, see CCommandExecutor::watchRead)
+class CCommandOutputDest : public CCommandDest {
+ public:
+  CCommandOutputDest(CCommand *command, int dest_fd=1);
+
+ ~CCommandOutputDest();
+
+  // pipe read end (-1 before start or after close)
+  int getFd() const;
+
+  // read available output, returns 0 at EOF and -1 (EAGAIN) if none yet
+  ssize_t read(char *buffer, size_t size);
+
+  // append all available output to str, returns true at EOF (or error) and
+  // false if more output may come (wait for fd to be readable)
+  bool readAvailable(std::string &str);
+
+  // close read end (caller has finished reading)
+  void close();
+
+  void initParent() override;
+  void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+  void term() override;
+
+  void process() override;
+
+ private:
+  int           dest_fd_ { 1 };
+  CCommandPipe *pipe_    { nullptr };
+};
+
+#endif
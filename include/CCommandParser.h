@@ -0,0 +1,115 @@
+#ifndef CCommandParser_H
+#define CCommandParser_H
+
+#include <CCommand.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CCommandPipeline;
+
+// Parsed command line: pipeline stages with their file redirections.
+// Immutable once parsed so can be shared (see CCommandParser cache) and
+// instantiated any number of times.
+class CCommandCompiledLine {
+ public:
+  struct Redirect {
+    std::string file;
+    int         fd     { 1 };
+    bool        append { false };
+  };
+
+  using Redirects = std::vector<Redirect>;
+
+  struct Stage {
+    std::string    name;
+    CCommand::Args args;
+    StringVectorT  inputs;              // < file
+    Redirects      outputs;             // > file, >> file, >& file, ...
+    bool           pipeError { false }; // input is stdout and stderr of previous (|&)
+  };
+
+  using Stages = std::vector<Stage>;
+
+ public:
+  CCommandCompiledLine() { }
+
+  int getNumStages() const { return int(stages_.size()); }
+
+  const Stage &getStage(int i) const { return stages_[size_t(i)]; }
+
+  // create pipeline of commands for line (caller owns)
+  CCommandPipeline *createPipeline() const;
+
+ private:
+  friend class CCommandParser;
+
+  Stages stages_;
+};
+
+//---
+
+// Parser for shell like command lines:
+//
+//   words      separated by spaces, '...' (literal), "..." (\ escapes \ " $ `)
+//              and \c outside quotes
+//   < file     stdin from file
+//   > file     stdout to file (>> appends)
+//   >& file    stderr to file (>>& appends, 2> and 2>> also accepted)
+//   a | b      stdout of a piped to stdin of b
+//   a |& b     stdout and stderr of a piped to stdin of b
+//   # ...      comment (at start of word)
+//
+// There is no variable, glob or command substitution.
+//
+// compile() caches parsed lines in an LRU cache keyed on the command string
+// so repeated (e.g. templated) command lines are only parsed once.
+class CCommandParser {
+ public:
+  using CompiledLineP = std::shared_ptr<const CCommandCompiledLine>;
+
+ public:
+  CCommandParser(size_t cacheSize=1024);
+
+  // maximum number of cached lines (0 disables cache)
+  size_t getCacheSize() const { return cacheSize_; }
+  void setCacheSize(size_t size);
+
+  // parse line (using cache), returns null and sets error on syntax error
+  CompiledLineP compile(const std::string &str, std::string &error);
+
+  size_t getNumHits  () const { return numHits_  ; }
+  size_t getNumMisses() const { return numMisses_; }
+
+  void clearCache();
+
+  // parse line without cache
+  static bool parse(const std::string &str, CCommandCompiledLine &line, std::string &error);
+
+ private:
+  CCommandParser(const CCommandParser &) = delete;
+  CCommandParser &operator=(const CCommandParser &) = delete;
+
+  void trimCache();
+
+ private:
+  struct CacheEntry {
+    std::string   str;
+    CompiledLineP line;
+  };
+
+  using CacheList = std::list<CacheEntry>;
+  using CacheMap  = std::unordered_map<std::string, CacheList::iterator>;
+
+  mutable std::mutex mutex_;
+  size_t             cacheSize_ { 1024 };
+  CacheList          cacheList_; // most recently used first
+  CacheMap           cacheMap_;
+  size_t             numHits_   { 0 };
+  size_t             numMisses_ { 0 };
+};
+
+#endif
@@ -1,15 +1,12 @@
 #ifndef CCommandPipe_H
 #define CCommandPipe_H
 
-#include <list>
+#include <mutex>
 #include <string>
 
 class CCommand;
 
 class CCommandPipe {
- public:
-  typedef std::list<CCommandPipe *> PipeList;
-
  public:
   CCommandPipe(CCommand *command);
  ~CCommandPipe();
@@ -23,18 +20,22 @@ class CCommandPipe {
   int closeInput();
   int closeOutput();
 
-  static void deleteOthers(CCommand *command);
+  // lock pipe creation/close, held over fork (like pthread_atfork) so no
+  // pipe fd is half created or closed in the child, then unlocked in both
+  // parent and child
+  static void lockPipes  () { mutex_.lock  (); }
+  static void unlockPipes() { mutex_.unlock(); }
 
  private:
   void throwError(const std::string &msg);
 
  private:
   CCommand *command_ { nullptr };
-  int       fd_[2];
+  int       fd_[2]   { -1, -1 };
   CCommand *src_     { nullptr };
   CCommand *dest_    { nullptr };
 
-  static PipeList pipes_;
+  static std::mutex mutex_;
 };
 
 #endif
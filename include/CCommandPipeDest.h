@@ -6,6 +6,7 @@
 
 class CCommandPipeSrc;
 class CCommandPipe;
+class CCommandQueue;
 
 class CCommandPipeDest : public CCommandDest {
  public:
@@ -20,17 +21,23 @@ class CCommandPipeDest : public CCommandDest {
 
   void setPipe(CCommandPipe *pipe);
 
+  void setQueue(CCommandQueue *queue);
+
   void addFd(int fd);
 
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
   void term() override;
 
+  void process() override;
+
   CCommandPipe *getPipe() const { return pipe_; }
 
  private:
   CCommandPipeSrc *pipe_src_ { nullptr };
   CCommandPipe    *pipe_     { nullptr };
+  CCommandQueue   *queue_    { nullptr };
   IntVectorT       dest_fds_;
   IntVectorT       save_fds_;
 };
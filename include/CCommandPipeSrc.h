@@ -5,6 +5,7 @@
 
 class CCommandPipeDest;
 class CCommandPipe;
+class CCommandQueue;
 
 class CCommandPipeSrc : public CCommandSrc {
  public:
@@ -16,15 +17,23 @@ class CCommandPipeSrc : public CCommandSrc {
 
   void setPipe(CCommandPipe *pipe);
 
+  void setQueue(CCommandQueue *queue);
+
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+
+  void process() override;
   void term() override;
 
   CCommandPipe *getPipe() const { return pipe_; }
 
+  CCommandQueue *getQueue() const { return queue_; }
+
  private:
   CCommandPipeDest *pipe_dest_ { nullptr };
   CCommandPipe     *pipe_      { nullptr };
+  CCommandQueue    *queue_     { nullptr };
 };
 
 #endif
@@ -0,0 +1,90 @@
+#ifndef CCommandPipeline_H
+#define CCommandPipeline_H
+
+#include <CCommand.h>
+#include <CCommandResult.h>
+#include <vector>
+
+// Pipeline of commands which owns its stages.
+//
+// Stages are connected when the pipeline is started (not through the global
+// pipe dest used by CCommand::addPipeDest/addPipeSrc), so pipelines can be
+// built concurrently on several threads. All pipes are created before any
+// stage is started, then the stages are started in one pass with the forked
+// stages in one process group (led by the first forked stage), and wait
+// reaps the whole group giving a result per stage.
+//
+// Sources of the first stage and destinations of the last stage are added
+// to the stage commands as normal (e.g. getStage(0)->addFileSrc(...)).
+//
+// Start and wait should be called from one thread (like CCommand::start).
+class CCommandPipeline {
+ public:
+  using Args    = CCommand::Args;
+  using Results = std::vector<CCommandResult>;
+
+ public:
+  CCommandPipeline();
+ ~CCommandPipeline();
+
+  // add stage (pipeline takes ownership), its stdin is connected to stdout
+  // (and stderr if pipeError) of the previous stage
+  CCommand *addStage(CCommand *command, bool pipeError=false);
+
+  CCommand *addStage(const std::string &name, const std::string &path,
+                     const Args &args=Args(), bool pipeError=false);
+
+  CCommand *addStage(const std::string &name, CCommand::ThreadProc proc,
+                     CCommand::CallbackData data, const Args &args=Args(),
+                     bool pipeError=false);
+
+  int getNumStages() const { return int(stages_.size()); }
+
+  CCommand *getStage(int i) const;
+
+  // return code is that of last failing stage instead of last stage
+  bool getPipeFail() const { return pipeFail_; }
+  void setPipeFail(bool pipeFail) { pipeFail_ = pipeFail; }
+
+  // process group of forked stages (0 if none started)
+  pid_t getProcessGroup() const { return pgid_; }
+
+  void start();
+
+  // wait for all stages to exit
+  void wait();
+
+  // send SIGTERM to process group
+  void stop();
+
+  // stage results (set by wait)
+  const Results &getResults() const { return results_; }
+
+  int getReturnCode() const;
+
+ private:
+  CCommandPipeline(const CCommandPipeline &) = delete;
+  CCommandPipeline &operator=(const CCommandPipeline &) = delete;
+
+  void connect(CCommand *src, CCommand *dest, bool pipeError);
+
+  bool isRunning() const;
+
+  int stageIndex(pid_t pid) const;
+
+ private:
+  struct Stage {
+    CCommand *command   { nullptr };
+    bool      pipeError { false };
+  };
+
+  using Stages = std::vector<Stage>;
+
+  Stages  stages_;
+  Results results_;
+  pid_t   pgid_     { 0 };
+  bool    pipeFail_ { false };
+  bool    started_  { false };
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef CCommandQueue_H
+#define CCommandQueue_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Single producer/single consumer byte queue used instead of a pipe between
+// two thread commands (see CCommandPipeDest::initParent).
+//
+// Data is copied straight into and out of a lock free ring buffer, the
+// mutex is only used to sleep when the queue is full or empty.
+class CCommandQueue {
+ public:
+  CCommandQueue(size_t size=1024*1024);
+
+  // write all data (returns false if reader has closed)
+  bool write(const char *data, size_t len);
+
+  // read available data, blocks until data or EOF (returns 0 at EOF)
+  ssize_t read(char *buffer, size_t size);
+
+  // no more data will be written (reader sees EOF)
+  void closeWrite();
+
+  // no more data will be read (writer fails)
+  void closeRead();
+
+ private:
+  CCommandQueue(const CCommandQueue &) = delete;
+  CCommandQueue &operator=(const CCommandQueue &) = delete;
+
+  void wakeReader();
+  void wakeWriter();
+
+ private:
+  using Buffer = std::vector<char>;
+
+  Buffer                  buffer_;
+  size_t                  mask_          { 0 };
+  std::atomic<size_t>     head_          { 0 }; // read position (reader owned)
+  std::atomic<size_t>     tail_          { 0 }; // write position (writer owned)
+  std::atomic<bool>       writeClosed_   { false };
+  std::atomic<bool>       readClosed_    { false };
+  std::atomic<bool>       readerWaiting_ { false };
+  std::atomic<bool>       writerWaiting_ { false };
+  std::mutex              mutex_;
+  std::condition_variable cond_;
+};
+
+#endif
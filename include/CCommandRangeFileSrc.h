@@ -0,0 +1,53 @@
+#ifndef CCommandRangeFileSrc_H
+#define CCommandRangeFileSrc_H
+
+#include <CCommandStreamSrc.h>
+#include <sys/types.h>
+#include <vector>
+
+// Source which feeds a byte range of a file to stdin. The range start and
+// end are moved forward to the next record boundary (after the delimiter)
+// so ranges split at the same offsets never share a record.
+class CCommandRangeFileSrc : public CCommandStreamSrc {
+ public:
+  struct Range {
+    off_t start { 0 };
+    off_t end   { 0 };
+
+    Range(off_t start=0, off_t end=0) : start(start), end(end) { }
+
+    off_t size() const { return end - start; }
+  };
+
+  using Ranges = std::vector<Range>;
+
+ public:
+  CCommandRangeFileSrc(CCommand *command, const std::string &file,
+                       off_t start, off_t end, char delim='\n');
+
+ ~CCommandRangeFileSrc();
+
+  // aligned range (valid after start)
+  const Range &getRange() const { return range_; }
+
+  // split file into (at most) n record aligned ranges
+  static bool splitFile(const std::string &file, int n, Ranges &ranges, char delim='\n');
+
+  // move offset to start of next record
+  static off_t alignOffset(int fd, off_t pos, off_t size, char delim);
+
+ protected:
+  void initStream() override;
+  void writeStream(int fd) override;
+  void termStream() override;
+
+ private:
+  std::string file_;
+  off_t       start_   { 0 };
+  off_t       end_     { 0 };
+  char        delim_   { '\n' };
+  int         file_fd_ { -1 };
+  Range       range_;
+};
+
+#endif
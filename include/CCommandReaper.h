@@ -0,0 +1,92 @@
+#ifndef CCommandReaper_H
+#define CCommandReaper_H
+
+#include <CCommandResult.h>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+class CCommand;
+
+// Thread which completes the futures of async commands (see
+// CCommand::startAsync and CCommandMgr::getReaper).
+//
+// A single thread waits (with epoll) for the pidfds of all async commands
+// and reads their captured output, so any number of commands can be waited
+// for without a thread per command. Process exit is polled every 10ms if
+// pidfds are not available. Thread commands notify the reaper when they
+// finish.
+//
+// Async commands are skipped by the SIGCHLD handler so only the reaper
+// collects their exit status and resource usage.
+class CCommandReaper {
+ public:
+  CCommandReaper();
+ ~CCommandReaper();
+
+  // start command, future is set when command has exited and captured
+  // output has been read
+  std::future<CCommandResult> start(CCommand *command, bool captureOutput, bool captureError);
+
+  // async thread command has finished (called on pool thread)
+  void threadDone(CCommand *command);
+
+ private:
+  CCommandReaper(const CCommandReaper &) = delete;
+  CCommandReaper &operator=(const CCommandReaper &) = delete;
+
+  struct Watch;
+  struct Stream;
+  struct Job;
+
+  enum class MessageType {
+    ADD,
+    THREAD_DONE,
+    STOP
+  };
+
+  struct Message {
+    MessageType  type    { MessageType::ADD };
+    Job         *job     { nullptr };
+    CCommand    *command { nullptr };
+  };
+
+  using Messages   = std::vector<Message>;
+  using Jobs       = std::map<CCommand *, Job *>;
+  using CommandSet = std::set<CCommand *>;
+
+  void post(const Message &message);
+
+  void run();
+
+  bool processMessages();
+
+  void addJob(Job *job);
+
+  void reap(Job *job);
+
+  void readStream(Stream *stream);
+
+  void checkDone(Job *job);
+
+  static void runThread(CCommandReaper *reaper);
+
+ private:
+  // shared
+  std::mutex  mutex_;
+  Messages    messages_;
+  int         eventFd_    { -1 };
+
+  // reaper thread only
+  int         epfd_       { -1 };
+  Jobs        jobs_;
+  CommandSet  doneThreads_;
+  int         numPolls_   { 0 };
+
+  std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CCommandResult_H
+#define CCommandResult_H
+
+#include <sys/resource.h>
+#include <chrono>
+#include <string>
+
+// Result of a finished command (see CCommand::startAsync and CCommandCoro.h)
+struct CCommandResult {
+  using Clock     = std::chrono::steady_clock;
+  using TimePoint = Clock::time_point;
+
+  int         returnCode { -1 }; // exit code (-1 if signalled)
+  int         signalNum  { -1 }; // terminating signal (-1 if none)
+  std::string output;            // captured stdout (if requested)
+  std::string error;             // captured stderr (if requested)
+  rusage      usage      { };    // resource usage (only user/system time for thread command)
+  TimePoint   startTime;         // time command was started
+  TimePoint   endTime;           // time command exit was seen
+
+  bool isSuccess() const { return (returnCode == 0); }
+
+  // wall clock, user and system time in seconds
+  double elapsed() const {
+    return std::chrono::duration<double>(endTime - startTime).count();
+  }
+
+  double userTime() const {
+    return double(usage.ru_utime.tv_sec) + double(usage.ru_utime.tv_usec)/1e6;
+  }
+
+  double systemTime() const {
+    return double(usage.ru_stime.tv_sec) + double(usage.ru_stime.tv_usec)/1e6;
+  }
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef CCommandResultCache_H
+#define CCommandResultCache_H
+
+#include <CCommand.h>
+#include <CCommandHash.h>
+#include <mutex>
+#include <string>
+
+// On disk cache of the results (exit code, stdout and stderr) of commands
+// which are pure functions of their inputs, so a repeated command returns
+// its result without being run.
+//
+// The key is a hash of:
+//   . the executable (resolved path, device, inode, size and mtime)
+//   . the command name and args
+//   . the current directory
+//   . the values of the key environment variables (see setEnvVars)
+//   . the stdin data of file, string and buffer sources (file contents)
+//
+// Commands with other sources, any dests, or a thread or callback proc are
+// not cacheable and are just run. Signalled commands are not stored.
+//
+// The store is a directory with an index file (memory mapped hash table of
+// key, size and last use) and a file per result. Total result size and
+// number of entries are bounded with least recently used entries removed
+// first. The index is locked (flock) while in use so the store can be
+// shared by several processes.
+class CCommandResultCache {
+ public:
+  using Key = CCommandHash::Key;
+
+ public:
+  CCommandResultCache(const std::string &dir, size_t maxSize=256*1024*1024,
+                      size_t maxEntries=65536);
+
+ ~CCommandResultCache();
+
+  // store opened ok (errors are reported by CCommandMgr::throwError)
+  bool isValid() const { return (index_ != nullptr); }
+
+  const std::string &getDir() const { return dir_; }
+
+  size_t getMaxSize   () const { return maxSize_   ; }
+  size_t getMaxEntries() const { return maxEntries_; }
+
+  // environment variables included in key (default locale and TZ)
+  const StringVectorT &getEnvVars() const { return envVars_; }
+  void setEnvVars(const StringVectorT &vars) { envVars_ = vars; }
+
+  // run command (capturing stdout/stderr in result) unless result is cached,
+  // returns true if result was cached (command is not started)
+  bool run(CCommand *command, CCommandResult &result);
+
+  // get key for command, returns false if command is not cacheable
+  bool getKey(CCommand *command, Key &key) const;
+
+  // get/set cached result
+  bool lookup(const Key &key, CCommandResult &result);
+  bool store (const Key &key, const CCommandResult &result);
+
+  void remove(const Key &key);
+
+  void clear();
+
+  size_t getNumHits  () const;
+  size_t getNumMisses() const;
+
+  // total size and number of cached results
+  size_t getSize() const;
+  size_t getNumEntries() const;
+
+ private:
+  struct Header;
+  struct Entry;
+
+  CCommandResultCache(const CCommandResultCache &) = delete;
+  CCommandResultCache &operator=(const CCommandResultCache &) = delete;
+
+  bool open();
+
+  void lock();
+  void unlock();
+
+  Entry *findEntry(const Key &key) const;
+
+  Entry *addEntry(const Key &key);
+
+  void removeEntry(Entry *entry);
+
+  void evict();
+
+  std::string resultFile(const Key &key) const;
+
+  bool readResult (const std::string &filename, CCommandResult &result) const;
+  bool writeResult(const std::string &filename, const CCommandResult &result,
+                   size_t &size) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::string        dir_;
+  size_t             maxSize_    { 0 };
+  size_t             maxEntries_ { 0 };
+  StringVectorT      envVars_;
+  int                fd_         { -1 };
+  size_t             indexSize_  { 0 };
+  Header            *header_     { nullptr };
+  Entry             *index_      { nullptr };
+  uint64_t           capacity_   { 0 };
+  size_t             numHits_    { 0 };
+  size_t             numMisses_  { 0 };
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef CCommandScheduler_H
+#define CCommandScheduler_H
+
+#include <CCommandExecutor.h>
+#include <CCommandResult.h>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CCommand;
+
+// Runs commands at two priorities so batch work can share a host with
+// latency sensitive work.
+//
+// High priority commands are started when submitted (up to the job limit).
+// Low priority commands only run in free slots and are paused (SIGSTOP)
+// when a high priority command needs the slot or the load average is above
+// the load limit, then resumed (SIGCONT) when capacity is free again.
+// Paused commands are resumed before new low priority commands are started.
+//
+// Commands are started and waited for by the scheduler thread and submit
+// returns a future set when the command has exited (as CCommand::startAsync).
+// Low priority commands are made process group leaders so processes they
+// start are paused with them.
+class CCommandScheduler {
+ public:
+  enum class Priority {
+    HIGH,
+    LOW
+  };
+
+ public:
+  // maxJobs <= 0 is number of cores
+  CCommandScheduler(int maxJobs=0);
+
+  // waits for all submitted commands
+ ~CCommandScheduler();
+
+  // maximum number of running (not paused) commands
+  int getMaxJobs() const;
+  void setMaxJobs(int maxJobs);
+
+  // 1 minute load average above which low priority commands are paused
+  // (one per second, 0 for no limit)
+  double getMaxLoad() const;
+  void setMaxLoad(double load);
+
+  // queue command, optionally capturing stdout/stderr in the result.
+  // Command must not be changed, waited for or deleted until the future
+  // is ready.
+  std::future<CCommandResult> submit(CCommand *command, Priority priority=Priority::HIGH,
+                                     bool captureOutput=false, bool captureError=false);
+
+  // wait for all submitted commands to finish
+  void wait();
+
+  size_t getNumQueued () const;
+  size_t getNumRunning() const;
+  size_t getNumPaused () const;
+
+  // number of times a low priority command has been paused
+  size_t getNumPreempted() const;
+
+ private:
+  CCommandScheduler(const CCommandScheduler &) = delete;
+  CCommandScheduler &operator=(const CCommandScheduler &) = delete;
+
+  struct Stream;
+  struct Job;
+
+  using Jobs    = std::vector<Job *>;
+  using JobList = std::list<Job *>;
+
+  void wake();
+
+  void run();
+
+  void processMessages();
+
+  void schedule();
+
+  void checkLoad();
+
+  void startJob (Job *job);
+  void pauseJob (Job *job);
+  void resumeJob(Job *job);
+
+  void readStream(Stream *stream);
+
+  void checkDone(Job *job);
+
+  static void eventProc(void *data);
+  static void readProc (void *data);
+  static void exitProc (void *data);
+
+  static void runThread(CCommandScheduler *scheduler);
+
+ private:
+  // shared
+  mutable std::mutex      mutex_;
+  std::condition_variable doneCond_;
+  Jobs                    submitted_;
+  int                     maxJobs_     { 1 };
+  double                  maxLoad_     { 0.0 };
+  bool                    stop_        { false };
+  size_t                  numActive_   { 0 };
+  size_t                  numQueued_   { 0 };
+  size_t                  numRunning_  { 0 };
+  size_t                  numPaused_   { 0 };
+  size_t                  numPreempted_{ 0 };
+  int                     eventFd_     { -1 };
+
+  // scheduler thread only
+  CCommandExecutor        executor_;
+  JobList                 highQueue_;
+  JobList                 lowQueue_;
+  JobList                 lowRunning_;
+  JobList                 lowPaused_;
+  int                     numHigh_     { 0 };
+  bool                    overloaded_  { false };
+  bool                    done_        { false };
+
+  std::thread             thread_;
+};
+
+#endif
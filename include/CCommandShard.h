@@ -0,0 +1,75 @@
+#ifndef CCommandShard_H
+#define CCommandShard_H
+
+#include <CCommand.h>
+#include <mutex>
+
+class CCommandStdio;
+
+// Pipeline stage which splits its stdin into record aligned blocks and
+// distributes them over worker instances of a command (like parallel --pipe).
+//
+// Round robin (default) runs numWorkers persistent workers which each pull
+// the next block when they are ready for input; their output is written to
+// stdout as it arrives (whole records, unordered).
+//
+// Keep order runs one worker per block (at most numWorkers at a time) and
+// writes each block's output to stdout in input order.
+//
+// The stage is a thread command so it reads, splits and starts the workers
+// in the parent process (a forked child must only exec), and is connected
+// like any other command (addPipeSrc/addPipeDest/addFileSrc etc).
+class CCommandShard : public CCommand {
+ public:
+  CCommandShard(const std::string &name, const std::string &path,
+                const Args &args, int numWorkers, bool keepOrder=false);
+
+ ~CCommandShard();
+
+  int getNumWorkers() const { return numWorkers_; }
+
+  bool getKeepOrder() const { return keepOrder_; }
+  void setKeepOrder(bool keepOrder) { keepOrder_ = keepOrder; }
+
+  // minimum block size (block extends to end of record)
+  size_t getBlockSize() const { return blockSize_; }
+  void setBlockSize(size_t size) { blockSize_ = (size > 0 ? size : 1); }
+
+  char getDelim() const { return delim_; }
+  void setDelim(char delim) { delim_ = delim; }
+
+  // worker command path
+  const std::string &getWorkerPath() const { return workerPath_; }
+
+ private:
+  struct WorkerData;
+
+  static int shardProc(const Args &args, CCommandStdio &stdio, CallbackData data);
+
+  bool readBlock(std::string &block);
+
+  bool runRoundRobin();
+  bool runKeepOrder();
+
+  void writeOutput(const char *data, size_t len);
+
+  static size_t workerInput(char *buffer, size_t size, CallbackData data);
+
+  static void workerOutput(const char *buffer, size_t len, CallbackData data);
+
+  static void appendOutput(const char *buffer, size_t len, CallbackData data);
+
+ private:
+  std::string    workerPath_;
+  int            numWorkers_ { 1 };
+  bool           keepOrder_  { false };
+  size_t         blockSize_  { 1024*1024 };
+  char           delim_      { '\n' };
+  std::string    pending_;
+  bool           eof_        { false };
+  CCommandStdio *stdio_      { nullptr }; // stage stdin/stdout (on shard thread)
+  std::mutex     inputMutex_;
+  std::mutex     outputMutex_;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <cstdio>
 
 class CCommand;
+class CCommandStdio;
+class CCommandHash;
 
 class CCommandSrc {
  public:
@@ -20,6 +22,13 @@ class CCommandSrc {
   virtual void term() = 0;
   virtual void process() { }
 
+  // set up private stdio of thread command (instead of initChild)
+  virtual void initThread(CCommandStdio &) { }
+
+  // add data written to command to hash (see CCommandResultCache), returns
+  // false if data is not known before the command is run
+  virtual bool hashData(CCommandHash &) const { return false; }
+
  protected:
   void throwError(const std::string &msg);
 
@@ -0,0 +1,61 @@
+#ifndef CCommandStdio_H
+#define CCommandStdio_H
+
+#include <sys/types.h>
+#include <string>
+
+class CCommandQueue;
+
+// Private stdin/stdout/stderr of a thread command (see CCommand::ThreadProc).
+//
+// The fds are close on exec copies set up by the command's srcs/dests so
+// any number of thread commands can run at once without touching the
+// process fds 0, 1 and 2. Between two thread commands a pipe is replaced by
+// an in memory queue (fd is then -1 so the read/write methods must be used).
+class CCommandStdio {
+ public:
+  CCommandStdio();
+ ~CCommandStdio();
+
+  // private fd for stdio fd (0, 1 or 2), -1 if none
+  int getFd(int fd) const;
+
+  // set private fd for stdio fd to copy of fd1
+  bool setFd(int fd, int fd1);
+
+  // use queue for stdio fd (stdin reads, stdout/stderr writes)
+  void setQueue(int fd, CCommandQueue *queue);
+
+  // read from stdin (returns 0 at EOF)
+  ssize_t read(char *buffer, size_t size);
+
+  // read line from stdin (without newline), returns false at EOF
+  bool readLine(std::string &line);
+
+  // buffered write to stdout (fd 1), stderr (fd 2) is unbuffered
+  bool write(const char *data, size_t len, int fd=1);
+  bool write(const std::string &str, int fd=1);
+
+  bool flush();
+
+  // flush output and close fds
+  void close();
+
+ private:
+  CCommandStdio(const CCommandStdio &) = delete;
+  CCommandStdio &operator=(const CCommandStdio &) = delete;
+
+  bool fillInput();
+
+  static bool writeData(int fd, const char *data, size_t len);
+
+ private:
+  int            fds_[3];
+  CCommandQueue *queues_[3];
+  std::string    inBuffer_;
+  size_t         inPos_  { 0 };
+  bool           inEof_  { false };
+  std::string    outBuffer_;
+};
+
+#endif
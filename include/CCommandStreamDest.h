@@ -0,0 +1,60 @@
+#ifndef CCommandStreamDest_H
+#define CCommandStreamDest_H
+
+#include <CCommandDest.h>
+#include <thread>
+
+class CCommandPipe;
+
+// Base class for destinations which consume the command's output as it is
+// written. The command output (dest_fd) is redirected to a pipe which is
+// drained by a thread in the parent process (readStream).
+class CCommandStreamDest : public CCommandDest {
+ public:
+  CCommandStreamDest(CCommand *command, int dest_fd=1);
+
+ ~CCommandStreamDest();
+
+  int getFd() const { return dest_fd_; }
+
+  CCommandPipe *getPipe() const { return pipe_; }
+
+  void initParent() override;
+  void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+  void term() override;
+
+  void process() override;
+
+ protected:
+  // called in parent before stream thread is started
+  virtual void initStream() { }
+
+  // called in child after output redirected (close any parent only files)
+  virtual void initChildStream() { }
+
+  // called on stream thread to consume data from fd until EOF
+  virtual void readStream(int fd) = 0;
+
+  // called in parent after stream thread has finished
+  virtual void termStream() { }
+
+  // record error on stream thread (reported by term)
+  void setStreamError(const std::string &msg);
+
+ private:
+  void startStream();
+  void stopStream();
+
+  static void streamThread(CCommandStreamDest *dest);
+
+ private:
+  int           dest_fd_    { 1 };
+  CCommandPipe *pipe_       { nullptr };
+  std::thread   thread_;
+  std::string   streamError_;
+  bool          started_    { false };
+  bool          terminated_ { false };
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CCommandStreamSrc_H
+#define CCommandStreamSrc_H
+
+#include <CCommandSrc.h>
+#include <thread>
+
+class CCommandPipe;
+
+// Base class for sources which write the command's stdin as it runs.
+// stdin is redirected from a pipe which is written by a thread in the parent
+// process (writeStream). The thread gets EPIPE (not SIGPIPE) if the command
+// stops reading.
+class CCommandStreamSrc : public CCommandSrc {
+ public:
+  CCommandStreamSrc(CCommand *command);
+
+ ~CCommandStreamSrc();
+
+  CCommandPipe *getPipe() const { return pipe_; }
+
+  void initParent() override;
+  void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
+  void term() override;
+
+  void process() override;
+
+ protected:
+  // called in parent before stream thread is started
+  virtual void initStream() { }
+
+  // called on stream thread to write data to fd (closed on return)
+  virtual void writeStream(int fd) = 0;
+
+  // called in parent after stream thread has finished
+  virtual void termStream() { }
+
+  // record error on stream thread (reported by term)
+  void setStreamError(const std::string &msg);
+
+  // write all data to fd, returns false on error (or EPIPE)
+  bool writeData(int fd, const char *data, size_t len);
+
+ private:
+  void startStream();
+  void stopStream();
+
+  static void streamThread(CCommandStreamSrc *src);
+
+ private:
+  CCommandPipe *pipe_    { nullptr };
+  std::thread   thread_;
+  bool          started_ { false };
+  std::string   streamError_;
+};
+
+#endif
@@ -13,6 +13,7 @@ class CCommandStringDest : public CCommandDest {
 
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
   void term() override;
 
   void process() override;
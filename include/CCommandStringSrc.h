@@ -13,8 +13,11 @@ class CCommandStringSrc : public CCommandSrc {
 
   void initParent() override;
   void initChild() override;
+  void initThread(CCommandStdio &stdio) override;
   void term() override;
 
+  bool hashData(CCommandHash &hash) const override;
+
   void process() override;
 
   CCommandPipe *getPipe() const { return pipe_; }
@@ -0,0 +1,47 @@
+#ifndef CCommandTailDest_H
+#define CCommandTailDest_H
+
+#include <CCommandStreamDest.h>
+#include <vector>
+
+// Capture only the first headSize and last tailSize bytes of command output
+// using fixed size buffers (memory use independent of output size).
+// On termination the string is set to the head followed by the tail.
+class CCommandTailDest : public CCommandStreamDest {
+ public:
+  CCommandTailDest(CCommand *command, std::string &str, size_t tailSize,
+                   size_t headSize=0, int dest_fd=1);
+
+ ~CCommandTailDest();
+
+  // total bytes written by command
+  size_t getTotalSize() const { return totalSize_; }
+
+  // number of bytes dropped between head and tail
+  size_t getSkippedSize() const;
+
+  bool isTruncated() const { return getSkippedSize() > 0; }
+
+  std::string getHead() const;
+  std::string getTail() const;
+
+ protected:
+  void initStream() override;
+  void readStream(int fd) override;
+  void termStream() override;
+
+ private:
+  using Buffer = std::vector<char>;
+
+  std::string &str_;
+  size_t       headSize_  { 0 };
+  size_t       tailSize_  { 0 };
+  Buffer       head_;
+  Buffer       tail_;
+  size_t       headLen_   { 0 };
+  size_t       tailPos_   { 0 };
+  size_t       tailLen_   { 0 };
+  size_t       totalSize_ { 0 };
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CCommandTeeDest_H
+#define CCommandTeeDest_H
+
+#include <CCommandStreamDest.h>
+#include <vector>
+
+class CCommandPipeDest;
+
+// Fan out one command output to several pipe sources, files and strings.
+// On linux pipe and file branches are fed using tee(2)/splice(2) so the
+// data is only copied into user space when a string branch needs it.
+// A pipe branch whose reader exits is dropped and the others continue.
+class CCommandTeeDest : public CCommandStreamDest {
+ public:
+  CCommandTeeDest(CCommand *command, int dest_fd=1);
+
+ ~CCommandTeeDest();
+
+  // add pipe branch (consumed by next CCommand::addPipeSrc)
+  void addPipe();
+
+  void addFile(const std::string &filename, bool append=false);
+
+  void addString(std::string &str);
+
+ protected:
+  void initStream() override;
+  void initChildStream() override;
+  void readStream(int fd) override;
+  void termStream() override;
+
+ private:
+  struct FileData {
+    std::string filename;
+    bool        append { false };
+    int         fd     { -1 };
+  };
+
+  using PipeDests = std::vector<CCommandPipeDest *>;
+  using Files     = std::vector<FileData>;
+  using Strings   = std::vector<std::string *>;
+  using Fds       = std::vector<int>;
+
+  bool spliceStream(int fd, const Fds &pipeFds);
+
+  void copyStream(int fd, Fds pipeFds);
+
+  // discard rest of output (all branches closed or write error)
+  void drainStream(int fd);
+
+  static void removeFds(Fds &fds, const Fds &closed);
+
+  // write all data, EPIPE for branch pipe is returned (errno) but not an error
+  bool writeData(int fd, const char *data, size_t len, bool branch=false);
+
+ private:
+  PipeDests pipeDests_;
+  Files     files_;
+  Strings   strs_;
+};
+
+#endif
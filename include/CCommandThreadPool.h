@@ -0,0 +1,63 @@
+#ifndef CCommandThreadPool_H
+#define CCommandThreadPool_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CCommandThreadJob;
+
+// Pool of threads used to run thread commands (see CCommandMgr::getThreadPool).
+//
+// Idle threads are reused and a new thread is created when there are more
+// queued jobs than idle threads. If a maximum number of threads is set jobs
+// wait for a free thread, so connected thread commands in a pipeline must
+// not exceed it.
+class CCommandThreadPool {
+ public:
+  using Proc = void (*)(void *data);
+
+ public:
+  CCommandThreadPool();
+ ~CCommandThreadPool();
+
+  // maximum number of threads (0 for no limit)
+  int getMaxThreads() const { return maxThreads_; }
+  void setMaxThreads(int n) { maxThreads_ = n; }
+
+  int getNumThreads() const;
+
+  // run proc on pool thread
+  CCommandThreadJob *start(Proc proc, void *data);
+
+  // wait for job to finish (job is deleted)
+  void wait(CCommandThreadJob *job);
+
+  // is job finished (wait will not block)
+  bool isDone(CCommandThreadJob *job) const;
+
+ private:
+  CCommandThreadPool(const CCommandThreadPool &) = delete;
+  CCommandThreadPool &operator=(const CCommandThreadPool &) = delete;
+
+  void worker();
+
+  static void workerThread(CCommandThreadPool *pool);
+
+ private:
+  using Jobs    = std::deque<CCommandThreadJob *>;
+  using Threads = std::vector<std::thread>;
+
+  mutable std::mutex      mutex_;
+  std::condition_variable jobCond_;
+  std::condition_variable doneCond_;
+  Jobs                    jobs_;
+  Threads                 threads_;
+  int                     maxThreads_ { 0 };
+  int                     numIdle_    { 0 };
+  bool                    stop_       { false };
+};
+
+#endif
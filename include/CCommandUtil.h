@@ -1,9 +1,59 @@
 #ifndef CCommandUtil_H
 #define CCommandUtil_H
 
+#include <csignal>
+#include <thread>
+
 class CCommandUtil {
  public:
   static void outputMsg(const char *format, ...);
+
+  // create thread running proc(data) with SIGCHLD and SIGPIPE blocked (the
+  // SIGCHLD handler must not run on library threads and their writes to a
+  // closed pipe get EPIPE rather than SIGPIPE)
+  template<typename T>
+  static std::thread createThread(void (*proc)(T *), T *data) {
+    sigset_t mask, oldMask;
+
+    sigemptyset(&mask);
+    sigaddset  (&mask, SIGCHLD);
+    sigaddset  (&mask, SIGPIPE);
+
+    // thread inherits blocked mask
+    pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+
+    std::thread thread(proc, data);
+
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+
+    return thread;
+  }
+};
+
+// block SIGCHLD in scope (stops handler reaping processes or iterating
+// commands while they are being changed)
+class CCommandBlockSigChild {
+ public:
+  CCommandBlockSigChild(bool block=true) :
+   block_(block) {
+    if (! block_) return;
+
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset  (&mask, SIGCHLD);
+
+    sigprocmask(SIG_BLOCK, &mask, &oldMask_);
+  }
+
+ ~CCommandBlockSigChild() {
+    if (block_)
+      sigprocmask(SIG_SETMASK, &oldMask_, nullptr);
+  }
+
+ private:
+  bool     block_ { false };
+  sigset_t oldMask_;
 };
 
 #endif
@@ -2,11 +2,23 @@
 #include <CCommandMgr.h>
 #include <CCommandFileSrc.h>
 #include <CCommandFileDest.h>
+#include <CCommandMapFileSrc.h>
 #include <CCommandPipeSrc.h>
 #include <CCommandPipeDest.h>
 #include <CCommandStringSrc.h>
+#include <CCommandBufferSrc.h>
+#include <CCommandGeneratorSrc.h>
+#include <CCommandRangeFileSrc.h>
 #include <CCommandStringDest.h>
+#include <CCommandTeeDest.h>
+#include <CCommandCallbackDest.h>
+#include <CCommandTailDest.h>
+#include <CCommandCompressDest.h>
+#include <CCommandOutputDest.h>
 #include <CCommandPipe.h>
+#include <CCommandStdio.h>
+#include <CCommandThreadPool.h>
+#include <CCommandReaper.h>
 #include <CCommandUtil.h>
 #include <COSProcess.h>
 #include <COSSignal.h>
@@ -18,9 +30,21 @@
 #include <cassert>
 #include <cstring>
 #include <fcntl.h>
+#include <csignal>
+#include <thread>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 
+namespace {
+
+// command whose callback/thread proc is running on this thread
+thread_local CCommand *currentCommand = nullptr;
+
+}
+
 CCommand::
 CCommand(const std::string &cmdStr, bool doFork) :
  name_   (cmdStr),
@@ -55,11 +79,26 @@ CCommand(const std::string &name, CallbackProc proc, CallbackData data,
   init(args);
 }
 
+CCommand::
+CCommand(const std::string &name, ThreadProc proc, CallbackData data,
+         const std::vector<std::string> &args) :
+ name_        (name),
+ callbackData_(data),
+ threadProc_  (proc),
+ state_       (State::IDLE)
+{
+  init(args);
+}
+
 CCommand::
 ~CCommand()
 {
   stop();
 
+  termPending();
+
+  waitThread();
+
   CCommandMgrInst->deleteCommand(this);
 
   deleteSrcs();
@@ -90,6 +129,41 @@ getCommandString() const
   return str;
 }
 
+CCommand *
+CCommand::
+getCurrent()
+{
+  return currentCommand;
+}
+
+CCommandMapFileSrc *
+CCommand::
+getMapFileSrc() const
+{
+  for (auto *src : srcList_) {
+    auto *mapSrc = dynamic_cast<CCommandMapFileSrc *>(src);
+
+    if (mapSrc)
+      return mapSrc;
+  }
+
+  return nullptr;
+}
+
+void
+CCommand::
+addSrc(CCommandSrc *src)
+{
+  srcList_.push_back(src);
+}
+
+void
+CCommand::
+addDest(CCommandDest *dest)
+{
+  destList_.push_back(dest);
+}
+
 void
 CCommand::
 addFileSrc(const std::string &filename)
@@ -138,6 +212,50 @@ addStringSrc(const std::string &str)
   srcList_.push_back(src);
 }
 
+CCommandMapFileSrc *
+CCommand::
+addMapFileSrc(const std::string &filename)
+{
+  auto *src = new CCommandMapFileSrc(this, filename);
+
+  srcList_.push_back(src);
+
+  return src;
+}
+
+CCommandBufferSrc *
+CCommand::
+addBufferSrc()
+{
+  auto *src = new CCommandBufferSrc(this);
+
+  srcList_.push_back(src);
+
+  return src;
+}
+
+CCommandGeneratorSrc *
+CCommand::
+addGeneratorSrc(SrcGeneratorProc proc, CallbackData data)
+{
+  auto *src = new CCommandGeneratorSrc(this, proc, data);
+
+  srcList_.push_back(src);
+
+  return src;
+}
+
+CCommandRangeFileSrc *
+CCommand::
+addRangeFileSrc(const std::string &filename, off_t start, off_t end, char delim)
+{
+  auto *src = new CCommandRangeFileSrc(this, filename, start, end, delim);
+
+  srcList_.push_back(src);
+
+  return src;
+}
+
 void
 CCommand::
 addFileDest(const std::string &filename, int fd)
@@ -182,6 +300,67 @@ addStringDest(std::string &str, int fd)
   destList_.push_back(dest);
 }
 
+CCommandTeeDest *
+CCommand::
+addTeeDest(int fd)
+{
+  auto *dest = new CCommandTeeDest(this, fd);
+
+  destList_.push_back(dest);
+
+  return dest;
+}
+
+CCommandCallbackDest *
+CCommand::
+addCallbackDest(DestCallbackProc proc, CallbackData data, bool lines, int fd)
+{
+  auto mode = (lines ? CCommandCallbackDest::Mode::LINE : CCommandCallbackDest::Mode::CHUNK);
+
+  auto *dest = new CCommandCallbackDest(this, proc, data, mode, fd);
+
+  destList_.push_back(dest);
+
+  return dest;
+}
+
+CCommandTailDest *
+CCommand::
+addTailDest(std::string &str, size_t tailSize, size_t headSize, int fd)
+{
+  auto *dest = new CCommandTailDest(this, str, tailSize, headSize, fd);
+
+  destList_.push_back(dest);
+
+  return dest;
+}
+
+CCommandOutputDest *
+CCommand::
+addOutputDest(int fd)
+{
+  auto *dest = new CCommandOutputDest(this, fd);
+
+  destList_.push_back(dest);
+
+  return dest;
+}
+
+CCommandCompressDest *
+CCommand::
+addCompressFileDest(const std::string &filename, int level, bool zstd, int fd)
+{
+  auto format = (zstd ? CCommandCompressDest::Format::ZSTD : CCommandCompressDest::Format::GZIP);
+
+  auto *dest = new CCommandCompressDest(this, filename, format, fd);
+
+  dest->setLevel(level);
+
+  destList_.push_back(dest);
+
+  return dest;
+}
+
 void
 CCommand::
 setFileDestOverwrite(bool overwrite, int fd)
@@ -210,6 +389,20 @@ setFileDestAppend(bool append, int fd)
   }
 }
 
+void
+CCommand::
+setFileDestSinkMode(bool sinkMode, off_t sizeHint, int fd)
+{
+  for (auto *dest : destList_) {
+    auto *fileDest = dynamic_cast<CCommandFileDest *>(dest);
+
+    if (fileDest != nullptr && fileDest->getFd() == fd) {
+      fileDest->setSinkMode(sinkMode);
+      fileDest->setSizeHint(sizeHint);
+    }
+  }
+}
+
 void
 CCommand::
 start()
@@ -217,13 +410,37 @@ start()
   if (CCommandMgrInst->getDebug())
     CCommandUtil::outputMsg("Start command %s\n", name_.c_str());
 
+  // exec command with registered builtin is run on a thread instead
+  if (! callbackProc_ && ! threadProc_ && allowBuiltin_)
+    builtinProc_ = CCommandMgrInst->getBuiltin(name_, args_);
+
+  if (isThread()) {
+    startThread();
+    return;
+  }
+
   if (doFork_) {
     initParentDests();
     initParentSrcs ();
 
+    // SIGCHLD handler (on any thread) must not reap a quickly exiting child
+    // before it is recorded as running (status would be lost)
+    reaping_ = true;
+
+    {
+    CCommandBlockSigChild blockSigChild;
+
+    // pipes may be created/closed by commands on other threads
+    CCommandPipe::lockPipes();
+
     pid_ = fork();
 
+    CCommandPipe::unlockPipes();
+    }
+
     if      (pid_ < 0) {
+      reaping_ = false;
+
       throwError(std::string("fork: ") + strerror(errno));
       return;
     }
@@ -231,12 +448,12 @@ start()
     else if (pid_ == 0) {
       pid_ = COSProcess::getProcessId();
 
+      reaping_ = false;
+
       updateProcessGroup();
 
       resetSignals();
 
-      CCommandPipe::deleteOthers(this);
-
       child_ = true;
 
       initChildDests();
@@ -247,8 +464,12 @@ start()
       else {
         setReturnCode(0);
 
+        currentCommand = this;
+
         callbackProc_(args_, callbackData_);
 
+        currentCommand = nullptr;
+
         setState(State::EXITED);
       }
 
@@ -272,6 +493,8 @@ start()
 
       setState(State::RUNNING);
 
+      reaping_ = false;
+
       processSrcs ();
       processDests();
     }
@@ -287,8 +510,12 @@ start()
 
     assert(callbackProc_);
 
+    currentCommand = this;
+
     callbackProc_(args_, callbackData_);
 
+    currentCommand = nullptr;
+
     setState(State::EXITED);
 
     processDests();
@@ -301,26 +528,47 @@ start()
   }
 }
 
+std::future<CCommandResult>
+CCommand::
+startAsync(bool captureOutput, bool captureError)
+{
+  return CCommandMgrInst->getReaper()->start(this, captureOutput, captureError);
+}
+
 void
 CCommand::
-pause()
+pause(bool group)
 {
+  // thread command has no process to signal
+  if (isThread())
+    return;
+
   if (isState(State::RUNNING)) {
-    int errorCode = COSSignal::sendSignal(pid_, SIGSTOP);
+    pid_t pid = (group && pgid_ > 0 ? -pgid_ : pid_);
+
+    int errorCode = COSSignal::sendSignal(pid, SIGSTOP);
 
     if (errorCode < 0) {
       throwError(std::string("kill: ") + strerror(errno) + ".");
       return;
     }
+
+    // stop may not be reported (async command) before resume
+    setState(State::STOPPED);
   }
 }
 
 void
 CCommand::
-resume()
+resume(bool group)
 {
+  if (isThread())
+    return;
+
   if (isState(State::STOPPED)) {
-    int errorCode = COSSignal::sendSignal(pid_, SIGCONT);
+    pid_t pid = (group && pgid_ > 0 ? -pgid_ : pid_);
+
+    int errorCode = COSSignal::sendSignal(pid, SIGCONT);
 
     if (errorCode < 0) {
       throwError(std::string("kill: ") + strerror(errno) + ".");
@@ -335,6 +583,9 @@ void
 CCommand::
 stop()
 {
+  if (isThread())
+    return;
+
   if (isState(State::RUNNING) || isState(State::STOPPED)) {
     int errorCode = COSSignal::sendSignal(pid_, SIGTERM);
 
@@ -349,6 +600,9 @@ void
 CCommand::
 tstop()
 {
+  if (isThread())
+    return;
+
   if (isState(State::RUNNING)) {
     int errorCode = COSSignal::sendSignal(pid_, SIGTSTP);
 
@@ -363,7 +617,9 @@ void
 CCommand::
 wait()
 {
-  if (! doFork_) {
+  if      (isThread())
+    waitThread();
+  else if (! doFork_) {
     assert(isState(State::EXITED));
   }
   else {
@@ -380,7 +636,9 @@ wait()
     }
 
     while (! isState(State::EXITED) && ! isState(State::STOPPED))
-      wait_pid(pid_, false);
+      reapProcess(false);
+
+    termPending();
 
     if (fd != -1 && pgid_ != pgid) {
       COSSignal::ignoreSignal(SIGTTOU);
@@ -399,18 +657,107 @@ void
 CCommand::
 waitpid()
 {
+  if (isThread()) {
+    waitThread();
+    return;
+  }
+
   while (! isState(State::EXITED) && ! isState(State::STOPPED))
-    wait_pid(pid_, false);
+    reapProcess(false);
+
+  termPending();
 }
 
 void
 CCommand::
 waitpgid()
 {
+  if (isThread()) {
+    waitThread();
+    return;
+  }
+
   assert(pgid_);
 
   while (! isState(State::EXITED) && ! isState(State::STOPPED))
-    wait_pid(-pgid_, false);
+    wait_pgid(pgid_);
+
+  termPending();
+}
+
+bool
+CCommand::
+tryWait()
+{
+  if (isThread()) {
+    if (threadJob_ && ! CCommandMgrInst->getThreadPool()->isDone(threadJob_))
+      return false;
+
+    waitThread();
+
+    return isState(State::EXITED);
+  }
+
+  if (doFork_ && pid_ > 0) {
+    if (isState(State::RUNNING) || isState(State::STOPPED))
+      reapProcess(/*nohang*/true);
+
+    // signalled process is finished by ECHILD from next waitpid (as in wait)
+    if (isState(State::SIGNALLED))
+      reapProcess(/*nohang*/true);
+  }
+
+  termPending();
+
+  return isState(State::EXITED);
+}
+
+bool
+CCommand::
+reapAsync()
+{
+  if (isThread()) {
+    waitThread();
+
+    return isState(State::EXITED);
+  }
+
+  int status;
+
+  struct rusage usage;
+
+  // no WUNTRACED (only called when process has exited)
+  pid_t pid = ::wait4(pid_, &status, WNOHANG, &usage);
+
+  if (pid == 0)
+    return false;
+
+  if (pid < 0) {
+    if (errno == EINTR)
+      return false;
+
+    // status lost (reaped elsewhere)
+    setReturnCode(-1);
+    setState     (State::EXITED);
+
+    exited(false);
+
+    return true;
+  }
+
+  usage_ = usage;
+
+  processStatus(status, false);
+
+  // signalled process is finished (as by ECHILD from next waitpid in wait)
+  if (isState(State::SIGNALLED)) {
+    setReturnCode(-1);
+    setState     (State::EXITED);
+
+    exited(false);
+  }
+
+  return isState(State::EXITED);
 }
 
 void
@@ -446,54 +793,66 @@ resetSignals()
   COSSignal::defaultSignal(SIGWINCH);
 
   COSSignal::addSignalHandler(SIGTSTP , COSSignal::SignalHandler(signalStop));
+
+  // parent may block SIGCHLD while starting commands (mask is inherited)
+  sigset_t mask;
+
+  sigemptyset(&mask);
+  sigaddset  (&mask, SIGCHLD);
+
+  sigprocmask(SIG_UNBLOCK, &mask, nullptr);
 }
 
 void
 CCommand::
 signalChild(int)
 {
+  // interrupted code may check errno
+  int saveErrno = errno;
+
   if (CCommandMgrInst->getDebug())
     CCommandUtil::outputMsg("SignalChild\n");
 
-  wait_pid(-1, true);
+  // map is being changed on another thread (blocking here could deadlock),
+  // commands are still reaped by wait
+  std::unique_lock<std::mutex> mapLock(CCommandMgrInst->getMapMutex(), std::try_to_lock);
+
+  if (! mapLock.owns_lock()) {
+    errno = saveErrno;
+    return;
+  }
 
   CCommandMgr::CommandMap::iterator p1, p2;
 
   for (p1 = CCommandMgrInst->commandsBegin(), p2 = CCommandMgrInst->commandsEnd(); p1 != p2; ++p1) {
     CCommand *command = (*p1).second;
 
-    if (command->isState(State::EXITED))
+    // async command state is owned by reaper thread
+    if (command->async_ || command->isState(State::EXITED))
+      continue;
+
+    // not started (waitpid(0) would reap any child in the process group)
+    if (command->pid_ <= 0)
       continue;
 
-    wait_pid(command->pid_, true);
+    // only reap known commands (reaping any child would take the status of
+    // async commands and of children whose command is still starting)
+    command->reapProcess(/*nohang*/true);
   }
+
+  errno = saveErrno;
 }
 
 void
 CCommand::
-wait_pid(pid_t pid, bool nohang)
+reapProcess(bool nohang)
 {
-  CCommand *command = nullptr;
-
-  if (pid > 0)
-    command = CCommandMgrInst->lookup(pid);
-
-  if (CCommandMgrInst->getDebug()) {
-    if (pid > 0) {
-      if (command)
-        CCommandUtil::outputMsg("Waiting for process %s\n", command->name_.c_str());
-      else
-        CCommandUtil::outputMsg("Waiting for process %d\n", pid);
-    }
-    else {
-      if (pid == -1)
-        CCommandUtil::outputMsg("Waiting for all children\n");
-      else
-        CCommandUtil::outputMsg("Waiting for process group %d\n", -pid);
-    }
-  }
+  if (CCommandMgrInst->getDebug())
+    CCommandUtil::outputMsg("Waiting for process %s\n", name_.c_str());
 
-  int status;
+  // while blocked waiting, stop the SIGCHLD handler on this thread trying to
+  // reap the process while this thread has claimed it
+  CCommandBlockSigChild blockSigChild(! nohang);
 
   int flags = WUNTRACED;
 
@@ -501,94 +860,286 @@ wait_pid(pid_t pid, bool nohang)
   flags |= WCONTINUED;
 #endif
 
-  if (nohang)
-    flags |= WNOHANG;
+  // wait for state change without reaping (so only the claiming thread gets
+  // the status)
+  if (! nohang) {
+    siginfo_t info;
 
-  pid_t wait_pid = ::waitpid(pid, &status, flags);
+    memset(&info, 0, sizeof(info));
 
-  if (nohang && wait_pid == 0)
-    return;
+    int peekFlags = WEXITED | WSTOPPED | WNOWAIT;
 
-  if (pid == -1 && wait_pid > 0)
-    command = CCommandMgrInst->lookup(wait_pid);
+#ifdef WCONTINUED
+    peekFlags |= WCONTINUED;
+#endif
 
-  if (wait_pid > 0) {
-    if (command == nullptr)
+    (void) waitid(P_PID, id_t(pid_), &info, peekFlags);
+  }
+
+  // only one thread (waiter or SIGCHLD handler) reaps process at a time, a
+  // handler finding it claimed leaves it to the claiming thread
+  while (reaping_.exchange(true)) {
+    if (nohang)
       return;
 
-    if      (WIFEXITED(status)) {
-      int returnCode = WEXITSTATUS(status);
+    std::this_thread::yield();
+  }
 
-      if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Process %s Exited %d\n", command->name_.c_str(), returnCode);
+  // reaped by another thread while waiting for claim
+  if (isState(State::EXITED)) {
+    reaping_ = false;
+    return;
+  }
 
-      command->setReturnCode(returnCode);
-      command->setState     (State::EXITED);
+  int status;
 
-      command->termSrcs();
-      command->termDests();
+  struct rusage usage;
 
-      command->died();
-    }
-    else if (WIFSTOPPED(status)) {
-      int signalNum = WSTOPSIG(status);
+  pid_t wait_pid = ::wait4(pid_, &status, flags | WNOHANG, &usage);
 
+  if      (wait_pid > 0) {
+    usage_ = usage;
+
+    processStatus(status, nohang);
+  }
+  else if (wait_pid < 0) {
+    if      (errno == ECHILD) {
+      // reaped outside commands (status lost) or signalled process finished
       if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Process %s Stopped '%s'(%d)\n", command->name_.c_str(),
-                                COSSignal::strsignal(signalNum).c_str(), signalNum);
+        CCommandUtil::outputMsg("Process %s Does Not Exist\n", name_.c_str());
 
-      command->setSignalNum(signalNum);
-      command->setState    (State::STOPPED);
-    }
-    else if (WIFSIGNALED(status)) {
-      int signalNum = WTERMSIG(status);
+      setReturnCode(-1);
+      setState     (State::EXITED);
 
+      exited(nohang);
+    }
+    else if (errno == EINTR) {
       if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Process %s Signalled '%s'(%d)\n", command->name_.c_str(),
-                                COSSignal::strsignal(signalNum).c_str(), signalNum);
-
-      command->setSignalNum(signalNum);
-      command->setState    (State::SIGNALLED);
+        CCommandUtil::outputMsg("Interrrupted System Call\n");
     }
-#ifdef WIFCONTINUED
-    else if (WIFCONTINUED(status)) {
+    else {
       if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Process %s Continued\n", command->name_.c_str());
-
-      command->setState(State::RUNNING);
+        CCommandUtil::outputMsg("Unknown error from waitpid\n");
     }
+  }
+
+  reaping_ = false;
+}
+
+void
+CCommand::
+wait_pgid(pid_t pgid)
+{
+  if (CCommandMgrInst->getDebug())
+    CCommandUtil::outputMsg("Waiting for process group %d\n", pgid);
+
+  // wait for any member to change state without reaping it, then reap it
+  // as its command (status can't be taken by another thread's wait)
+  CCommandBlockSigChild blockSigChild;
+
+  siginfo_t info;
+
+  memset(&info, 0, sizeof(info));
+
+  int flags = WEXITED | WSTOPPED | WNOWAIT;
+
+#ifdef WCONTINUED
+  flags |= WCONTINUED;
 #endif
+
+  if (waitid(P_PGID, id_t(pgid), &info, flags) < 0 || info.si_pid <= 0)
+    return;
+
+  CCommand *command = nullptr;
+
+  {
+  std::unique_lock<std::mutex> mapLock(CCommandMgrInst->getMapMutex());
+
+  command = CCommandMgrInst->lookup(info.si_pid);
   }
+
+  if (command)
+    command->reapProcess(false);
   else {
-    if (errno == ECHILD) {
-      if (command != nullptr) {
-        if (CCommandMgrInst->getDebug())
-          CCommandUtil::outputMsg("Process %s Does Not Exist\n", command->name_.c_str());
+    // not a command process (stop waiting for it)
+    int status;
 
-        int returnCode = -1;
+    (void) ::wait4(info.si_pid, &status, WNOHANG | WUNTRACED, nullptr);
+  }
+}
 
-        command->setReturnCode(returnCode);
-        command->setState     (State::EXITED);
+void
+CCommand::
+processStatus(int status, bool inSignal)
+{
+  if      (WIFEXITED(status)) {
+    int returnCode = WEXITSTATUS(status);
 
-        command->termSrcs();
-        command->termDests();
+    if (CCommandMgrInst->getDebug())
+      CCommandUtil::outputMsg("Process %s Exited %d\n", name_.c_str(), returnCode);
 
-        command->died();
-      }
-      else {
-        if (CCommandMgrInst->getDebug())
-          CCommandUtil::outputMsg("No matching command for ECHILD from waitpid\n");
-      }
-    }
-    else if (errno == EINTR) {
-      if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Interrrupted System Call\n");
-    }
-    else {
-      if (CCommandMgrInst->getDebug())
-        CCommandUtil::outputMsg("Unknown error from waitpid\n");
-    }
+    setReturnCode(returnCode);
+    setState     (State::EXITED);
+
+    exited(inSignal);
+  }
+  else if (WIFSTOPPED(status)) {
+    int signalNum = WSTOPSIG(status);
+
+    if (CCommandMgrInst->getDebug())
+      CCommandUtil::outputMsg("Process %s Stopped '%s'(%d)\n", name_.c_str(),
+                              COSSignal::strsignal(signalNum).c_str(), signalNum);
+
+    setSignalNum(signalNum);
+    setState    (State::STOPPED);
+  }
+  else if (WIFSIGNALED(status)) {
+    int signalNum = WTERMSIG(status);
+
+    if (CCommandMgrInst->getDebug())
+      CCommandUtil::outputMsg("Process %s Signalled '%s'(%d)\n", name_.c_str(),
+                              COSSignal::strsignal(signalNum).c_str(), signalNum);
+
+    setSignalNum(signalNum);
+    setState    (State::SIGNALLED);
+  }
+#ifdef WIFCONTINUED
+  else if (WIFCONTINUED(status)) {
+    if (CCommandMgrInst->getDebug())
+      CCommandUtil::outputMsg("Process %s Continued\n", name_.c_str());
+
+    setState(State::RUNNING);
   }
+#endif
+}
+
+void
+CCommand::
+exited(bool inSignal)
+{
+  // srcs/dests may join threads (which can need locks held by the interrupted
+  // code) so when reaped by the SIGCHLD handler termination is done by wait
+  if (inSignal) {
+    termPending_ = true;
+    return;
+  }
+
+  termPending_ = false;
+
+  termSrcs ();
+  termDests();
+
+  died();
+}
+
+void
+CCommand::
+termPending()
+{
+  // process may still be being reaped (on another thread), wait for its
+  // status to be recorded
+  while (reaping_.exchange(true))
+    std::this_thread::yield();
+
+  bool pending = termPending_;
+
+  termPending_ = false;
+
+  reaping_ = false;
+
+  if (pending)
+    exited(false);
+}
+
+void
+CCommand::
+startThread()
+{
+  if (CCommandMgrInst->getDebug())
+    CCommandUtil::outputMsg("Thread command %s\n", name_.c_str());
+
+  initParentDests();
+  initParentSrcs ();
+
+  // thread gets private copies of the fds a forked child would use
+  delete stdio_;
+
+  stdio_ = new CCommandStdio;
+
+  initThreadDests();
+  initThreadSrcs ();
+
+  setReturnCode(0);
+
+  setState(State::RUNNING);
+
+  threadJob_ = CCommandMgrInst->getThreadPool()->start(runThread, this);
+
+  processSrcs ();
+  processDests();
+}
+
+void
+CCommand::
+runThread(void *data)
+{
+  auto *command = static_cast<CCommand *>(data);
+
+  auto *stdio = command->stdio_;
+
+  // thread cpu time used by command (pool thread is reused)
+  struct rusage usage1, usage2;
+
+  getrusage(RUSAGE_THREAD, &usage1);
+
+  currentCommand = command;
+
+  if (command->builtinProc_)
+    command->threadRc_ = command->builtinProc_(command->args_, stdio->getFd(0),
+                                               stdio->getFd(1), stdio->getFd(2));
+  else
+    command->threadRc_ = command->threadProc_(command->args_, *stdio,
+                                              command->callbackData_);
+
+  currentCommand = nullptr;
+
+  // EOF for readers of output, EPIPE for writers of input
+  stdio->close();
+
+  getrusage(RUSAGE_THREAD, &usage2);
+
+  command->usage_ = usage2;
+
+  timersub(&usage2.ru_utime, &usage1.ru_utime, &command->usage_.ru_utime);
+  timersub(&usage2.ru_stime, &usage1.ru_stime, &command->usage_.ru_stime);
+
+  if (command->async_)
+    CCommandMgrInst->getReaper()->threadDone(command);
+}
+
+void
+CCommand::
+waitThread()
+{
+  if (! threadJob_)
+    return;
+
+  CCommandMgrInst->getThreadPool()->wait(threadJob_);
+
+  threadJob_ = nullptr;
+
+  setReturnCode(threadRc_);
+
+  setState(State::EXITED);
+
+  termSrcs ();
+  termDests();
+
+  died();
+
+  delete stdio_;
+
+  stdio_ = nullptr;
 }
 
 void
@@ -678,6 +1229,26 @@ initChildDests()
     (*p1)->initChild();
 }
 
+void
+CCommand::
+initThreadSrcs()
+{
+  SrcList::iterator p1, p2;
+
+  for (p1 = srcList_.begin(), p2 = srcList_.end(); p1 != p2; ++p1)
+    (*p1)->initThread(*stdio_);
+}
+
+void
+CCommand::
+initThreadDests()
+{
+  DestList::iterator p1, p2;
+
+  for (p1 = destList_.begin(), p2 = destList_.end(); p1 != p2; ++p1)
+    (*p1)->initThread(*stdio_);
+}
+
 void
 CCommand::
 processSrcs()
@@ -771,7 +1342,8 @@ setProcessGroupLeader()
 
   pgid_ = pid_;
 
-  if (! pid_)
+  // already started (otherwise set when forked)
+  if (pid_)
     COSProcess::setProcessGroupId(pid_);
 }
 
@@ -785,7 +1357,7 @@ setProcessGroup(CCommand *groupCommand)
   if (groupCommand->pid_ != 0)
     pgid_ = groupCommand->pid_;
 
-  if (! pid_ && ! pgid_)
+  if (pid_ && pgid_)
     COSProcess::setProcessGroupId(pid_, pgid_);
 }
 
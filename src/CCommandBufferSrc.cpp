@@ -0,0 +1,108 @@
+#include <CCommandBufferSrc.h>
+#include <CCommandHash.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+CCommandBufferSrc::
+CCommandBufferSrc(CCommand *command) :
+ CCommandStreamSrc(command)
+{
+}
+
+CCommandBufferSrc::
+~CCommandBufferSrc()
+{
+}
+
+void
+CCommandBufferSrc::
+addBuffer(const char *data, size_t len)
+{
+  if (len == 0)
+    return;
+
+  iovec iov;
+
+  iov.iov_base = const_cast<char *>(data);
+  iov.iov_len  = len;
+
+  iovs_.push_back(iov);
+}
+
+void
+CCommandBufferSrc::
+writeStream(int fd)
+{
+  // EPIPE if command stops reading (not an error)
+  if (! writeBuffers(fd) && errno != EPIPE)
+    setStreamError(std::string(useSplice_ ? "vmsplice: " : "writev: ") + strerror(errno));
+}
+
+bool
+CCommandBufferSrc::
+writeBuffers(int fd)
+{
+  // work on a copy as partial writes advance the iovecs
+  IOVecs iovs = iovs_;
+
+  size_t i = 0;
+
+  while (i < iovs.size()) {
+    int n = int(std::min(iovs.size() - i, size_t(IOV_MAX)));
+
+    ssize_t len;
+
+#ifdef __linux__
+    if (useSplice_) {
+      len = vmsplice(fd, &iovs[i], size_t(n), 0);
+
+      // not supported, fall back to writev
+      if (len < 0 && errno == EINVAL) {
+        useSplice_ = false;
+        continue;
+      }
+    }
+    else
+#endif
+      len = writev(fd, &iovs[i], n);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0)
+      return false;
+
+    // skip written buffers and advance into partially written one
+    size_t len1 = size_t(len);
+
+    while (i < iovs.size() && len1 >= iovs[i].iov_len) {
+      len1 -= iovs[i].iov_len;
+
+      ++i;
+    }
+
+    if (len1 > 0) {
+      iovs[i].iov_base = static_cast<char *>(iovs[i].iov_base) + len1;
+      iovs[i].iov_len -= len1;
+    }
+  }
+
+  return true;
+}
+
+bool
+CCommandBufferSrc::
+hashData(CCommandHash &hash) const
+{
+  hash.addString("buffer");
+
+  for (const auto &iov : iovs_) {
+    hash.addInt(iov.iov_len);
+    hash.addData(iov.iov_base, iov.iov_len);
+  }
+
+  return true;
+}
@@ -0,0 +1,932 @@
+#include <CCommandBuiltins.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t BufferSize = 65536;
+
+ssize_t readData(int fd, char *buffer, size_t size) {
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, size);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    return len;
+  }
+}
+
+bool writeData(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t len1 = ::write(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 <= 0)
+      return false;
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+void writeError(int err, const std::string &msg) {
+  std::string str = msg + "\n";
+
+  (void) writeData(err, str.c_str(), str.size());
+}
+
+// open named input file ("" or "-" is stdin), returns -1 on error
+int openInput(const std::string &cmd, const std::string &file, int in, int err) {
+  if (file == "" || file == "-")
+    return in;
+
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    writeError(err, cmd + ": " + file + ": " + strerror(errno));
+
+  return fd;
+}
+
+void closeInput(int fd, int in) {
+  if (fd >= 0 && fd != in)
+    ::close(fd);
+}
+
+// buffered output
+class Output {
+ public:
+  Output(int fd) : fd_(fd) { }
+
+  bool write(const char *data, size_t len) {
+    if (buffer_.size() + len > BufferSize && ! flush())
+      return false;
+
+    if (len > BufferSize)
+      return writeData(fd_, data, len);
+
+    buffer_.append(data, len);
+
+    return true;
+  }
+
+  bool flush() {
+    bool rc = writeData(fd_, buffer_.c_str(), buffer_.size());
+
+    buffer_.clear();
+
+    return rc;
+  }
+
+ private:
+  int         fd_ { -1 };
+  std::string buffer_;
+};
+
+// reads lines from fd (last line may have no newline)
+class LineReader {
+ public:
+  LineReader(int fd) : fd_(fd) { }
+
+  bool next(const char *&line, size_t &len) {
+    for (;;) {
+      auto p = buffer_.find('\n', pos_);
+
+      if (p != std::string::npos) {
+        line = &buffer_[pos_];
+        len  = p - pos_;
+        pos_ = p + 1;
+
+        return true;
+      }
+
+      if (eof_) {
+        if (pos_ >= buffer_.size())
+          return false;
+
+        line = &buffer_[pos_];
+        len  = buffer_.size() - pos_;
+        pos_ = buffer_.size();
+
+        return true;
+      }
+
+      buffer_.erase(0, pos_);
+
+      pos_ = 0;
+
+      char data[BufferSize];
+
+      ssize_t len1 = readData(fd_, data, sizeof(data));
+
+      if (len1 < 0)
+        error_ = true;
+
+      if (len1 <= 0)
+        eof_ = true;
+      else
+        buffer_.append(data, size_t(len1));
+    }
+  }
+
+  // input ended with read error (not EOF)
+  bool isError() const { return error_; }
+
+ private:
+  int         fd_    { -1 };
+  std::string buffer_;
+  size_t      pos_   { 0 };
+  bool        eof_   { false };
+  bool        error_ { false };
+};
+
+// copy remaining input to output
+bool copyData(int fd, int out) {
+  char buffer[BufferSize];
+
+  for (;;) {
+    ssize_t len = readData(fd, buffer, sizeof(buffer));
+
+    // read error is a failure (not EOF)
+    if (len < 0)
+      return false;
+
+    if (len == 0)
+      return true;
+
+    if (! writeData(out, buffer, size_t(len)))
+      return false;
+  }
+}
+
+// parse count ([+]digits)
+bool parseCount(const std::string &str, long &count, bool &plus) {
+  size_t i = 0;
+
+  plus = (str.size() > 0 && str[0] == '+');
+
+  if (plus) ++i;
+
+  if (i >= str.size())
+    return false;
+
+  count = 0;
+
+  for ( ; i < str.size(); ++i) {
+    if (! isdigit(str[i]))
+      return false;
+
+    count = 10*count + (str[i] - '0');
+  }
+
+  return true;
+}
+
+// head/tail args
+struct CountArgs {
+  bool        bytes { false };
+  long        count { 10 };
+  bool        plus  { false };
+  std::string file;
+};
+
+bool parseCountArgs(const CCommand::Args &args, bool allowPlus, CountArgs &countArgs) {
+  std::vector<std::string> files;
+
+  bool options = true;
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    const auto &arg = args[i];
+
+    if (! options || arg.size() < 2 || arg[0] != '-') {
+      files.push_back(arg);
+      continue;
+    }
+
+    if (arg == "--") {
+      options = false;
+      continue;
+    }
+
+    std::string value;
+
+    if      (arg[1] == 'n' || arg[1] == 'c') {
+      countArgs.bytes = (arg[1] == 'c');
+
+      if (arg.size() > 2)
+        value = arg.substr(2);
+      else {
+        if (i + 1 >= args.size())
+          return false;
+
+        value = args[++i];
+      }
+    }
+    else if (isdigit(arg[1]))
+      value = arg.substr(1);
+    else
+      return false;
+
+    if (! parseCount(value, countArgs.count, countArgs.plus))
+      return false;
+
+    if (countArgs.plus && ! allowPlus)
+      return false;
+  }
+
+  if (files.size() > 1)
+    return false;
+
+  if (! files.empty())
+    countArgs.file = files[0];
+
+  return true;
+}
+
+// wc args
+struct WcArgs {
+  bool        lines { false };
+  bool        words { false };
+  bool        chars { false };
+  std::string file;
+};
+
+bool parseWcArgs(const CCommand::Args &args, WcArgs &wcArgs) {
+  std::vector<std::string> files;
+
+  for (const auto &arg : args) {
+    if (arg.size() < 2 || arg[0] != '-') {
+      files.push_back(arg);
+      continue;
+    }
+
+    for (size_t i = 1; i < arg.size(); ++i) {
+      if      (arg[i] == 'l') wcArgs.lines = true;
+      else if (arg[i] == 'w') wcArgs.words = true;
+      else if (arg[i] == 'c') wcArgs.chars = true;
+      else return false;
+    }
+  }
+
+  if (files.size() > 1)
+    return false;
+
+  if (! files.empty())
+    wcArgs.file = files[0];
+
+  if (! wcArgs.lines && ! wcArgs.words && ! wcArgs.chars)
+    wcArgs.lines = wcArgs.words = wcArgs.chars = true;
+
+  return true;
+}
+
+// tee args
+bool parseTeeArgs(const CCommand::Args &args, bool &append, std::vector<std::string> &files) {
+  append = false;
+
+  for (const auto &arg : args) {
+    if      (arg == "-a")
+      append = true;
+    else if (arg.size() > 1 && arg[0] == '-')
+      return false;
+    else
+      files.push_back(arg);
+  }
+
+  return true;
+}
+
+// grep args
+struct GrepArgs {
+  bool        fixed   { false };
+  bool        invert  { false };
+  bool        count   { false };
+  bool        exact   { false };
+  bool        quiet   { false };
+  bool        icase   { false };
+  bool        pattern { false };
+  std::string patternStr;
+  std::string file;
+};
+
+bool parseGrepArgs(const CCommand::Args &args, GrepArgs &grepArgs) {
+  std::vector<std::string> files;
+
+  bool options = true;
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    const auto &arg = args[i];
+
+    if (! options || arg.size() < 2 || arg[0] != '-') {
+      if (! grepArgs.pattern) {
+        grepArgs.patternStr = arg;
+        grepArgs.pattern    = true;
+      }
+      else
+        files.push_back(arg);
+
+      continue;
+    }
+
+    if (arg == "--") {
+      options = false;
+      continue;
+    }
+
+    if (arg == "-e") {
+      if (grepArgs.pattern || i + 1 >= args.size())
+        return false;
+
+      grepArgs.patternStr = args[++i];
+      grepArgs.pattern    = true;
+
+      continue;
+    }
+
+    for (size_t j = 1; j < arg.size(); ++j) {
+      if      (arg[j] == 'F') grepArgs.fixed  = true;
+      else if (arg[j] == 'v') grepArgs.invert = true;
+      else if (arg[j] == 'c') grepArgs.count  = true;
+      else if (arg[j] == 'x') grepArgs.exact  = true;
+      else if (arg[j] == 'q') grepArgs.quiet  = true;
+      else if (arg[j] == 'i') grepArgs.icase  = true;
+      else return false;
+    }
+  }
+
+  // only fixed strings supported
+  if (! grepArgs.fixed || ! grepArgs.pattern || files.size() > 1)
+    return false;
+
+  if (! files.empty())
+    grepArgs.file = files[0];
+
+  return true;
+}
+
+std::string toLower(const char *str, size_t len) {
+  std::string lstr(str, len);
+
+  for (auto &c : lstr)
+    c = char(tolower(static_cast<unsigned char>(c)));
+
+  return lstr;
+}
+
+// start of last count lines of buffer
+size_t tailLinesStart(const std::string &buffer, long count) {
+  size_t pos = buffer.size();
+
+  // trailing newline ends last line
+  if (pos > 0 && buffer[pos - 1] == '\n')
+    --pos;
+
+  while (pos > 0) {
+    if (buffer[pos - 1] == '\n') {
+      if (--count <= 0)
+        return pos;
+    }
+
+    --pos;
+  }
+
+  return 0;
+}
+
+}
+
+//---
+
+bool
+CCommandBuiltins::
+catCheck(const Args &args)
+{
+  for (const auto &arg : args) {
+    if (arg.size() > 1 && arg[0] == '-')
+      return false;
+  }
+
+  return true;
+}
+
+int
+CCommandBuiltins::
+cat(const Args &args, int in, int out, int err)
+{
+  Args files = args;
+
+  if (files.empty())
+    files.push_back("-");
+
+  int rc = 0;
+
+  for (const auto &file : files) {
+    int fd = openInput("cat", file, in, err);
+
+    if (fd < 0) {
+      rc = 1;
+      continue;
+    }
+
+    bool rc1 = copyData(fd, out);
+
+    closeInput(fd, in);
+
+    if (! rc1)
+      return 1;
+  }
+
+  return rc;
+}
+
+//---
+
+bool
+CCommandBuiltins::
+headCheck(const Args &args)
+{
+  CountArgs countArgs;
+
+  return parseCountArgs(args, /*allowPlus*/false, countArgs);
+}
+
+int
+CCommandBuiltins::
+head(const Args &args, int in, int out, int err)
+{
+  CountArgs countArgs;
+
+  if (! parseCountArgs(args, /*allowPlus*/false, countArgs))
+    return 1;
+
+  int fd = openInput("head", countArgs.file, in, err);
+
+  if (fd < 0)
+    return 1;
+
+  long remaining = countArgs.count;
+
+  char buffer[BufferSize];
+
+  bool rc = true;
+
+  while (rc && remaining > 0) {
+    ssize_t len = readData(fd, buffer, sizeof(buffer));
+
+    if (len < 0)
+      rc = false;
+
+    if (len <= 0)
+      break;
+
+    size_t len1 = size_t(len);
+
+    if (countArgs.bytes) {
+      len1 = std::min(len1, size_t(remaining));
+
+      remaining -= long(len1);
+    }
+    else {
+      const char *p   = buffer;
+      const char *end = buffer + len;
+
+      while (remaining > 0 && p < end) {
+        auto *p1 = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+
+        if (! p1) {
+          p = end;
+          break;
+        }
+
+        p = p1 + 1;
+
+        --remaining;
+      }
+
+      len1 = size_t(p - buffer);
+    }
+
+    rc = writeData(out, buffer, len1);
+  }
+
+  // input not read to end (writer gets EPIPE like real head)
+  closeInput(fd, in);
+
+  return (rc ? 0 : 1);
+}
+
+//---
+
+bool
+CCommandBuiltins::
+tailCheck(const Args &args)
+{
+  CountArgs countArgs;
+
+  return parseCountArgs(args, /*allowPlus*/true, countArgs);
+}
+
+int
+CCommandBuiltins::
+tail(const Args &args, int in, int out, int err)
+{
+  CountArgs countArgs;
+
+  if (! parseCountArgs(args, /*allowPlus*/true, countArgs))
+    return 1;
+
+  int fd = openInput("tail", countArgs.file, in, err);
+
+  if (fd < 0)
+    return 1;
+
+  char buffer[BufferSize];
+
+  bool rc = true;
+
+  // +N : skip to Nth line/byte and copy rest
+  if (countArgs.plus) {
+    long skip = std::max(countArgs.count - 1, 0L);
+
+    for (;;) {
+      ssize_t len = readData(fd, buffer, sizeof(buffer));
+
+      if (len < 0)
+        rc = false;
+
+      if (len <= 0)
+        break;
+
+      const char *p   = buffer;
+      const char *end = buffer + len;
+
+      if      (countArgs.bytes) {
+        size_t len1 = std::min(size_t(len), size_t(skip));
+
+        p    += len1;
+        skip -= long(len1);
+      }
+      else {
+        while (skip > 0 && p < end) {
+          auto *p1 = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+
+          if (! p1) {
+            p = end;
+            break;
+          }
+
+          p = p1 + 1;
+
+          --skip;
+        }
+      }
+
+      if (p < end && ! writeData(out, p, size_t(end - p))) {
+        rc = false;
+        break;
+      }
+
+      if (skip == 0) {
+        rc = copyData(fd, out);
+        break;
+      }
+    }
+  }
+  // N : keep last N lines/bytes (trimmed when buffer grows)
+  else {
+    std::string data;
+
+    size_t trimSize = std::max(size_t(1024*1024), size_t(2*countArgs.count));
+
+    for (;;) {
+      ssize_t len = readData(fd, buffer, sizeof(buffer));
+
+      if (len < 0)
+        rc = false;
+
+      if (len <= 0)
+        break;
+
+      data.append(buffer, size_t(len));
+
+      if (data.size() > trimSize) {
+        size_t start = (countArgs.bytes ? data.size() - size_t(countArgs.count) :
+                                          tailLinesStart(data, countArgs.count));
+
+        data.erase(0, start);
+
+        trimSize = std::max(trimSize, 2*data.size());
+      }
+    }
+
+    size_t start;
+
+    if (countArgs.bytes)
+      start = (data.size() > size_t(countArgs.count) ? data.size() - size_t(countArgs.count) : 0);
+    else
+      start = (countArgs.count > 0 ? tailLinesStart(data, countArgs.count) : data.size());
+
+    if (rc)
+      rc = writeData(out, data.c_str() + start, data.size() - start);
+  }
+
+  closeInput(fd, in);
+
+  return (rc ? 0 : 1);
+}
+
+//---
+
+bool
+CCommandBuiltins::
+wcCheck(const Args &args)
+{
+  WcArgs wcArgs;
+
+  return parseWcArgs(args, wcArgs);
+}
+
+int
+CCommandBuiltins::
+wc(const Args &args, int in, int out, int err)
+{
+  WcArgs wcArgs;
+
+  if (! parseWcArgs(args, wcArgs))
+    return 1;
+
+  int fd = openInput("wc", wcArgs.file, in, err);
+
+  if (fd < 0)
+    return 1;
+
+  long numLines = 0, numWords = 0, numChars = 0;
+
+  bool inWord = false;
+
+  char buffer[BufferSize];
+
+  bool readError = false;
+
+  for (;;) {
+    ssize_t len = readData(fd, buffer, sizeof(buffer));
+
+    if (len < 0)
+      readError = true;
+
+    if (len <= 0)
+      break;
+
+    numChars += len;
+
+    for (ssize_t i = 0; i < len; ++i) {
+      char c = buffer[i];
+
+      if (c == '\n')
+        ++numLines;
+
+      if (wcArgs.words) {
+        if (isspace(static_cast<unsigned char>(c)))
+          inWord = false;
+        else if (! inWord) {
+          inWord = true;
+
+          ++numWords;
+        }
+      }
+    }
+  }
+
+  // field width as GNU wc (7 unless single count or regular file)
+  int numCounts = int(wcArgs.lines) + int(wcArgs.words) + int(wcArgs.chars);
+
+  int width = 1;
+
+  if (numCounts > 1) {
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+      width = int(std::to_string(st.st_size).size());
+    else
+      width = 7;
+  }
+
+  closeInput(fd, in);
+
+  std::string str;
+
+  auto addCount = [&](long count) {
+    char buffer1[32];
+
+    snprintf(buffer1, sizeof(buffer1), "%*ld", width, count);
+
+    if (str != "") str += " ";
+
+    str += buffer1;
+  };
+
+  if (wcArgs.lines) addCount(numLines);
+  if (wcArgs.words) addCount(numWords);
+  if (wcArgs.chars) addCount(numChars);
+
+  if (wcArgs.file != "" && wcArgs.file != "-")
+    str += " " + wcArgs.file;
+
+  str += "\n";
+
+  if (! writeData(out, str.c_str(), str.size()))
+    return 1;
+
+  return (readError ? 1 : 0);
+}
+
+//---
+
+bool
+CCommandBuiltins::
+teeCheck(const Args &args)
+{
+  bool                     append;
+  std::vector<std::string> files;
+
+  return parseTeeArgs(args, append, files);
+}
+
+int
+CCommandBuiltins::
+tee(const Args &args, int in, int out, int err)
+{
+  bool                     append;
+  std::vector<std::string> files;
+
+  if (! parseTeeArgs(args, append, files))
+    return 1;
+
+  int rc = 0;
+
+  std::vector<int> fds;
+
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+
+  for (const auto &file : files) {
+    int fd = ::open(file.c_str(), flags, 0666);
+
+    if (fd < 0) {
+      writeError(err, "tee: " + file + ": " + strerror(errno));
+      rc = 1;
+      continue;
+    }
+
+    fds.push_back(fd);
+  }
+
+  char buffer[BufferSize];
+
+  for (;;) {
+    ssize_t len = readData(in, buffer, sizeof(buffer));
+
+    if (len < 0)
+      rc = 1;
+
+    if (len <= 0)
+      break;
+
+    if (! writeData(out, buffer, size_t(len))) {
+      rc = 1;
+      break;
+    }
+
+    for (auto fd : fds) {
+      if (! writeData(fd, buffer, size_t(len))) {
+        writeError(err, std::string("tee: write: ") + strerror(errno));
+        rc = 1;
+      }
+    }
+  }
+
+  for (auto fd : fds)
+    ::close(fd);
+
+  return rc;
+}
+
+//---
+
+bool
+CCommandBuiltins::
+grepCheck(const Args &args)
+{
+  GrepArgs grepArgs;
+
+  return parseGrepArgs(args, grepArgs);
+}
+
+int
+CCommandBuiltins::
+grep(const Args &args, int in, int out, int err)
+{
+  GrepArgs grepArgs;
+
+  if (! parseGrepArgs(args, grepArgs))
+    return 2;
+
+  // newline separated list of patterns
+  std::vector<std::string> patterns;
+
+  std::string::size_type pos = 0;
+
+  for (;;) {
+    auto pos1 = grepArgs.patternStr.find('\n', pos);
+
+    std::string pattern = grepArgs.patternStr.substr(pos, pos1 - pos);
+
+    if (grepArgs.icase)
+      pattern = toLower(pattern.c_str(), pattern.size());
+
+    patterns.push_back(pattern);
+
+    if (pos1 == std::string::npos)
+      break;
+
+    pos = pos1 + 1;
+  }
+
+  int fd = openInput("grep", grepArgs.file, in, err);
+
+  if (fd < 0)
+    return 2;
+
+  auto matchLine = [&](const char *line, size_t len) {
+    std::string lline;
+
+    if (grepArgs.icase) {
+      lline = toLower(line, len);
+      line  = lline.c_str();
+    }
+
+    for (const auto &pattern : patterns) {
+      if (grepArgs.exact) {
+        if (len == pattern.size() && memcmp(line, pattern.c_str(), len) == 0)
+          return true;
+      }
+      else {
+        if (pattern.empty() || std::search(line, line + len,
+                                           pattern.begin(), pattern.end()) != line + len)
+          return true;
+      }
+    }
+
+    return false;
+  };
+
+  Output output(out);
+
+  LineReader reader(fd);
+
+  long numSelected = 0;
+
+  bool rc = true;
+
+  const char *line;
+  size_t      len;
+
+  while (rc && reader.next(line, len)) {
+    if (matchLine(line, len) == grepArgs.invert)
+      continue;
+
+    ++numSelected;
+
+    if (grepArgs.quiet)
+      break;
+
+    if (grepArgs.count)
+      continue;
+
+    rc = (output.write(line, len) && output.write("\n", 1));
+  }
+
+  if (rc && grepArgs.count && ! grepArgs.quiet) {
+    std::string str = std::to_string(numSelected) + "\n";
+
+    rc = output.write(str.c_str(), str.size());
+  }
+
+  if (rc)
+    rc = output.flush();
+
+  closeInput(fd, in);
+
+  if (! rc || reader.isError())
+    return 2;
+
+  return (numSelected > 0 ? 0 : 1);
+}
@@ -0,0 +1,94 @@
+#include <CCommandCallbackDest.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+CCommandCallbackDest::
+CCommandCallbackDest(CCommand *command, CallbackProc proc, CallbackData data,
+                     Mode mode, int dest_fd) :
+ CCommandStreamDest(command, dest_fd), proc_(proc), data_(data), mode_(mode)
+{
+}
+
+CCommandCallbackDest::
+~CCommandCallbackDest()
+{
+}
+
+void
+CCommandCallbackDest::
+readStream(int fd)
+{
+  std::vector<char> buffer(chunkSize_);
+
+  line_.clear();
+
+  for (;;) {
+    ssize_t len = ::read(fd, &buffer[0], buffer.size());
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0) {
+      setStreamError(std::string("read: ") + strerror(errno));
+      break;
+    }
+
+    if (len == 0)
+      break;
+
+    if (mode_ == Mode::LINE)
+      addLineData(&buffer[0], size_t(len));
+    else
+      proc_(&buffer[0], size_t(len), data_);
+  }
+
+  // pass trailing incomplete line
+  if (mode_ == Mode::LINE && ! line_.empty())
+    flushLine();
+}
+
+void
+CCommandCallbackDest::
+addLineData(const char *buffer, size_t len)
+{
+  const char *end = buffer + len;
+
+  while (buffer < end) {
+    auto *p = static_cast<const char *>(memchr(buffer, '\n', size_t(end - buffer)));
+
+    size_t len1 = size_t((p ? p : end) - buffer);
+
+    // complete line with nothing pending is passed without a copy
+    if (p && line_.empty() && len1 <= maxLineLen_) {
+      proc_(buffer, len1, data_);
+    }
+    else {
+      while (len1 > 0) {
+        size_t len2 = std::min(len1, maxLineLen_ - line_.size());
+
+        line_.insert(line_.end(), buffer, buffer + len2);
+
+        buffer += len2;
+        len1   -= len2;
+
+        if (line_.size() >= maxLineLen_)
+          flushLine();
+      }
+
+      if (p && ! line_.empty())
+        flushLine();
+    }
+
+    buffer = (p ? p + 1 : end);
+  }
+}
+
+void
+CCommandCallbackDest::
+flushLine()
+{
+  proc_(line_.data(), line_.size(), data_);
+
+  line_.clear();
+}
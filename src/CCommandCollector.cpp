@@ -0,0 +1,404 @@
+#include <CCommandCollector.h>
+#include <CCommand.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+CCommandCollectorDest::
+CCommandCollectorDest(CCommand *command, CCommandCollector *collector, int ind, int dest_fd) :
+ CCommandStreamDest(command, dest_fd), collector_(collector), ind_(ind)
+{
+}
+
+CCommandCollectorDest::
+~CCommandCollectorDest()
+{
+  // finish slot if command output never finished (e.g. failed to start)
+  if (collector_)
+    collector_->removeDest(this);
+}
+
+void
+CCommandCollectorDest::
+readStream(int fd)
+{
+  std::vector<char> buffer(65536);
+
+  std::string error;
+
+  bool ok = true;
+
+  for (;;) {
+    ssize_t len = ::read(fd, &buffer[0], buffer.size());
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0) {
+      setStreamError(std::string("read: ") + strerror(errno));
+      break;
+    }
+
+    if (len == 0)
+      break;
+
+    // keep draining after error so command is not blocked on full pipe
+    if (ok && collector_ && ! collector_->addData(ind_, &buffer[0], size_t(len), error)) {
+      setStreamError(error);
+
+      ok = false;
+    }
+  }
+
+  if (collector_ && ! collector_->finish(ind_, error))
+    setStreamError(error);
+}
+
+//---
+
+CCommandCollector::
+CCommandCollector(int fd, Order order) :
+ fd_(fd), order_(order)
+{
+  const char *tmpDir = getenv("TMPDIR");
+
+  spillDir_ = (tmpDir && *tmpDir ? tmpDir : "/tmp");
+}
+
+CCommandCollector::
+~CCommandCollector()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  for (auto &slot : slots_) {
+    if (slot.dest)
+      slot.dest->collector_ = nullptr;
+
+    if (slot.spillFd >= 0)
+      ::close(slot.spillFd);
+  }
+
+  for (auto &output : outputs_) {
+    if (output.spillFd >= 0)
+      ::close(output.spillFd);
+  }
+}
+
+CCommandCollectorDest *
+CCommandCollector::
+addCommand(CCommand *command, int dest_fd)
+{
+  CCommandCollectorDest *dest;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  dest = new CCommandCollectorDest(command, this, int(slots_.size()), dest_fd);
+
+  Slot slot;
+
+  slot.dest = dest;
+
+  slots_.push_back(slot);
+  }
+
+  command->addDest(dest);
+
+  return dest;
+}
+
+size_t
+CCommandCollector::
+getMemoryUsed() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return memoryUsed_;
+}
+
+size_t
+CCommandCollector::
+getNumSpilled() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numSpilled_;
+}
+
+size_t
+CCommandCollector::
+getBytesSpilled() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return bytesSpilled_;
+}
+
+bool
+CCommandCollector::
+addData(int ind, const char *data, size_t len, std::string &error)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto &slot = slots_[size_t(ind)];
+
+  // oldest command outputs directly (after anything it buffered before)
+  if (order_ != Order::SUBMISSION || size_t(ind) != next_) {
+    if (slot.spillFd < 0 && memoryUsed_ + len > memoryLimit_) {
+      if (! spill(slot, error))
+        return false;
+    }
+
+    if (slot.spillFd >= 0)
+      return writeSpill(slot, data, len, error);
+
+    slot.buffer.append(data, len);
+
+    memoryUsed_ += len;
+
+    return true;
+  }
+
+  emitSlot(slot);
+
+  Output output;
+
+  output.buffer.assign(data, len);
+
+  outputs_.push_back(std::move(output));
+
+  memoryUsed_ += len;
+  }
+
+  // written by this thread (so it is blocked while output is slow)
+  return flushOutput(error);
+}
+
+bool
+CCommandCollector::
+finish(int ind, std::string &error)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto &slot = slots_[size_t(ind)];
+
+  if (slot.done)
+    return true;
+
+  slot.done = true;
+
+  if (order_ == Order::COMPLETION)
+    emitSlot(slot);
+  else
+    emitReady();
+  }
+
+  return flushOutput(error);
+}
+
+void
+CCommandCollector::
+removeDest(CCommandCollectorDest *dest)
+{
+  std::string error;
+
+  finish(dest->ind_, error);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  slots_[size_t(dest->ind_)].dest = nullptr;
+}
+
+void
+CCommandCollector::
+emitReady()
+{
+  // emit finished commands in order and anything buffered by the next one
+  while (next_ < slots_.size()) {
+    auto &slot = slots_[next_];
+
+    emitSlot(slot);
+
+    if (! slot.done)
+      break;
+
+    ++next_;
+  }
+}
+
+void
+CCommandCollector::
+emitSlot(Slot &slot)
+{
+  // queue buffered data and spilled data (written by flushOutput outside lock)
+  if (! slot.buffer.empty()) {
+    Output output;
+
+    output.buffer.swap(slot.buffer);
+
+    outputs_.push_back(std::move(output));
+  }
+
+  if (slot.spillFd >= 0) {
+    Output output;
+
+    output.spillFd = slot.spillFd;
+
+    slot.spillFd = -1;
+
+    outputs_.push_back(std::move(output));
+  }
+}
+
+bool
+CCommandCollector::
+spill(Slot &slot, std::string &error)
+{
+  std::string filename = spillDir_ + "/CCommandCollectorXXXXXX";
+
+  std::vector<char> tmpl(filename.begin(), filename.end());
+
+  tmpl.push_back('\0');
+
+  int fd = ::mkstemp(&tmpl[0]);
+
+  if (fd < 0) {
+    error = std::string("mkstemp: ") + strerror(errno);
+    return false;
+  }
+
+  // file is removed when closed
+  ::unlink(&tmpl[0]);
+
+  slot.spillFd = fd;
+
+  ++numSpilled_;
+
+  std::string buffer;
+
+  buffer.swap(slot.buffer);
+
+  memoryUsed_ -= buffer.size();
+
+  return writeSpill(slot, buffer.data(), buffer.size(), error);
+}
+
+bool
+CCommandCollector::
+writeSpill(Slot &slot, const char *data, size_t len, std::string &error)
+{
+  bytesSpilled_ += len;
+
+  while (len > 0) {
+    ssize_t len1 = ::write(slot.spillFd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      error = std::string("write: ") + strerror(errno);
+      return false;
+    }
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+bool
+CCommandCollector::
+flushOutput(std::string &error)
+{
+  // one writer at a time takes queued outputs in order, so the slow write to
+  // the fd is not done under the collector lock (other commands can buffer)
+  std::unique_lock<std::mutex> outputLock(outputMutex_);
+
+  bool ok = true;
+
+  for (;;) {
+    Output output;
+
+    {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (outputs_.empty())
+      break;
+
+    output = std::move(outputs_.front());
+
+    outputs_.pop_front();
+    }
+
+    if (output.spillFd >= 0) {
+      if (ok && ! writeSpillOutput(output.spillFd, error))
+        ok = false;
+
+      ::close(output.spillFd);
+    }
+    else {
+      if (ok && ! writeOutput(output.buffer.data(), output.buffer.size(), error))
+        ok = false;
+
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      memoryUsed_ -= output.buffer.size();
+    }
+  }
+
+  return ok;
+}
+
+bool
+CCommandCollector::
+writeSpillOutput(int spillFd, std::string &error)
+{
+  if (::lseek(spillFd, 0, SEEK_SET) < 0) {
+    error = std::string("lseek: ") + strerror(errno);
+    return false;
+  }
+
+  std::vector<char> buffer(65536);
+
+  for (;;) {
+    ssize_t len = ::read(spillFd, &buffer[0], buffer.size());
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0) {
+      error = std::string("read: ") + strerror(errno);
+      return false;
+    }
+
+    if (len == 0)
+      break;
+
+    if (! writeOutput(&buffer[0], size_t(len), error))
+      return false;
+  }
+
+  return true;
+}
+
+bool
+CCommandCollector::
+writeOutput(const char *data, size_t len, std::string &error)
+{
+  while (len > 0) {
+    ssize_t len1 = ::write(fd_, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      error = std::string("write: ") + strerror(errno);
+      return false;
+    }
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
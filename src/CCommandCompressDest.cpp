@@ -0,0 +1,266 @@
+#include <CCommandCompressDest.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef CCOMMAND_ZSTD
+#include <zstd.h>
+#endif
+
+CCommandCompressDest::
+CCommandCompressDest(CCommand *command, const std::string &file, Format format, int dest_fd) :
+ CCommandStreamDest(command, dest_fd), file_(file), format_(format)
+{
+}
+
+CCommandCompressDest::
+~CCommandCompressDest()
+{
+  if (file_fd_ != -1)
+    ::close(file_fd_);
+}
+
+bool
+CCommandCompressDest::
+isFormatSupported(Format format)
+{
+#ifdef CCOMMAND_ZSTD
+  return (format == Format::GZIP || format == Format::ZSTD);
+#else
+  return (format == Format::GZIP);
+#endif
+}
+
+void
+CCommandCompressDest::
+initStream()
+{
+  if (! isFormatSupported(format_))
+    throwError(file_ + ": compression format not supported");
+
+  // gzip members and zstd frames can be concatenated so append is valid
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append_ ? O_APPEND : O_TRUNC);
+
+  file_fd_ = ::open(file_.c_str(), flags, 0666);
+
+  if (file_fd_ < 0)
+    throwError(std::string("open: ") + file_ + " " + strerror(errno));
+
+  inputSize_  = 0;
+  outputSize_ = 0;
+}
+
+void
+CCommandCompressDest::
+readStream(int fd)
+{
+  if (file_fd_ >= 0 && isFormatSupported(format_)) {
+    if (format_ == Format::ZSTD)
+      readZstd(fd);
+    else
+      readGzip(fd);
+  }
+
+  // no file or compress/write error so rest of output is not used, drain
+  // it so command isn't blocked writing to the pipe
+  drainStream(fd);
+}
+
+void
+CCommandCompressDest::
+drainStream(int fd)
+{
+  char buffer[4096];
+
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, sizeof(buffer));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len <= 0)
+      break;
+  }
+}
+
+bool
+CCommandCompressDest::
+readBlock(int fd, Buffer &buffer, size_t &len)
+{
+  // fill block (or up to EOF) so compressor is called with large inputs
+  len = 0;
+
+  while (len < buffer.size()) {
+    ssize_t len1 = ::read(fd, &buffer[len], buffer.size() - len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      setStreamError(std::string("read: ") + strerror(errno));
+      return false;
+    }
+
+    if (len1 == 0)
+      return false;
+
+    len += size_t(len1);
+  }
+
+  return true;
+}
+
+void
+CCommandCompressDest::
+readGzip(int fd)
+{
+  z_stream zstr;
+
+  memset(&zstr, 0, sizeof(zstr));
+
+  int level = (level_ >= 0 ? std::min(level_, 9) : Z_DEFAULT_COMPRESSION);
+
+  // window bits + 16 for gzip header
+  if (deflateInit2(&zstr, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    setStreamError(file_ + ": deflateInit2 failed");
+    return;
+  }
+
+  Buffer ibuffer(blockSize_);
+  Buffer obuffer(deflateBound(&zstr, uLong(blockSize_)));
+
+  bool more = true;
+
+  while (more) {
+    size_t len;
+
+    more = readBlock(fd, ibuffer, len);
+
+    inputSize_ += len;
+
+    zstr.next_in  = reinterpret_cast<Bytef *>(&ibuffer[0]);
+    zstr.avail_in = uInt(len);
+
+    int flush = (more ? Z_NO_FLUSH : Z_FINISH);
+
+    int rc;
+
+    do {
+      zstr.next_out  = reinterpret_cast<Bytef *>(&obuffer[0]);
+      zstr.avail_out = uInt(obuffer.size());
+
+      rc = deflate(&zstr, flush);
+
+      if (rc == Z_STREAM_ERROR) {
+        setStreamError(file_ + ": deflate failed");
+        more = false;
+        break;
+      }
+
+      if (! writeData(&obuffer[0], obuffer.size() - zstr.avail_out)) {
+        more = false;
+        break;
+      }
+    } while (zstr.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+  }
+
+  deflateEnd(&zstr);
+}
+
+void
+CCommandCompressDest::
+readZstd(int fd)
+{
+#ifdef CCOMMAND_ZSTD
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+
+  if (! cctx) {
+    setStreamError(file_ + ": ZSTD_createCCtx failed");
+    return;
+  }
+
+  int level = (level_ >= 0 ? level_ : ZSTD_CLEVEL_DEFAULT);
+
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+
+  Buffer ibuffer(blockSize_);
+  Buffer obuffer(ZSTD_CStreamOutSize());
+
+  bool more = true;
+
+  while (more) {
+    size_t len;
+
+    more = readBlock(fd, ibuffer, len);
+
+    inputSize_ += len;
+
+    ZSTD_EndDirective mode = (more ? ZSTD_e_continue : ZSTD_e_end);
+
+    ZSTD_inBuffer input = { &ibuffer[0], len, 0 };
+
+    bool done = false;
+
+    while (! done) {
+      ZSTD_outBuffer output = { &obuffer[0], obuffer.size(), 0 };
+
+      size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+
+      if (ZSTD_isError(remaining)) {
+        setStreamError(file_ + ": " + ZSTD_getErrorName(remaining));
+        more = false;
+        break;
+      }
+
+      if (! writeData(&obuffer[0], output.pos)) {
+        more = false;
+        break;
+      }
+
+      done = (more ? input.pos == input.size : remaining == 0);
+    }
+  }
+
+  ZSTD_freeCCtx(cctx);
+#else
+  (void) fd;
+#endif
+}
+
+bool
+CCommandCompressDest::
+writeData(const char *data, size_t len)
+{
+  outputSize_ += len;
+
+  while (len > 0) {
+    ssize_t len1 = ::write(file_fd_, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 <= 0) {
+      setStreamError(std::string("write: ") + file_ + " " + strerror(errno));
+      return false;
+    }
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+void
+CCommandCompressDest::
+termStream()
+{
+  if (file_fd_ != -1) {
+    int error = ::close(file_fd_);
+
+    if (error < 0)
+      throwError(std::string("close: ") + file_ + " " + strerror(errno));
+
+    file_fd_ = -1;
+  }
+}
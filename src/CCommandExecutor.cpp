@@ -0,0 +1,225 @@
+#include <CCommandExecutor.h>
+#include <CCommand.h>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+struct CCommandExecutor::Watch {
+  CCommandExecutor::Proc  proc    { nullptr };
+  void                   *data    { nullptr };
+  int                     fd      { -1 };
+  bool                    pidfd   { false };
+  CCommand               *command { nullptr };
+};
+
+CCommandExecutor::
+CCommandExecutor()
+{
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+}
+
+CCommandExecutor::
+~CCommandExecutor()
+{
+  for (auto *watch : polls_)
+    delete watch;
+
+  if (epfd_ >= 0)
+    ::close(epfd_);
+}
+
+void
+CCommandExecutor::
+post(Proc proc, void *data)
+{
+  Posted posted;
+
+  posted.proc = proc;
+  posted.data = data;
+
+  posted_.push_back(posted);
+}
+
+void
+CCommandExecutor::
+watchRead(int fd, Proc proc, void *data)
+{
+  auto *watch = new Watch;
+
+  watch->proc = proc;
+  watch->data = data;
+  watch->fd   = fd;
+
+  struct epoll_event event;
+
+  event.events   = EPOLLIN;
+  event.data.ptr = watch;
+
+  if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+    // not pollable (e.g. regular file) so always readable
+    delete watch;
+
+    post(proc, data);
+
+    return;
+  }
+
+  ++numWatches_;
+}
+
+void
+CCommandExecutor::
+watchExit(CCommand *command, Proc proc, void *data)
+{
+  if (command->tryWait()) {
+    post(proc, data);
+    return;
+  }
+
+  auto *watch = new Watch;
+
+  watch->proc    = proc;
+  watch->data    = data;
+  watch->command = command;
+
+  // pidfd is readable when process exits (even if reaped by SIGCHLD handler)
+  if (! command->isThread() && command->getPid() > 0)
+    watch->fd = int(syscall(SYS_pidfd_open, command->getPid(), 0));
+
+  if (watch->fd >= 0) {
+    struct epoll_event event;
+
+    event.events   = EPOLLIN;
+    event.data.ptr = watch;
+
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, watch->fd, &event) == 0) {
+      watch->pidfd = true;
+
+      ++numWatches_;
+
+      return;
+    }
+
+    ::close(watch->fd);
+
+    watch->fd = -1;
+  }
+
+  addPoll(watch);
+}
+
+void
+CCommandExecutor::
+addPoll(Watch *watch)
+{
+  polls_.push_back(watch);
+}
+
+void
+CCommandExecutor::
+run()
+{
+  while (runOnce())
+    ;
+}
+
+bool
+CCommandExecutor::
+runOnce(int timeout)
+{
+  // run posted procs (may post more which are run next time)
+  if (! posted_.empty()) {
+    PostedList posted;
+
+    std::swap(posted, posted_);
+
+    for (const auto &p : posted)
+      p.proc(p.data);
+
+    timeout = 0;
+  }
+
+  if (isIdle())
+    return false;
+
+  if (! posted_.empty())
+    timeout = 0;
+
+  if (! polls_.empty() && (timeout < 0 || timeout > 10))
+    timeout = 10;
+
+  if (numWatches_ > 0) {
+    struct epoll_event events[64];
+
+    int n = epoll_wait(epfd_, events, 64, timeout);
+
+    for (int i = 0; i < n; ++i) {
+      auto *watch = static_cast<Watch *>(events[i].data.ptr);
+
+      epoll_ctl(epfd_, EPOLL_CTL_DEL, watch->fd, nullptr);
+
+      --numWatches_;
+
+      if (watch->pidfd) {
+        ::close(watch->fd);
+
+        watch->fd    = -1;
+        watch->pidfd = false;
+
+        // exited so waitpid will not block
+        if (! watch->command->tryWait()) {
+          addPoll(watch);
+          continue;
+        }
+      }
+
+      auto proc = watch->proc;
+      auto data = watch->data;
+
+      delete watch;
+
+      proc(data);
+    }
+  }
+  else if (timeout > 0)
+    usleep(useconds_t(timeout*1000));
+
+  checkPolls();
+
+  return ! isIdle();
+}
+
+void
+CCommandExecutor::
+checkPolls()
+{
+  Watches polls;
+
+  std::swap(polls, polls_);
+
+  for (auto *watch : polls) {
+    if (! watch->command->tryWait()) {
+      polls_.push_back(watch);
+      continue;
+    }
+
+    auto proc = watch->proc;
+    auto data = watch->data;
+
+    delete watch;
+
+    proc(data);
+  }
+}
+
+bool
+CCommandExecutor::
+isIdle() const
+{
+  return (posted_.empty() && polls_.empty() && numWatches_ == 0);
+}
@@ -1,12 +1,41 @@
 #include <CCommandFileDest.h>
+#include <CCommandStdio.h>
 #include <CCommand.h>
-#include <CFile.h>
+#include <CCommandUtil.h>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+namespace {
+
+// size of range flushed (and dropped from page cache) by write behind
+const off_t WRITE_BEHIND_SIZE = 8*1024*1024;
+
+std::string dirName(const std::string &file) {
+  auto pos = file.rfind('/');
+
+  if (pos == std::string::npos)
+    return ".";
+
+  if (pos == 0)
+    return "/";
+
+  return file.substr(0, pos);
+}
+
+// temporary name next to file, unique for commands (threads) of this process
+std::string tmpFileName(const std::string &file) {
+  static std::atomic<uint> tmpCount;
+
+  return file + ".tmp." + std::to_string(getpid()) + "." + std::to_string(tmpCount++);
+}
+
+}
+
 CCommandFileDest::
 CCommandFileDest(CCommand *command, const std::string &file, int dest_fd) :
  CCommandDest(command), dest_fd_(dest_fd)
@@ -23,9 +52,9 @@ CCommandFileDest(CCommand *command, FILE *fp, int dest_fd) :
 CCommandFileDest::
 ~CCommandFileDest()
 {
-  delete file_;
-
   term();
+
+  delete file_;
 }
 
 void
@@ -33,25 +62,75 @@ CCommandFileDest::
 initParent()
 {
   if (file_) {
-    if (append_) {
-      if (! overwrite_ && ! CFile::exists(*file_))
-        throwError(*file_ + ": No such file or directory.");
+    if (sinkMode_ && ! append_) {
+      initSink();
+      return;
+    }
 
-      if (! CFile::exists(*file_))
-        fd_ = creat(file_->c_str(), 0666);
+    int flags = O_WRONLY | O_CLOEXEC;
+
+    if (append_)
+      flags |= O_APPEND | (overwrite_ ? O_CREAT : 0);
+    else
+      flags |= O_CREAT | O_TRUNC | (overwrite_ ? 0 : O_EXCL);
+
+    fd_ = open(file_->c_str(), flags, 0666);
+
+    if (fd_ < 0) {
+      if      (errno == ENOENT && append_ && ! overwrite_)
+        throwError(*file_ + ": No such file or directory.");
+      else if (errno == EEXIST)
+        throwError(*file_ + ": File exists.");
       else
-        fd_ = open(file_->c_str(), O_WRONLY | O_APPEND);
+        throwError(std::string("open: ") + *file_ + " " + strerror(errno));
     }
-    else {
-      if (! overwrite_ && CFile::exists(*file_))
-        throwError(*file_ + ": File exists.");
 
-      fd_ = creat(file_->c_str(), 0666);
+    // appended file can still have written pages flushed and dropped
+    if (fd_ >= 0 && sinkMode_) {
+      struct stat st;
+
+      if (fstat(fd_, &st) == 0)
+        flushPos_ = dropPos_ = st.st_size;
     }
+  }
+}
+
+void
+CCommandFileDest::
+initSink()
+{
+  // create unnamed file in destination directory (linked in on success)
+  tmpFile_ = "";
+
+  fd_ = -1;
+
+#ifdef O_TMPFILE
+  fd_ = openat(AT_FDCWD, dirName(*file_).c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+#endif
+
+  // file system doesn't support O_TMPFILE so use named temporary file
+  if (fd_ < 0) {
+    tmpFile_ = tmpFileName(*file_);
+
+    fd_ = openat(AT_FDCWD, tmpFile_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
 
-    if (fd_ < 0)
-      throwError(std::string("creat: ") + *file_ + " " + strerror(errno));
+    if (fd_ < 0) {
+      throwError(std::string("open: ") + tmpFile_ + " " + strerror(errno));
+
+      tmpFile_ = "";
+
+      return;
+    }
   }
+
+#ifdef __linux__
+  // reserve space without changing file size (advisory, ignore errors)
+  if (sizeHint_ > 0)
+    fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, sizeHint_);
+#endif
+
+  flushPos_ = 0;
+  dropPos_  = 0;
 }
 
 void
@@ -87,6 +166,12 @@ initChild()
     if (error < 0)
       throwError(std::string("dup2: ") + strerror(errno));
 
+    // sink keeps file open to flush, finish and link it after the callback
+    if (sinkMode_) {
+      startWriteBehind();
+      return;
+    }
+
     error = close(fd_);
 
     if (error < 0)
@@ -96,10 +181,40 @@ initChild()
   }
 }
 
+void
+CCommandFileDest::
+process()
+{
+  // parent keeps its copy of the file open while the command writes to it
+  if (sinkMode_)
+    startWriteBehind();
+}
+
+void
+CCommandFileDest::
+initThread(CCommandStdio &stdio)
+{
+  if (fd_ != -1 && ! stdio.setFd(dest_fd_, fd_))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
 void
 CCommandFileDest::
 term()
 {
+  if (sinkMode_ && file_ && fd_ != -1 && ! command_->isChild()) {
+    // restore redirected output (non-fork) before file is finished
+    if (save_fd_ != -1) {
+      dup2(save_fd_, dest_fd_);
+
+      close(save_fd_);
+
+      save_fd_ = -1;
+    }
+
+    termSink();
+  }
+
   if (fd_ != -1) {
     int error = close(fd_);
 
@@ -117,3 +232,183 @@ term()
     save_fd_ = -1;
   }
 }
+
+void
+CCommandFileDest::
+termSink()
+{
+  stopWriteBehind();
+
+  writeBehind(/*final*/ true);
+
+  // appended file is written in place
+  if (append_)
+    return;
+
+  // release preallocated space beyond what was written
+  if (sizeHint_ > 0) {
+    struct stat st;
+
+    if (fstat(fd_, &st) == 0 && st.st_size < sizeHint_)
+      (void) ftruncate(fd_, st.st_size);
+  }
+
+  bool success = (command_->isState(CCommand::State::EXITED) && command_->getReturnCode() == 0);
+
+  if (! success) {
+    // discard output (unnamed file is freed on close)
+    if (tmpFile_ != "")
+      unlink(tmpFile_.c_str());
+
+    tmpFile_ = "";
+
+    return;
+  }
+
+  int error = 0;
+
+  if (tmpFile_ == "") {
+    // link unnamed file into place, if file exists link to temporary name and
+    // rename over it (overwrite) so readers never see a partial file
+    std::string procFile = "/proc/self/fd/" + std::to_string(fd_);
+
+    error = linkat(AT_FDCWD, procFile.c_str(), AT_FDCWD, file_->c_str(), AT_SYMLINK_FOLLOW);
+
+    if (error < 0 && errno == EEXIST && overwrite_) {
+      std::string tmpFile = tmpFileName(*file_);
+
+      error = linkat(AT_FDCWD, procFile.c_str(), AT_FDCWD, tmpFile.c_str(), AT_SYMLINK_FOLLOW);
+
+      if (error == 0) {
+        error = rename(tmpFile.c_str(), file_->c_str());
+
+        if (error < 0)
+          unlink(tmpFile.c_str());
+      }
+    }
+  }
+  else {
+    // rename replaces existing file, link fails if it exists
+    if (overwrite_)
+      error = rename(tmpFile_.c_str(), file_->c_str());
+    else {
+      error = link(tmpFile_.c_str(), file_->c_str());
+
+      int errno1 = errno;
+
+      unlink(tmpFile_.c_str());
+
+      errno = errno1;
+    }
+
+    if (error < 0)
+      unlink(tmpFile_.c_str());
+
+    tmpFile_ = "";
+  }
+
+  if (error < 0) {
+    if (errno == EEXIST)
+      throwError(*file_ + ": File exists.");
+    else
+      throwError(std::string("link: ") + *file_ + " " + strerror(errno));
+  }
+}
+
+void
+CCommandFileDest::
+startWriteBehind()
+{
+  if (! dropCache_ || fd_ == -1 || thread_.joinable())
+    return;
+
+  stopThread_ = false;
+
+  // SIGCHLD handler joins this thread so it must never run on it
+  thread_ = CCommandUtil::createThread(writeBehindThread, this);
+}
+
+void
+CCommandFileDest::
+stopWriteBehind()
+{
+  if (! thread_.joinable())
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    stopThread_ = true;
+  }
+
+  cond_.notify_all();
+
+  thread_.join();
+}
+
+void
+CCommandFileDest::
+writeBehind(bool final)
+{
+  if (! dropCache_)
+    return;
+
+  struct stat st;
+
+  if (fstat(fd_, &st) < 0)
+    return;
+
+  off_t pos = st.st_size;
+
+#ifdef __linux__
+  // start write out of each full range written, then wait for the previous
+  // range to complete and drop it from the page cache
+  while (pos - flushPos_ >= WRITE_BEHIND_SIZE) {
+    sync_file_range(fd_, flushPos_, WRITE_BEHIND_SIZE, SYNC_FILE_RANGE_WRITE);
+
+    if (flushPos_ > dropPos_) {
+      sync_file_range(fd_, dropPos_, flushPos_ - dropPos_,
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                      SYNC_FILE_RANGE_WAIT_AFTER);
+
+      posix_fadvise(fd_, dropPos_, flushPos_ - dropPos_, POSIX_FADV_DONTNEED);
+
+      dropPos_ = flushPos_;
+    }
+
+    flushPos_ += WRITE_BEHIND_SIZE;
+  }
+
+  if (final && pos > dropPos_) {
+    sync_file_range(fd_, dropPos_, pos - dropPos_,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                    SYNC_FILE_RANGE_WAIT_AFTER);
+
+    posix_fadvise(fd_, dropPos_, pos - dropPos_, POSIX_FADV_DONTNEED);
+
+    flushPos_ = dropPos_ = pos;
+  }
+#else
+  if (final && pos > dropPos_) {
+    fdatasync(fd_);
+
+    posix_fadvise(fd_, dropPos_, pos - dropPos_, POSIX_FADV_DONTNEED);
+
+    flushPos_ = dropPos_ = pos;
+  }
+#endif
+}
+
+void
+CCommandFileDest::
+writeBehindThread(CCommandFileDest *dest)
+{
+  std::unique_lock<std::mutex> lock(dest->mutex_);
+
+  while (! dest->stopThread_) {
+    dest->cond_.wait_for(lock, std::chrono::milliseconds(50));
+
+    if (! dest->stopThread_)
+      dest->writeBehind(/*final*/ false);
+  }
+}
@@ -1,5 +1,7 @@
 #include <CCommandFileSrc.h>
+#include <CCommandStdio.h>
 #include <CCommand.h>
+#include <CCommandHash.h>
 #include <cstdio>
 #include <cerrno>
 #include <cstring>
@@ -72,6 +74,14 @@ initChild()
   }
 }
 
+void
+CCommandFileSrc::
+initThread(CCommandStdio &stdio)
+{
+  if (fd_ != -1 && ! stdio.setFd(0, fd_))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
 void
 CCommandFileSrc::
 term()
@@ -93,3 +103,16 @@ term()
     save_stdin_ = -1;
   }
 }
+
+bool
+CCommandFileSrc::
+hashData(CCommandHash &hash) const
+{
+  // contents of FILE * unknown
+  if (! file_)
+    return false;
+
+  hash.addString("file");
+
+  return hash.addFile(*file_);
+}
@@ -0,0 +1,43 @@
+#include <CCommandGeneratorSrc.h>
+#include <algorithm>
+#include <vector>
+
+CCommandGeneratorSrc::
+CCommandGeneratorSrc(CCommand *command, CallbackProc proc, CallbackData data) :
+ CCommandStreamSrc(command), proc_(proc), data_(data)
+{
+}
+
+CCommandGeneratorSrc::
+~CCommandGeneratorSrc()
+{
+}
+
+void
+CCommandGeneratorSrc::
+initStream()
+{
+  numWritten_ = 0;
+}
+
+void
+CCommandGeneratorSrc::
+writeStream(int fd)
+{
+  std::vector<char> buffer(chunkSize_);
+
+  for (;;) {
+    size_t len = proc_(&buffer[0], buffer.size(), data_);
+
+    if (len == 0)
+      break;
+
+    len = std::min(len, buffer.size());
+
+    // blocking write only returns once the reader has taken the data
+    if (! writeData(fd, &buffer[0], len))
+      break;
+
+    numWritten_ += len;
+  }
+}
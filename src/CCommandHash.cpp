@@ -0,0 +1,307 @@
+#include <CCommandHash.h>
+#include <CCommand.h>
+#include <CCommandSrc.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t c1 = 0x87c37b91114253d5ULL;
+const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+
+  return k;
+}
+
+// search PATH for executable (like execvp)
+bool findExecutable(const std::string &name, std::string &path) {
+  if (name.find('/') != std::string::npos) {
+    path = name;
+    return true;
+  }
+
+  const char *pathEnv = getenv("PATH");
+
+  std::string dirs = (pathEnv ? pathEnv : "/bin:/usr/bin");
+
+  size_t pos = 0;
+
+  for (;;) {
+    auto pos1 = dirs.find(':', pos);
+
+    std::string dir = dirs.substr(pos, pos1 == std::string::npos ? pos1 : pos1 - pos);
+
+    std::string path1 = (dir != "" ? dir : ".") + "/" + name;
+
+    if (::access(path1.c_str(), X_OK) == 0) {
+      path = path1;
+      return true;
+    }
+
+    if (pos1 == std::string::npos)
+      break;
+
+    pos = pos1 + 1;
+  }
+
+  return false;
+}
+
+}
+
+//---
+
+std::string
+CCommandHash::Key::
+toString() const
+{
+  static const char *digits = "0123456789abcdef";
+
+  std::string str(32, '0');
+
+  for (int i = 0; i < 16; ++i) {
+    str[size_t(15 - i)] = digits[(h1 >> (4*i)) & 0xf];
+    str[size_t(31 - i)] = digits[(h2 >> (4*i)) & 0xf];
+  }
+
+  return str;
+}
+
+//---
+
+CCommandHash::
+CCommandHash()
+{
+}
+
+void
+CCommandHash::
+addData(const void *data, size_t len)
+{
+  auto *p   = static_cast<const unsigned char *>(data);
+  auto *end = p + len;
+
+  len_ += len;
+
+  // complete partial block
+  if (bufferLen_ > 0) {
+    size_t len1 = std::min(size_t(end - p), 16 - bufferLen_);
+
+    memcpy(&buffer_[bufferLen_], p, len1);
+
+    bufferLen_ += len1;
+    p          += len1;
+
+    if (bufferLen_ < 16)
+      return;
+
+    addBlock(buffer_);
+
+    bufferLen_ = 0;
+  }
+
+  while (end - p >= 16) {
+    addBlock(p);
+
+    p += 16;
+  }
+
+  bufferLen_ = size_t(end - p);
+
+  memcpy(buffer_, p, bufferLen_);
+}
+
+void
+CCommandHash::
+addString(const std::string &str)
+{
+  addInt(str.size());
+
+  addData(str.data(), str.size());
+}
+
+void
+CCommandHash::
+addInt(uint64_t i)
+{
+  addData(&i, sizeof(i));
+}
+
+bool
+CCommandHash::
+addFile(const std::string &filename)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  char buffer[65536];
+
+  bool ok = true;
+
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, sizeof(buffer));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0) {
+      ok = false;
+      break;
+    }
+
+    if (len == 0)
+      break;
+
+    addData(buffer, size_t(len));
+  }
+
+  ::close(fd);
+
+  return ok;
+}
+
+bool
+CCommandHash::
+addCommand(CCommand *command, const std::vector<std::string> &envVars)
+{
+  if (command->getThreadProc() || command->getCallbackProc() || ! command->getDests().empty())
+    return false;
+
+  std::string path;
+
+  if (! findExecutable(command->getName(), path))
+    return false;
+
+  struct stat st;
+
+  if (::stat(path.c_str(), &st) < 0)
+    return false;
+
+  // executable
+  addString(path);
+  addInt(uint64_t(st.st_dev));
+  addInt(uint64_t(st.st_ino));
+  addInt(uint64_t(st.st_size));
+  addInt(uint64_t(st.st_mtim.tv_sec));
+  addInt(uint64_t(st.st_mtim.tv_nsec));
+
+  // args
+  addString(command->getName());
+
+  addInt(command->getArgs().size());
+
+  for (const auto &arg : command->getArgs())
+    addString(arg);
+
+  // current directory
+  char cwd[PATH_MAX];
+
+  if (! ::getcwd(cwd, sizeof(cwd)))
+    return false;
+
+  addString(cwd);
+
+  // environment
+  for (const auto &var : envVars) {
+    const char *value = getenv(var.c_str());
+
+    addString(var);
+
+    if (value) {
+      addInt(1);
+      addString(value);
+    }
+    else
+      addInt(0);
+  }
+
+  // stdin
+  addInt(command->getSrcs().size());
+
+  for (const auto &src : command->getSrcs())
+    if (! src->hashData(*this))
+      return false;
+
+  return true;
+}
+
+CCommandHash::Key
+CCommandHash::
+getKey() const
+{
+  uint64_t h1 = h1_;
+  uint64_t h2 = h2_;
+
+  // tail
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  for (size_t i = bufferLen_; i > 8; --i)
+    k2 = (k2 << 8) | buffer_[i - 1];
+
+  for (size_t i = std::min(bufferLen_, size_t(8)); i > 0; --i)
+    k1 = (k1 << 8) | buffer_[i - 1];
+
+  if (bufferLen_ > 8) {
+    k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+  }
+
+  if (bufferLen_ > 0) {
+    k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+
+  // finalize
+  h1 ^= len_;
+  h2 ^= len_;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  Key key;
+
+  key.h1 = h1;
+  key.h2 = h2;
+
+  return key;
+}
+
+void
+CCommandHash::
+addBlock(const unsigned char *block)
+{
+  uint64_t k1, k2;
+
+  memcpy(&k1, block    , 8);
+  memcpy(&k2, block + 8, 8);
+
+  k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1_ ^= k1;
+
+  h1_ = rotl(h1_, 27); h1_ += h2_; h1_ = h1_*5 + 0x52dce729;
+
+  k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2_ ^= k2;
+
+  h2_ = rotl(h2_, 31); h2_ += h1_; h2_ = h2_*5 + 0x38495ab5;
+}
@@ -0,0 +1,303 @@
+#include <CCommandHedger.h>
+#include <CCommandExecutor.h>
+#include <CCommandOutputDest.h>
+#include <COSSignal.h>
+#include <algorithm>
+#include <csignal>
+#include <vector>
+
+namespace {
+
+// runs a command and (after delay) its duplicate on one executor until the
+// first finishes, then kills and drains the other
+class CCommandHedgeRun {
+ public:
+  using Clock = CCommandResult::Clock;
+
+ public:
+  CCommandHedgeRun(const CCommand::Args &args) :
+   args_(args) {
+  }
+
+ ~CCommandHedgeRun() {
+    for (auto &attempt : attempts_)
+      delete attempt.command;
+  }
+
+  // returns index of attempt which finished first (1 if duplicate)
+  int run(int delay) {
+    startAttempt(0);
+
+    auto hedgeTime = attempts_[0].startTime + std::chrono::milliseconds(delay);
+
+    int winner = -1;
+
+    for (;;) {
+      for (int i = 0; i < 2; ++i) {
+        if (isDone(attempts_[i])) {
+          winner = i;
+          break;
+        }
+      }
+
+      if (winner >= 0)
+        break;
+
+      int timeout = -1;
+
+      if (delay >= 0 && ! attempts_[1].command) {
+        auto now = Clock::now();
+
+        if (now >= hedgeTime) {
+          startAttempt(1);
+          continue;
+        }
+
+        timeout = int(std::chrono::duration_cast<std::chrono::milliseconds>
+                        (hedgeTime - now).count()) + 1;
+      }
+
+      if (! executor_.runOnce(timeout) && timeout < 0)
+        break;
+    }
+
+    if (winner < 0)
+      winner = 0;
+
+    // kill other (and anything it started) and wait for it
+    auto &loser = attempts_[1 - winner];
+
+    if (loser.command && ! loser.exited) {
+      pid_t pgid = loser.command->getProcessGroupId();
+
+      if (pgid > 0)
+        (void) COSSignal::sendSignal(-pgid, SIGKILL);
+    }
+
+    executor_.run();
+
+    return winner;
+  }
+
+  bool isHedged() const { return (attempts_[1].command != nullptr); }
+
+  void getResult(int ind, CCommandResult &result) const {
+    const auto &attempt = attempts_[ind];
+
+    result.returnCode = attempt.command->getReturnCode();
+    result.signalNum  = attempt.command->getSignalNum();
+    result.output     = attempt.out.str;
+    result.error      = attempt.err.str;
+    result.usage      = attempt.command->getUsage();
+    result.startTime  = attempt.startTime;
+    result.endTime    = attempt.endTime;
+  }
+
+ private:
+  struct Attempt;
+
+  struct Stream {
+    Attempt            *attempt { nullptr };
+    CCommandOutputDest *dest    { nullptr };
+    std::string         str;
+    bool                eof     { false };
+  };
+
+  struct Attempt {
+    CCommandHedgeRun *runner  { nullptr };
+    CCommand         *command { nullptr };
+    Stream            out;
+    Stream            err;
+    Clock::time_point startTime;
+    Clock::time_point endTime;
+    bool              exited  { false };
+  };
+
+  void startAttempt(int ind) {
+    auto &attempt = attempts_[ind];
+
+    const auto &name = args_[0];
+
+    CCommand::Args args(args_.begin() + 1, args_.end());
+
+    attempt.runner  = this;
+    attempt.command = new CCommand(name, name, args);
+
+    // real process in own group so it (and its children) can be killed
+    attempt.command->setAllowBuiltin(false);
+    attempt.command->setProcessGroupLeader();
+
+    attempt.out.attempt = &attempt;
+    attempt.out.dest    = attempt.command->addOutputDest(1);
+    attempt.err.attempt = &attempt;
+    attempt.err.dest    = attempt.command->addOutputDest(2);
+
+    attempt.startTime = Clock::now();
+
+    attempt.command->start();
+
+    // failed to start
+    if (! attempt.command->isState(CCommand::State::RUNNING) &&
+        ! attempt.command->isState(CCommand::State::EXITED)) {
+      attempt.exited  = true;
+      attempt.endTime = Clock::now();
+      attempt.out.eof = true;
+      attempt.err.eof = true;
+      return;
+    }
+
+    readOutput(attempt.out);
+    readOutput(attempt.err);
+
+    executor_.watchExit(attempt.command, exitProc, &attempt);
+  }
+
+  void readOutput(Stream &stream) {
+    // no data yet
+    if (! stream.dest->readAvailable(stream.str)) {
+      executor_.watchRead(stream.dest->getFd(), readProc, &stream);
+      return;
+    }
+
+    stream.dest->close();
+
+    stream.eof = true;
+  }
+
+  static bool isDone(const Attempt &attempt) {
+    return (attempt.command && attempt.exited && attempt.out.eof && attempt.err.eof);
+  }
+
+  static void readProc(void *data) {
+    auto *stream = static_cast<Stream *>(data);
+
+    stream->attempt->runner->readOutput(*stream);
+  }
+
+  static void exitProc(void *data) {
+    auto *attempt = static_cast<Attempt *>(data);
+
+    attempt->exited  = true;
+    attempt->endTime = Clock::now();
+  }
+
+ private:
+  const CCommand::Args &args_;
+  CCommandExecutor      executor_;
+  Attempt               attempts_[2];
+};
+
+}
+
+//---
+
+CCommandHedger::
+CCommandHedger(double percentile, size_t historySize) :
+ percentile_(percentile), historySize_(historySize)
+{
+}
+
+bool
+CCommandHedger::
+run(const CCommand::Args &args, CCommandResult &result)
+{
+  assert(! args.empty());
+
+  int delay = getDelay(args[0]);
+
+  CCommandHedgeRun hedgeRun(args);
+
+  int winner = hedgeRun.run(delay);
+
+  hedgeRun.getResult(winner, result);
+
+  // only record latency of normal exit
+  if (result.signalNum < 0)
+    addLatency(args[0], result.elapsed());
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  ++numRuns_;
+
+  if (hedgeRun.isHedged())
+    ++numHedged_;
+
+  if (winner == 1)
+    ++numHedgeWins_;
+  }
+
+  return (winner == 1);
+}
+
+int
+CCommandHedger::
+getDelay(const std::string &name) const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto p = history_.find(name);
+
+  if (p == history_.end() || (*p).second.empty() || (*p).second.size() < minHistory_)
+    return -1;
+
+  std::vector<double> latencies((*p).second.begin(), (*p).second.end());
+
+  double percentile = std::min(std::max(percentile_, 0.0), 100.0);
+
+  auto n = size_t(percentile*double(latencies.size() - 1)/100.0);
+
+  std::nth_element(latencies.begin(), latencies.begin() + long(n), latencies.end());
+
+  return std::max(int(latencies[n]*1000.0), minDelay_);
+}
+
+void
+CCommandHedger::
+addLatency(const std::string &name, double latency)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto &latencies = history_[name];
+
+  latencies.push_back(latency);
+
+  while (latencies.size() > std::max(historySize_, size_t(1)))
+    latencies.pop_front();
+}
+
+void
+CCommandHedger::
+clearHistory()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  history_.clear();
+}
+
+size_t
+CCommandHedger::
+getNumRuns() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numRuns_;
+}
+
+size_t
+CCommandHedger::
+getNumHedged() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numHedged_;
+}
+
+size_t
+CCommandHedger::
+getNumHedgeWins() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numHedgeWins_;
+}
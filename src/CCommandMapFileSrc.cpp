@@ -0,0 +1,112 @@
+#include <CCommandMapFileSrc.h>
+#include <CCommand.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CCommandMapFileSrc::
+CCommandMapFileSrc(CCommand *command, const std::string &file) :
+ CCommandFileSrc(command, file)
+{
+}
+
+CCommandMapFileSrc::
+~CCommandMapFileSrc()
+{
+  unmapFile();
+}
+
+CCommandMapFileSrc *
+CCommandMapFileSrc::
+current()
+{
+  auto *command = CCommand::getCurrent();
+
+  auto *src = (command ? command->getMapFileSrc() : nullptr);
+
+  if (! src || ! src->isMapped())
+    return nullptr;
+
+  return src;
+}
+
+void
+CCommandMapFileSrc::
+initChild()
+{
+  // exec'd program can only read stdin
+  if (! command_->getCallbackProc() || ! mapFile()) {
+    CCommandFileSrc::initChild();
+    return;
+  }
+}
+
+void
+CCommandMapFileSrc::
+initThread(CCommandStdio &stdio)
+{
+  // builtin can only read stdin
+  if (! command_->getThreadProc() || ! mapFile()) {
+    CCommandFileSrc::initThread(stdio);
+    return;
+  }
+}
+
+void
+CCommandMapFileSrc::
+term()
+{
+  unmapFile();
+
+  CCommandFileSrc::term();
+}
+
+bool
+CCommandMapFileSrc::
+mapFile()
+{
+  if (fd_ < 0)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd_, &st) < 0 || ! S_ISREG(st.st_mode))
+    return false;
+
+  size_ = size_t(st.st_size);
+
+  // empty file can't be mapped
+  if (size_ == 0) {
+    data_   = nullptr;
+    mapped_ = true;
+    return true;
+  }
+
+  void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+  if (addr == MAP_FAILED) {
+    size_ = 0;
+    return false;
+  }
+
+  madvise(addr, size_, MADV_SEQUENTIAL);
+
+  data_   = static_cast<const char *>(addr);
+  mapped_ = true;
+
+  return true;
+}
+
+void
+CCommandMapFileSrc::
+unmapFile()
+{
+  if (data_)
+    munmap(const_cast<char *>(data_), size_);
+
+  data_   = nullptr;
+  size_   = 0;
+  mapped_ = false;
+}
@@ -0,0 +1,337 @@
+#include <CCommandMerge.h>
+#include <CCommandStdio.h>
+#include <CCommandPipe.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+CCommandMergeDest::
+CCommandMergeDest(CCommand *command, CCommandMerge *merge, int dest_fd) :
+ CCommandDest(command), merge_(merge), dest_fd_(dest_fd)
+{
+}
+
+CCommandMergeDest::
+~CCommandMergeDest()
+{
+  if (merge_)
+    merge_->removeInput(this);
+
+  delete pipe_;
+}
+
+void
+CCommandMergeDest::
+initParent()
+{
+  delete pipe_;
+
+  // pipe is kept by input command (writer) and merge command (reader)
+  pipe_ = new CCommandPipe(command_);
+
+  pipe_->setDest(command_);
+  pipe_->setSrc (merge_);
+}
+
+void
+CCommandMergeDest::
+initChild()
+{
+  if (command_->getDoFork()) {
+    // redirect command output to pipe output
+    int error = ::close(dest_fd_);
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+  else {
+    // in process input must fit in pipe as merge is run afterwards
+    save_fd_ = ::dup(dest_fd_);
+    if (save_fd_ < 0) throwError(std::string("dup: ") + strerror(errno));
+
+    int error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+  }
+}
+
+void
+CCommandMergeDest::
+initThread(CCommandStdio &stdio)
+{
+  if (! stdio.setFd(dest_fd_, pipe_->getOutput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
+void
+CCommandMergeDest::
+process()
+{
+  // close parent's copy of pipe output so merge sees EOF on exit
+  if (pipe_ && command_->getDoFork()) {
+    int error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
+void
+CCommandMergeDest::
+term()
+{
+  if (save_fd_ != -1) {
+    ::dup2(save_fd_, dest_fd_);
+
+    ::close(save_fd_);
+
+    save_fd_ = -1;
+  }
+
+  if (pipe_ && ! command_->isChild()) {
+    int error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
+//---
+
+struct CCommandMerge::Input {
+  int          fd     { -1 };
+  std::string  buffer;
+  size_t       pos    { 0 };
+  bool         eof    { false };
+  const char  *line   { nullptr };
+  size_t       len    { 0 };
+  const char  *key    { nullptr };
+  size_t       keyLen { 0 };
+  double       value  { 0.0 };
+};
+
+CCommandMerge::
+CCommandMerge(const std::string &name, bool doFork) :
+ CCommand(name, mergeProc, this, Args(), doFork)
+{
+}
+
+CCommandMerge::
+~CCommandMerge()
+{
+  for (auto *dest : dests_)
+    dest->merge_ = nullptr;
+}
+
+void
+CCommandMerge::
+addInput(CCommand *command, int fd)
+{
+  auto *dest = new CCommandMergeDest(command, this, fd);
+
+  command->addDest(dest);
+
+  dests_.push_back(dest);
+}
+
+void
+CCommandMerge::
+removeInput(CCommandMergeDest *dest)
+{
+  dests_.erase(std::remove(dests_.begin(), dests_.end(), dest), dests_.end());
+}
+
+void
+CCommandMerge::
+mergeProc(const Args &, CallbackData data)
+{
+  static_cast<CCommandMerge *>(data)->merge();
+}
+
+void
+CCommandMerge::
+merge()
+{
+  std::vector<Input> inputs(dests_.size());
+
+  for (size_t i = 0; i < dests_.size(); ++i) {
+    auto *pipe = dests_[i]->getPipe();
+
+    if (! pipe) {
+      throwError("Merge input not started");
+      continue;
+    }
+
+    inputs[i].fd = pipe->getInput();
+  }
+
+  // heap of inputs with a current line (smallest at front)
+  std::vector<Input *> heap;
+
+  auto heapCmp = [&](const Input *i1, const Input *i2) { return compare(*i1, *i2) > 0; };
+
+  for (auto &input : inputs) {
+    if (input.fd != -1 && nextLine(input))
+      heap.push_back(&input);
+  }
+
+  std::make_heap(heap.begin(), heap.end(), heapCmp);
+
+  std::string output;
+
+  auto flushOutput = [&]() {
+    const char *p   = output.c_str();
+    size_t      len = output.size();
+
+    while (len > 0) {
+      ssize_t len1 = ::write(1, p, len);
+
+      if (len1 < 0 && errno == EINTR) continue;
+
+      if (len1 <= 0) {
+        throwError(std::string("write: ") + strerror(errno));
+        break;
+      }
+
+      p   += len1;
+      len -= size_t(len1);
+    }
+
+    output.clear();
+  };
+
+  while (! heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), heapCmp);
+
+    auto *input = heap.back();
+
+    output.append(input->line, input->len);
+    output.push_back(delim_);
+
+    if (output.size() >= 65536)
+      flushOutput();
+
+    if (nextLine(*input))
+      std::push_heap(heap.begin(), heap.end(), heapCmp);
+    else
+      heap.pop_back();
+  }
+
+  flushOutput();
+}
+
+bool
+CCommandMerge::
+nextLine(Input &input)
+{
+  for (;;) {
+    auto p = input.buffer.find(delim_, input.pos);
+
+    if (p != std::string::npos) {
+      input.line = &input.buffer[input.pos];
+      input.len  = p - input.pos;
+      input.pos  = p + 1;
+
+      setKey(input);
+
+      return true;
+    }
+
+    // last line with no delimiter
+    if (input.eof) {
+      if (input.pos >= input.buffer.size())
+        return false;
+
+      input.line = &input.buffer[input.pos];
+      input.len  = input.buffer.size() - input.pos;
+      input.pos  = input.buffer.size();
+
+      setKey(input);
+
+      return true;
+    }
+
+    // discard consumed data and read more
+    input.buffer.erase(0, input.pos);
+
+    input.pos = 0;
+
+    char buffer[65536];
+
+    ssize_t len = ::read(input.fd, buffer, sizeof(buffer));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len <= 0)
+      input.eof = true;
+    else
+      input.buffer.append(buffer, size_t(len));
+  }
+}
+
+void
+CCommandMerge::
+setKey(Input &input)
+{
+  input.key    = input.line;
+  input.keyLen = input.len;
+
+  if (keyField_ > 0) {
+    const char *p   = input.line;
+    const char *end = input.line + input.len;
+
+    for (int i = 1; i < keyField_ && p < end; ++i) {
+      auto *p1 = static_cast<const char *>(memchr(p, keySep_, size_t(end - p)));
+
+      p = (p1 ? p1 + 1 : end);
+    }
+
+    auto *p1 = static_cast<const char *>(memchr(p, keySep_, size_t(end - p)));
+
+    input.key    = p;
+    input.keyLen = size_t((p1 ? p1 : end) - p);
+  }
+
+  if (numeric_) {
+    std::string str(input.key, input.keyLen);
+
+    input.value = strtod(str.c_str(), nullptr);
+  }
+}
+
+int
+CCommandMerge::
+compare(const Input &input1, const Input &input2) const
+{
+  int cmp;
+
+  if      (compareProc_)
+    cmp = compareProc_(input1.key, input1.keyLen, input2.key, input2.keyLen, compareData_);
+  else if (numeric_)
+    cmp = (input1.value < input2.value ? -1 : (input1.value > input2.value ? 1 : 0));
+  else {
+    cmp = memcmp(input1.key, input2.key, std::min(input1.keyLen, input2.keyLen));
+
+    if (cmp == 0)
+      cmp = (input1.keyLen < input2.keyLen ? -1 : (input1.keyLen > input2.keyLen ? 1 : 0));
+  }
+
+  return (reverse_ ? -cmp : cmp);
+}
+
+void
+CCommandMerge::
+died()
+{
+  // close read ends (parent and forked merge)
+  for (auto *dest : dests_) {
+    auto *pipe = dest->getPipe();
+
+    if (pipe)
+      pipe->closeInput();
+  }
+}
@@ -1,6 +1,188 @@
 #include <CCommandMgr.h>
+#include <CCommandRangeFileSrc.h>
+#include <CCommandCallbackDest.h>
+#include <CCommandBuiltins.h>
+#include <CCommandThreadPool.h>
+#include <CCommandReaper.h>
+#include <CCommandParser.h>
+#include <CCommandPipeline.h>
+#include <CCommandExecutor.h>
+#include <CCommandOutputDest.h>
 #include <CStrUtil.h>
+#include <CCommandUtil.h>
 #include <CThrow.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <thread>
+
+namespace {
+
+void appendOutput(const char *buffer, size_t len, CCommand::CallbackData data) {
+  static_cast<std::string *>(data)->append(buffer, len);
+}
+
+std::string substituteArg(const std::string &arg, const std::string &input) {
+  std::string arg1;
+
+  size_t pos = 0;
+
+  for (;;) {
+    auto pos1 = arg.find("{}", pos);
+
+    if (pos1 == std::string::npos)
+      break;
+
+    arg1.append(arg, pos, pos1 - pos);
+    arg1.append(input);
+
+    pos = pos1 + 2;
+  }
+
+  if (pos == 0)
+    return arg;
+
+  arg1.append(arg, pos, std::string::npos);
+
+  return arg1;
+}
+
+// space used by string (and its pointer) in exec args or environment
+size_t execArgSize(const char *str) {
+  return strlen(str) + 1 + sizeof(char *);
+}
+
+// runs list of commands (name and args) for mapParallel and execBatched on
+// executor (no thread per command)
+class CCommandMapRunner {
+ public:
+  using ArgsList = std::vector<CCommand::Args>;
+
+ public:
+  CCommandMapRunner(const ArgsList &argsList, int numJobs, std::vector<CCommandResult> &results) :
+   argsList_(argsList), numJobs_(numJobs), results_(results) {
+  }
+
+  void run() {
+    startJobs();
+
+    executor_.run();
+  }
+
+ private:
+  struct Job {
+    CCommandMapRunner  *runner  { nullptr };
+    size_t              ind     { 0 };
+    CCommand           *command { nullptr };
+    CCommandOutputDest *dest    { nullptr };
+    bool                exited  { false };
+    bool                eof     { false };
+  };
+
+  void startJobs() {
+    while (numRunning_ < numJobs_ && next_ < argsList_.size()) {
+      auto ind = next_++;
+
+      const auto &args1 = argsList_[ind];
+
+      const auto &name = args1[0];
+
+      CCommand::Args args(args1.begin() + 1, args1.end());
+
+      auto *job = new Job;
+
+      job->runner  = this;
+      job->ind     = ind;
+      job->command = new CCommand(name, name, args);
+      job->dest    = job->command->addOutputDest();
+
+      results_[ind].startTime = CCommandResult::Clock::now();
+
+      job->command->start();
+
+      ++numRunning_;
+
+      // failed to start
+      if (! job->command->isState(CCommand::State::RUNNING) &&
+          ! job->command->isState(CCommand::State::EXITED)) {
+        job->exited = true;
+        job->eof    = true;
+
+        executor_.post(doneProc, job);
+
+        continue;
+      }
+
+      readOutput(job);
+
+      executor_.watchExit(job->command, exitProc, job);
+    }
+  }
+
+  void readOutput(Job *job) {
+    // no data yet
+    if (! job->dest->readAvailable(results_[job->ind].output)) {
+      executor_.watchRead(job->dest->getFd(), readProc, job);
+      return;
+    }
+
+    job->dest->close();
+
+    job->eof = true;
+  }
+
+  void checkDone(Job *job) {
+    if (! job->exited || ! job->eof)
+      return;
+
+    auto &result = results_[job->ind];
+
+    result.returnCode = job->command->getReturnCode();
+    result.signalNum  = job->command->getSignalNum();
+    result.usage      = job->command->getUsage();
+    result.endTime    = CCommandResult::Clock::now();
+
+    delete job->command;
+    delete job;
+
+    --numRunning_;
+
+    startJobs();
+  }
+
+  static void readProc(void *data) {
+    auto *job = static_cast<Job *>(data);
+
+    job->runner->readOutput(job);
+
+    job->runner->checkDone(job);
+  }
+
+  static void exitProc(void *data) {
+    auto *job = static_cast<Job *>(data);
+
+    job->exited = true;
+
+    job->runner->checkDone(job);
+  }
+
+  static void doneProc(void *data) {
+    auto *job = static_cast<Job *>(data);
+
+    job->runner->checkDone(job);
+  }
+
+ private:
+  const ArgsList              &argsList_;
+  size_t                       numJobs_    { 1 };
+  std::vector<CCommandResult> &results_;
+  CCommandExecutor             executor_;
+  size_t                       next_       { 0 };
+  size_t                       numRunning_ { 0 };
+};
+
+}
 
 CCommandMgr::
 CCommandMgr()
@@ -11,6 +193,11 @@ void
 CCommandMgr::
 addCommand(CCommand *command)
 {
+  // SIGCHLD handler iterates command map
+  CCommandBlockSigChild blockSigChild;
+
+  std::unique_lock<std::mutex> mapLock(mapMutex_);
+
   command->setId(++last_id_);
 
   command_map_[last_id_] = command;
@@ -20,6 +207,11 @@ void
 CCommandMgr::
 deleteCommand(CCommand *command)
 {
+  // SIGCHLD handler iterates command map
+  CCommandBlockSigChild blockSigChild;
+
+  std::unique_lock<std::mutex> mapLock(mapMutex_);
+
   command_map_.erase(command->getId());
 }
 
@@ -39,24 +231,389 @@ bool
 CCommandMgr::
 execCommand(const std::string &cmd)
 {
-  std::vector<std::string> words;
+  std::string error;
+
+  auto line = getParser()->compile(cmd, error);
+
+  if (! line) {
+    throwError(error);
+    return false;
+  }
+
+  // deleted if start or wait throws
+  std::unique_ptr<CCommandPipeline> pipeline(line->createPipeline());
+
+  pipeline->start();
+  pipeline->wait ();
+
+  return true;
+}
+
+bool
+CCommandMgr::
+execFileParts(const std::string &name, const CCommand::Args &args,
+              const std::string &filename, int numParts,
+              StringVectorT &outputs, char delim)
+{
+  CCommandRangeFileSrc::Ranges ranges;
+
+  if (! CCommandRangeFileSrc::splitFile(filename, numParts, ranges, delim)) {
+    throwError(filename + ": No such file or directory.");
+    return false;
+  }
+
+  auto numRanges = ranges.size();
+
+  outputs.clear();
+  outputs.resize(numRanges);
+
+  std::vector<CCommand *> commands;
+
+  for (size_t i = 0; i < numRanges; ++i) {
+    auto *command = new CCommand(name, name, args);
+
+    command->addRangeFileSrc(filename, ranges[i].start, ranges[i].end, delim);
+
+    command->addCallbackDest(appendOutput, &outputs[i]);
+
+    commands.push_back(command);
+  }
 
-  CStrUtil::addWords(cmd, words);
+  for (auto *command : commands)
+    command->start();
 
-  if (words.size() == 0)
+  bool rc = true;
+
+  for (auto *command : commands) {
+    command->wait();
+
+    if (! command->isState(CCommand::State::EXITED) || command->getReturnCode() != 0)
+      rc = false;
+  }
+
+  for (auto *command : commands)
+    delete command;
+
+  return rc;
+}
+
+bool
+CCommandMgr::
+mapParallel(const CCommand::Args &templ, const StringVectorT &inputs, int numJobs,
+            std::vector<CCommandResult> &results)
+{
+  results.clear();
+  results.resize(inputs.size());
+
+  if (templ.empty()) {
+    throwError("Empty command template.");
     return false;
+  }
+
+  bool hasInput = std::any_of(templ.begin(), templ.end(),
+    [](const std::string &arg) { return arg.find("{}") != std::string::npos; });
+
+  CCommandMapRunner::ArgsList argsList;
+
+  argsList.resize(inputs.size());
 
-  std::string cmd1 = words[0];
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto &args = argsList[i];
 
-  words.erase(words.begin());
+    for (const auto &arg : templ)
+      args.push_back(substituteArg(arg, inputs[i]));
 
-  CCommand command(cmd1, cmd1, words);
+    if (! hasInput)
+      args.push_back(inputs[i]);
+  }
+
+  if (numJobs <= 0)
+    numJobs = std::max(int(std::thread::hardware_concurrency()), 1);
+
+  CCommandMapRunner runner(argsList, numJobs, results);
+
+  runner.run();
 
-  command.start();
+  for (const auto &result : results)
+    if (! result.isSuccess())
+      return false;
 
   return true;
 }
 
+bool
+CCommandMgr::
+runShared(CCommand *command, CCommandResult &result)
+{
+  // environment is the same for all commands in process so not in key
+  CCommandHash hash;
+
+  if (! hash.addCommand(command, StringVectorT())) {
+    result = command->startAsync(true, true).get();
+    return false;
+  }
+
+  auto key = hash.getKey();
+
+  std::promise<CCommandResult> promise;
+
+  {
+  std::unique_lock<std::mutex> lock(sharedMutex_);
+
+  auto p = sharedResults_.find(key);
+
+  // attach to running command
+  if (p != sharedResults_.end()) {
+    auto sharedResult = (*p).second;
+
+    lock.unlock();
+
+    result = sharedResult.get();
+
+    return true;
+  }
+
+  sharedResults_[key] = promise.get_future().share();
+  }
+
+  // run command and pass result to attached callers
+  try {
+    result = command->startAsync(true, true).get();
+  }
+  catch (...) {
+    {
+    std::unique_lock<std::mutex> lock(sharedMutex_);
+
+    sharedResults_.erase(key);
+    }
+
+    promise.set_exception(std::current_exception());
+
+    throw;
+  }
+
+  {
+  std::unique_lock<std::mutex> lock(sharedMutex_);
+
+  sharedResults_.erase(key);
+  }
+
+  promise.set_value(result);
+
+  return false;
+}
+
+size_t
+CCommandMgr::
+getMaxArgSize()
+{
+  long argMax = sysconf(_SC_ARG_MAX);
+
+  if (argMax <= 0)
+    argMax = 131072; // POSIX minimum is 4096 but linux always allows this
+
+  // environment is passed in same space
+  size_t envSize = 0;
+
+  for (char **env = environ; env && *env; ++env)
+    envSize += execArgSize(*env);
+
+  // leave headroom (like xargs) for exec overhead
+  size_t headroom = 2048;
+
+  if (size_t(argMax) < envSize + headroom + 4096)
+    return 4096;
+
+  return size_t(argMax) - envSize - headroom;
+}
+
+void
+CCommandMgr::
+batchArgs(const CCommand::Args &templ, const StringVectorT &args, size_t maxSize,
+          std::vector<CCommand::Args> &batches)
+{
+  batches.clear();
+
+  size_t templSize = sizeof(char *); // null terminator
+
+  for (const auto &arg : templ)
+    templSize += execArgSize(arg.c_str());
+
+  CCommand::Args batch;
+  size_t         batchSize = templSize;
+
+  for (const auto &arg : args) {
+    auto argSize = execArgSize(arg.c_str());
+
+    // start new batch if arg does not fit (an arg too large on its own gets
+    // a batch to itself and will fail in exec)
+    if (! batch.empty() && batchSize + argSize > maxSize) {
+      batches.push_back(std::move(batch));
+
+      batch     = CCommand::Args();
+      batchSize = templSize;
+    }
+
+    if (batch.empty())
+      batch = templ;
+
+    batch.push_back(arg);
+
+    batchSize += argSize;
+  }
+
+  if (! batch.empty())
+    batches.push_back(std::move(batch));
+}
+
+bool
+CCommandMgr::
+execBatched(const CCommand::Args &templ, const StringVectorT &args, int numJobs,
+            std::string &output, std::vector<CCommandResult> *results)
+{
+  output.clear();
+
+  if (templ.empty()) {
+    throwError("Empty command template.");
+    return false;
+  }
+
+  CCommandMapRunner::ArgsList argsList;
+
+  batchArgs(templ, args, getMaxArgSize(), argsList);
+
+  if (numJobs <= 0)
+    numJobs = std::max(int(std::thread::hardware_concurrency()), 1);
+
+  std::vector<CCommandResult> results1;
+
+  auto &results2 = (results ? *results : results1);
+
+  results2.clear();
+  results2.resize(argsList.size());
+
+  CCommandMapRunner runner(argsList, numJobs, results2);
+
+  runner.run();
+
+  bool rc = true;
+
+  for (auto &result : results2) {
+    output += result.output;
+
+    if (! result.isSuccess())
+      rc = false;
+  }
+
+  return rc;
+}
+
+void
+CCommandMgr::
+addBuiltin(const std::string &name, CCommand::BuiltinProc proc, BuiltinCheckProc check)
+{
+  Builtin builtin;
+
+  builtin.proc  = proc;
+  builtin.check = check;
+
+  std::unique_lock<std::mutex> lock(builtinMutex_);
+
+  builtins_[name] = builtin;
+}
+
+void
+CCommandMgr::
+removeBuiltin(const std::string &name)
+{
+  std::unique_lock<std::mutex> lock(builtinMutex_);
+
+  builtins_.erase(name);
+}
+
+void
+CCommandMgr::
+addStdBuiltins()
+{
+  addBuiltin("cat" , CCommandBuiltins::cat , CCommandBuiltins::catCheck );
+  addBuiltin("head", CCommandBuiltins::head, CCommandBuiltins::headCheck);
+  addBuiltin("tail", CCommandBuiltins::tail, CCommandBuiltins::tailCheck);
+  addBuiltin("wc"  , CCommandBuiltins::wc  , CCommandBuiltins::wcCheck  );
+  addBuiltin("tee" , CCommandBuiltins::tee , CCommandBuiltins::teeCheck );
+  addBuiltin("grep", CCommandBuiltins::grep, CCommandBuiltins::grepCheck);
+}
+
+CCommand::BuiltinProc
+CCommandMgr::
+getBuiltin(const std::string &name, const CCommand::Args &args) const
+{
+  Builtin builtin;
+
+  {
+  std::unique_lock<std::mutex> lock(builtinMutex_);
+
+  if (builtins_.empty())
+    return nullptr;
+
+  // match command name without directory
+  auto pos = name.rfind('/');
+
+  auto p = builtins_.find(pos != std::string::npos ? name.substr(pos + 1) : name);
+
+  if (p == builtins_.end())
+    return nullptr;
+
+  builtin = (*p).second;
+  }
+
+  if (builtin.check && ! builtin.check(args))
+    return nullptr;
+
+  return builtin.proc;
+}
+
+CCommandThreadPool *
+CCommandMgr::
+getThreadPool()
+{
+  if (threadPool_)
+    return threadPool_;
+
+  std::unique_lock<std::mutex> lock(threadPoolMutex_);
+
+  if (! threadPool_)
+    threadPool_ = new CCommandThreadPool;
+
+  return threadPool_;
+}
+
+CCommandParser *
+CCommandMgr::
+getParser()
+{
+  std::unique_lock<std::mutex> lock(parserMutex_);
+
+  if (! parser_)
+    parser_ = new CCommandParser;
+
+  return parser_;
+}
+
+CCommandReaper *
+CCommandMgr::
+getReaper()
+{
+  if (reaper_)
+    return reaper_;
+
+  std::unique_lock<std::mutex> lock(reaperMutex_);
+
+  if (! reaper_)
+    reaper_ = new CCommandReaper;
+
+  return reaper_;
+}
+
 CCommand *
 CCommandMgr::
 lookup(pid_t pid)
@@ -0,0 +1,165 @@
+#include <CCommandOutputDest.h>
+#include <CCommandPipe.h>
+#include <CCommandStdio.h>
+#include <CCommand.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+CCommandOutputDest::
+CCommandOutputDest(CCommand *command, int dest_fd) :
+ CCommandDest(command), dest_fd_(dest_fd)
+{
+}
+
+CCommandOutputDest::
+~CCommandOutputDest()
+{
+  term();
+
+  delete pipe_;
+}
+
+int
+CCommandOutputDest::
+getFd() const
+{
+  return (pipe_ ? pipe_->getInput() : -1);
+}
+
+ssize_t
+CCommandOutputDest::
+read(char *buffer, size_t size)
+{
+  int fd = getFd();
+
+  if (fd < 0)
+    return 0;
+
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, size);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    return len;
+  }
+}
+
+bool
+CCommandOutputDest::
+readAvailable(std::string &str)
+{
+  char buffer[65536];
+
+  for (;;) {
+    ssize_t len = read(buffer, sizeof(buffer));
+
+    if (len > 0) {
+      str.append(buffer, size_t(len));
+      continue;
+    }
+
+    // no more data yet
+    if (len < 0 && errno == EAGAIN)
+      return false;
+
+    return true;
+  }
+}
+
+void
+CCommandOutputDest::
+close()
+{
+  if (pipe_)
+    pipe_->closeInput();
+}
+
+void
+CCommandOutputDest::
+initParent()
+{
+  delete pipe_;
+
+  // pipe is only used by command (read end is closed in other children)
+  pipe_ = new CCommandPipe(command_);
+
+  pipe_->setDest(command_);
+
+  int flags = fcntl(pipe_->getInput(), F_GETFL);
+
+  if (flags < 0 || fcntl(pipe_->getInput(), F_SETFL, flags | O_NONBLOCK) < 0)
+    throwError(std::string("fcntl: ") + strerror(errno));
+
+  if (fcntl(pipe_->getInput(), F_SETFD, FD_CLOEXEC) < 0)
+    throwError(std::string("fcntl: ") + strerror(errno));
+}
+
+void
+CCommandOutputDest::
+initChild()
+{
+  if (command_->getDoFork()) {
+    // redirect command output to pipe output
+    int error = ::close(dest_fd_);
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+  else {
+    // in process output must fit in pipe as it is read afterwards
+    save_fd_ = ::dup(dest_fd_);
+    if (save_fd_ < 0) throwError(std::string("dup: ") + strerror(errno));
+
+    int error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
+void
+CCommandOutputDest::
+initThread(CCommandStdio &stdio)
+{
+  if (! stdio.setFd(dest_fd_, pipe_->getOutput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
+void
+CCommandOutputDest::
+process()
+{
+  // close parent's copy of pipe output so reader sees EOF on exit
+  if (pipe_ && command_->getDoFork()) {
+    int error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
+void
+CCommandOutputDest::
+term()
+{
+  if (save_fd_ != -1) {
+    ::dup2(save_fd_, dest_fd_);
+
+    ::close(save_fd_);
+
+    save_fd_ = -1;
+  }
+
+  if (pipe_ && ! command_->isChild()) {
+    int error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
@@ -0,0 +1,368 @@
+#include <CCommandParser.h>
+#include <CCommandPipeline.h>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+enum class TokenType {
+  NONE,
+  WORD,
+  INPUT,        // <
+  OUTPUT,       // >
+  APPEND,       // >>
+  ERROR,        // >&, 2>
+  APPEND_ERROR, // >>&, 2>>
+  PIPE,         // |
+  PIPE_ERROR    // |&
+};
+
+struct Token {
+  TokenType   type { TokenType::NONE };
+  std::string word;
+};
+
+// split line into words and operators
+class CCommandTokenizer {
+ public:
+  CCommandTokenizer(const std::string &str) :
+   str_(str), len_(str.size()) {
+  }
+
+  const std::string &getError() const { return error_; }
+
+  // get next token, returns false at end of line or on error
+  bool next(Token &token) {
+    token.type = TokenType::NONE;
+    token.word.clear();
+
+    while (pos_ < len_ && isspace(str_[pos_]))
+      ++pos_;
+
+    if (pos_ >= len_ || str_[pos_] == '#')
+      return false;
+
+    if (readOperator(token.type))
+      return true;
+
+    token.type = TokenType::WORD;
+
+    while (pos_ < len_) {
+      char c = str_[pos_];
+
+      if (isspace(c) || isOperatorChar(c))
+        break;
+
+      if      (c == '\'') {
+        auto end = str_.find('\'', pos_ + 1);
+
+        if (end == std::string::npos) {
+          error_ = "Unmatched '.";
+          return false;
+        }
+
+        token.word.append(str_, pos_ + 1, end - pos_ - 1);
+
+        pos_ = end + 1;
+      }
+      else if (c == '"') {
+        ++pos_;
+
+        while (pos_ < len_ && str_[pos_] != '"') {
+          if (str_[pos_] == '\\' && pos_ + 1 < len_ && isDoubleQuoteEscape(str_[pos_ + 1]))
+            ++pos_;
+
+          token.word += str_[pos_++];
+        }
+
+        if (pos_ >= len_) {
+          error_ = "Unmatched \".";
+          return false;
+        }
+
+        ++pos_;
+      }
+      else if (c == '\\') {
+        if (pos_ + 1 >= len_) {
+          error_ = "Trailing \\.";
+          return false;
+        }
+
+        token.word += str_[pos_ + 1];
+
+        pos_ += 2;
+      }
+      else {
+        // run of plain characters
+        auto start = pos_++;
+
+        while (pos_ < len_ && isPlainChar(str_[pos_]))
+          ++pos_;
+
+        token.word.append(str_, start, pos_ - start);
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  bool readOperator(TokenType &type) {
+    auto match = [&](const char *op, TokenType opType) {
+      auto n = strlen(op);
+
+      if (str_.compare(pos_, n, op) != 0)
+        return false;
+
+      pos_ += n;
+      type  = opType;
+
+      return true;
+    };
+
+    char c = str_[pos_];
+
+    if      (c == '<')
+      return match("<", TokenType::INPUT);
+    else if (c == '>')
+      return (match(">>&", TokenType::APPEND_ERROR) || match(">>", TokenType::APPEND) ||
+              match(">&" , TokenType::ERROR       ) || match(">" , TokenType::OUTPUT));
+    else if (c == '|')
+      return (match("|&", TokenType::PIPE_ERROR) || match("|", TokenType::PIPE));
+    else if (c == '2')
+      return (match("2>>", TokenType::APPEND_ERROR) || match("2>", TokenType::ERROR));
+
+    return false;
+  }
+
+  static bool isPlainChar(char c) {
+    return (! isspace(c) && ! isOperatorChar(c) && c != '\'' && c != '"' && c != '\\');
+  }
+
+  static bool isOperatorChar(char c) {
+    return (c == '<' || c == '>' || c == '|');
+  }
+
+  static bool isDoubleQuoteEscape(char c) {
+    return (c == '"' || c == '\\' || c == '$' || c == '`' || c == '\n');
+  }
+
+ private:
+  const std::string &str_;
+  size_t             len_ { 0 };
+  size_t             pos_ { 0 };
+  std::string        error_;
+};
+
+}
+
+//---
+
+CCommandPipeline *
+CCommandCompiledLine::
+createPipeline() const
+{
+  auto *pipeline = new CCommandPipeline;
+
+  for (const auto &stage : stages_) {
+    auto *command = pipeline->addStage(stage.name, stage.name, stage.args, stage.pipeError);
+
+    for (const auto &file : stage.inputs)
+      command->addFileSrc(file);
+
+    for (const auto &output : stage.outputs) {
+      command->addFileDest(output.file, output.fd);
+
+      if (output.append)
+        command->setFileDestAppend(true, output.fd);
+    }
+  }
+
+  return pipeline;
+}
+
+//---
+
+CCommandParser::
+CCommandParser(size_t cacheSize) :
+ cacheSize_(cacheSize)
+{
+}
+
+void
+CCommandParser::
+setCacheSize(size_t size)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  cacheSize_ = size;
+
+  trimCache();
+}
+
+CCommandParser::CompiledLineP
+CCommandParser::
+compile(const std::string &str, std::string &error)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  auto p = cacheMap_.find(str);
+
+  if (p != cacheMap_.end()) {
+    ++numHits_;
+
+    // move to front (most recently used)
+    cacheList_.splice(cacheList_.begin(), cacheList_, (*p).second);
+
+    return (*p).second->line;
+  }
+
+  ++numMisses_;
+  }
+
+  // parse outside lock
+  auto *line = new CCommandCompiledLine;
+
+  if (! parse(str, *line, error)) {
+    delete line;
+    return CompiledLineP();
+  }
+
+  CompiledLineP lineP(line);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (cacheSize_ == 0)
+    return lineP;
+
+  // added by another thread while parsing
+  auto p = cacheMap_.find(str);
+
+  if (p != cacheMap_.end())
+    return (*p).second->line;
+
+  CacheEntry entry;
+
+  entry.str  = str;
+  entry.line = lineP;
+
+  cacheList_.push_front(entry);
+
+  cacheMap_[str] = cacheList_.begin();
+
+  trimCache();
+
+  return lineP;
+}
+
+void
+CCommandParser::
+clearCache()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  cacheMap_ .clear();
+  cacheList_.clear();
+}
+
+void
+CCommandParser::
+trimCache()
+{
+  // remove least recently used
+  while (cacheList_.size() > cacheSize_) {
+    cacheMap_.erase(cacheList_.back().str);
+
+    cacheList_.pop_back();
+  }
+}
+
+bool
+CCommandParser::
+parse(const std::string &str, CCommandCompiledLine &line, std::string &error)
+{
+  line.stages_.clear();
+
+  CCommandTokenizer tokenizer(str);
+
+  CCommandCompiledLine::Stage stage;
+
+  bool hasStage = false;
+
+  Token token;
+
+  auto endStage = [&]() {
+    if (stage.name == "") {
+      error = (hasStage ? "Invalid null command." : "Missing command.");
+      return false;
+    }
+
+    line.stages_.push_back(std::move(stage));
+
+    stage = CCommandCompiledLine::Stage();
+
+    return true;
+  };
+
+  while (tokenizer.next(token)) {
+    hasStage = true;
+
+    switch (token.type) {
+      case TokenType::WORD: {
+        if (stage.name == "")
+          stage.name = std::move(token.word);
+        else
+          stage.args.push_back(std::move(token.word));
+
+        break;
+      }
+      case TokenType::PIPE:
+      case TokenType::PIPE_ERROR: {
+        if (! endStage())
+          return false;
+
+        stage.pipeError = (token.type == TokenType::PIPE_ERROR);
+
+        break;
+      }
+      default: {
+        auto type = token.type;
+
+        if (! tokenizer.next(token) || token.type != TokenType::WORD) {
+          error = (tokenizer.getError() != "" ? tokenizer.getError() :
+                                                "Missing name for redirect.");
+          return false;
+        }
+
+        if (type == TokenType::INPUT) {
+          stage.inputs.push_back(std::move(token.word));
+          break;
+        }
+
+        CCommandCompiledLine::Redirect redirect;
+
+        redirect.file   = std::move(token.word);
+        redirect.fd     = (type == TokenType::OUTPUT || type == TokenType::APPEND ? 1 : 2);
+        redirect.append = (type == TokenType::APPEND || type == TokenType::APPEND_ERROR);
+
+        stage.outputs.push_back(redirect);
+
+        break;
+      }
+    }
+  }
+
+  if (tokenizer.getError() != "") {
+    error = tokenizer.getError();
+    return false;
+  }
+
+  // empty line
+  if (! hasStage) {
+    error = "Missing command.";
+    return false;
+  }
+
+  return endStage();
+}
@@ -2,20 +2,27 @@
 #include <CCommand.h>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <unistd.h>
 
-std::list<CCommandPipe *> CCommandPipe::pipes_;
+std::mutex CCommandPipe::mutex_;
 
 CCommandPipe::
 CCommandPipe(CCommand *command) :
  command_(command)
 {
-  int error = ::pipe(fd_);
+  // close on exec so children forked by other commands don't keep pipe open
+  // (child only keeps the ends it dup2's to its stdin/stdout/stderr)
+  int error = 0;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  error = ::pipe2(fd_, O_CLOEXEC);
+  }
 
   if (error < 0)
     throwError(std::string("pipe: ") + strerror(errno));
-
-  pipes_.push_back(this);
 }
 
 CCommandPipe::
@@ -30,14 +37,14 @@ CCommandPipe::
 
   if (error < 0)
     throwError(std::string("close: ") + strerror(errno));
-
-  pipes_.remove(this);
 }
 
 int
 CCommandPipe::
 closeInput()
 {
+  std::unique_lock<std::mutex> lock(mutex_);
+
   int error = 0;
 
   if (fd_[0] != -1)
@@ -52,6 +59,8 @@ int
 CCommandPipe::
 closeOutput()
 {
+  std::unique_lock<std::mutex> lock(mutex_);
+
   int error = 0;
 
   if (fd_[1] != -1)
@@ -62,23 +71,6 @@ closeOutput()
   return error;
 }
 
-void
-CCommandPipe::
-deleteOthers(CCommand *command)
-{
-  std::list<CCommandPipe *>::iterator ppipe = pipes_.begin();
-
-  while (ppipe != pipes_.end()) {
-    if ((*ppipe)->src_ != command && (*ppipe)->dest_ != command) {
-      delete *ppipe;
-
-      ppipe = pipes_.begin();
-    }
-    else
-      ++ppipe;
-  }
-}
-
 void
 CCommandPipe::
 throwError(const std::string &msg)
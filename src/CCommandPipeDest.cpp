@@ -1,6 +1,9 @@
 #include <CCommandPipeDest.h>
 #include <CCommandPipeSrc.h>
 #include <CCommandPipe.h>
+#include <CCommandQueue.h>
+#include <CCommandStdio.h>
+#include <CCommandMgr.h>
 #include <CCommand.h>
 #include <cerrno>
 #include <cstring>
@@ -38,6 +41,13 @@ setPipe(CCommandPipe *pipe)
     pipe_->setDest(command_);
 }
 
+void
+CCommandPipeDest::
+setQueue(CCommandQueue *queue)
+{
+  queue_ = queue;
+}
+
 void
 CCommandPipeDest::
 addFd(int fd)
@@ -49,6 +59,20 @@ void
 CCommandPipeDest::
 initParent()
 {
+  // already connected (see CCommandPipeline)
+  if (pipe_ || queue_)
+    return;
+
+  // in memory queue between thread commands (no syscalls per chunk)
+  if (pipe_src_ && command_->getThreadProc() &&
+      pipe_src_->getCommand()->getThreadProc() && CCommandMgrInst->getUseQueues()) {
+    queue_ = new CCommandQueue;
+
+    pipe_src_->setQueue(queue_);
+
+    return;
+  }
+
   pipe_ = new CCommandPipe(command_);
 
   pipe_->setDest(command_);
@@ -110,6 +134,35 @@ initChild()
   }
 }
 
+void
+CCommandPipeDest::
+initThread(CCommandStdio &stdio)
+{
+  if (queue_) {
+    for (uint i = 0; i < dest_fds_.size(); ++i)
+      stdio.setQueue(dest_fds_[i], queue_);
+
+    return;
+  }
+
+  for (uint i = 0; i < dest_fds_.size(); ++i) {
+    if (! stdio.setFd(dest_fds_[i], pipe_->getOutput()))
+      throwError(std::string("dup: ") + strerror(errno));
+  }
+}
+
+void
+CCommandPipeDest::
+process()
+{
+  // close parent copy of pipe output (after fork) so reader sees EOF when
+  // command exits
+  if (pipe_ && command_->getDoFork()) {
+    int error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
 void
 CCommandPipeDest::
 term()
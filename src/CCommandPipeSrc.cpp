@@ -1,13 +1,15 @@
 #include <CCommandPipeSrc.h>
+#include <CCommandStdio.h>
 #include <CCommandPipeDest.h>
 #include <CCommandPipe.h>
+#include <CCommandQueue.h>
 #include <CCommand.h>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
 #include <unistd.h>
 
-// Note: pipe source owns the pipe used by piep source and destination
+// Note: pipe source owns the pipe (or queue) used by pipe source and destination
 
 CCommandPipeSrc::
 CCommandPipeSrc(CCommand *command) :
@@ -23,10 +25,13 @@ CCommandPipeSrc::
   if (pipe_dest_)
     pipe_dest_->setSrc(nullptr);
 
-  if (pipe_dest_)
-    pipe_dest_->setPipe(nullptr);
+  if (pipe_dest_) {
+    pipe_dest_->setPipe (nullptr);
+    pipe_dest_->setQueue(nullptr);
+  }
 
   delete pipe_;
+  delete queue_;
 }
 
 void
@@ -46,6 +51,13 @@ setPipe(CCommandPipe *pipe)
     pipe_->setSrc(command_);
 }
 
+void
+CCommandPipeSrc::
+setQueue(CCommandQueue *queue)
+{
+  queue_ = queue;
+}
+
 void
 CCommandPipeSrc::
 initParent()
@@ -96,6 +108,34 @@ initChild()
   }
 }
 
+void
+CCommandPipeSrc::
+initThread(CCommandStdio &stdio)
+{
+  if (queue_) {
+    stdio.setQueue(0, queue_);
+    return;
+  }
+
+  // must have pipe set
+  assert(pipe_);
+
+  if (! stdio.setFd(0, pipe_->getInput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
+void
+CCommandPipeSrc::
+process()
+{
+  // close parent copy of pipe input (after fork) so writer gets EPIPE if
+  // command exits before reading all its input
+  if (pipe_ && command_->getDoFork()) {
+    int error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+}
+
 void
 CCommandPipeSrc::
 term()
@@ -0,0 +1,263 @@
+#include <CCommandPipeline.h>
+#include <CCommandPipeDest.h>
+#include <CCommandPipeSrc.h>
+#include <CCommandPipe.h>
+#include <CCommandQueue.h>
+#include <CCommandMgr.h>
+#include <CCommandUtil.h>
+#include <COSSignal.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+CCommandPipeline::
+CCommandPipeline()
+{
+}
+
+CCommandPipeline::
+~CCommandPipeline()
+{
+  for (auto &stage : stages_)
+    delete stage.command;
+}
+
+CCommand *
+CCommandPipeline::
+addStage(CCommand *command, bool pipeError)
+{
+  assert(! started_);
+
+  Stage stage;
+
+  stage.command   = command;
+  stage.pipeError = pipeError;
+
+  stages_.push_back(stage);
+
+  return command;
+}
+
+CCommand *
+CCommandPipeline::
+addStage(const std::string &name, const std::string &path, const Args &args, bool pipeError)
+{
+  return addStage(new CCommand(name, path, args), pipeError);
+}
+
+CCommand *
+CCommandPipeline::
+addStage(const std::string &name, CCommand::ThreadProc proc, CCommand::CallbackData data,
+         const Args &args, bool pipeError)
+{
+  return addStage(new CCommand(name, proc, data, args), pipeError);
+}
+
+CCommand *
+CCommandPipeline::
+getStage(int i) const
+{
+  assert(i >= 0 && i < getNumStages());
+
+  return stages_[size_t(i)].command;
+}
+
+void
+CCommandPipeline::
+start()
+{
+  assert(! started_);
+
+  started_ = true;
+
+  // create all pipes before any stage is started
+  for (size_t i = 1; i < stages_.size(); ++i)
+    connect(stages_[i - 1].command, stages_[i].command, stages_[i].pipeError);
+
+  results_.clear();
+  results_.resize(stages_.size());
+
+  auto startTime = CCommandResult::Clock::now();
+
+  for (auto &result : results_)
+    result.startTime = startTime;
+
+  // stop group leader being reaped before others have joined its group
+  CCommandBlockSigChild blockSigChild;
+
+  CCommand *leader = nullptr;
+
+  for (auto &stage : stages_) {
+    auto *command = stage.command;
+
+    // first forked stage is group leader (thread stages have no process)
+    if (! leader)
+      command->setProcessGroupLeader();
+    else
+      command->setProcessGroup(leader);
+
+    command->start();
+
+    if (! leader && command->getPid() > 0) {
+      leader = command;
+
+      pgid_ = command->getPid();
+    }
+  }
+}
+
+void
+CCommandPipeline::
+connect(CCommand *src, CCommand *dest, bool pipeError)
+{
+  auto *pipeDest = new CCommandPipeDest(src);
+  auto *pipeSrc  = new CCommandPipeSrc (dest);
+
+  pipeDest->addFd(1);
+
+  if (pipeError)
+    pipeDest->addFd(2);
+
+  pipeDest->setSrc (pipeSrc);
+  pipeSrc ->setDest(pipeDest);
+
+  // in memory queue between thread commands (owned by pipe source)
+  if (src->getThreadProc() && dest->getThreadProc() && CCommandMgrInst->getUseQueues()) {
+    auto *queue = new CCommandQueue;
+
+    pipeDest->setQueue(queue);
+    pipeSrc ->setQueue(queue);
+  }
+  else {
+    auto *pipe = new CCommandPipe(src);
+
+    pipeDest->setPipe(pipe);
+    pipeSrc ->setPipe(pipe);
+  }
+
+  src ->addDest(pipeDest);
+  dest->addSrc (pipeSrc);
+}
+
+void
+CCommandPipeline::
+wait()
+{
+  if (! started_)
+    return;
+
+  // reap forked stages in exit order from the process group. The exited
+  // stage is found without reaping it and then reaped by its command, so
+  // its status can't be taken by the SIGCHLD handler (on another thread)
+  if (pgid_ > 0) {
+    CCommandBlockSigChild blockSigChild;
+
+    while (isRunning()) {
+      siginfo_t info;
+
+      memset(&info, 0, sizeof(info));
+
+      if (waitid(P_PGID, id_t(pgid_), &info, WEXITED | WNOWAIT) < 0) {
+        if (errno == EINTR)
+          continue;
+
+        // remaining stages already reaped (finished below)
+        break;
+      }
+
+      int i = stageIndex(info.si_pid);
+
+      if (i < 0) {
+        // not a stage (stop waiting for it)
+        int status;
+
+        (void) ::wait4(info.si_pid, &status, WNOHANG, nullptr);
+
+        continue;
+      }
+
+      auto *command = stages_[size_t(i)].command;
+
+      command->reapProcess(false);
+
+      if (command->isState(CCommand::State::EXITED) ||
+          command->isState(CCommand::State::SIGNALLED))
+        results_[size_t(i)].endTime = CCommandResult::Clock::now();
+    }
+  }
+
+  // finish thread stages and signalled or already reaped processes. Always
+  // wait as a stage reaped by the SIGCHLD handler is EXITED but its srcs and
+  // dests (captured output) are not terminated until then
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    auto *command = stages_[i].command;
+    auto &result  = results_[i];
+
+    command->waitpid();
+
+    if (result.endTime == CCommandResult::TimePoint())
+      result.endTime = CCommandResult::Clock::now();
+
+    result.returnCode = command->getReturnCode();
+    result.signalNum  = command->getSignalNum();
+    result.usage      = command->getUsage();
+  }
+}
+
+void
+CCommandPipeline::
+stop()
+{
+  if (pgid_ > 0 && isRunning()) {
+    int errorCode = COSSignal::sendSignal(-pgid_, SIGTERM);
+
+    if (errorCode < 0)
+      CCommandMgrInst->throwError(std::string("kill: ") + strerror(errno) + ".");
+  }
+}
+
+int
+CCommandPipeline::
+getReturnCode() const
+{
+  if (results_.empty())
+    return -1;
+
+  if (pipeFail_) {
+    for (auto p = results_.rbegin(); p != results_.rend(); ++p)
+      if ((*p).returnCode != 0)
+        return (*p).returnCode;
+
+    return 0;
+  }
+
+  return results_.back().returnCode;
+}
+
+bool
+CCommandPipeline::
+isRunning() const
+{
+  for (const auto &stage : stages_) {
+    auto *command = stage.command;
+
+    if (! command->isThread() && command->getPid() > 0 &&
+        command->isState(CCommand::State::RUNNING))
+      return true;
+  }
+
+  return false;
+}
+
+int
+CCommandPipeline::
+stageIndex(pid_t pid) const
+{
+  for (size_t i = 0; i < stages_.size(); ++i)
+    if (! stages_[i].command->isThread() && stages_[i].command->getPid() == pid)
+      return int(i);
+
+  return -1;
+}
@@ -0,0 +1,155 @@
+#include <CCommandQueue.h>
+#include <algorithm>
+#include <cstring>
+
+CCommandQueue::
+CCommandQueue(size_t size)
+{
+  // power of two so positions wrap with mask
+  size_t size1 = 4096;
+
+  while (size1 < size)
+    size1 <<= 1;
+
+  buffer_.resize(size1);
+
+  mask_ = size1 - 1;
+}
+
+bool
+CCommandQueue::
+write(const char *data, size_t len)
+{
+  size_t tail = tail_.load(std::memory_order_relaxed);
+
+  while (len > 0) {
+    if (readClosed_.load())
+      return false;
+
+    size_t space = buffer_.size() - (tail - head_.load(std::memory_order_acquire));
+
+    if (space == 0) {
+      // sleep until reader frees space (flag and position checks are
+      // sequentially consistent so wakeup can't be lost)
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      writerWaiting_.store(true);
+
+      cond_.wait(lock, [&]() {
+        return (tail - head_.load() < buffer_.size() || readClosed_.load()); });
+
+      writerWaiting_.store(false);
+
+      continue;
+    }
+
+    size_t len1 = std::min(len, space);
+    size_t pos  = tail & mask_;
+    size_t len2 = std::min(len1, buffer_.size() - pos);
+
+    memcpy(&buffer_[pos], data, len2);
+
+    if (len2 < len1)
+      memcpy(&buffer_[0], data + len2, len1 - len2);
+
+    tail += len1;
+    data += len1;
+    len  -= len1;
+
+    tail_.store(tail);
+
+    wakeReader();
+  }
+
+  return true;
+}
+
+ssize_t
+CCommandQueue::
+read(char *buffer, size_t size)
+{
+  size_t head = head_.load(std::memory_order_relaxed);
+
+  for (;;) {
+    size_t avail = tail_.load(std::memory_order_acquire) - head;
+
+    if (avail == 0) {
+      if (writeClosed_.load()) {
+        // recheck for data written before close
+        if (tail_.load() == head)
+          return 0;
+
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      readerWaiting_.store(true);
+
+      cond_.wait(lock, [&]() { return (tail_.load() != head || writeClosed_.load()); });
+
+      readerWaiting_.store(false);
+
+      continue;
+    }
+
+    size_t len1 = std::min(size, avail);
+    size_t pos  = head & mask_;
+    size_t len2 = std::min(len1, buffer_.size() - pos);
+
+    memcpy(buffer, &buffer_[pos], len2);
+
+    if (len2 < len1)
+      memcpy(buffer + len2, &buffer_[0], len1 - len2);
+
+    head_.store(head + len1);
+
+    wakeWriter();
+
+    return ssize_t(len1);
+  }
+}
+
+void
+CCommandQueue::
+closeWrite()
+{
+  writeClosed_.store(true);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  cond_.notify_all();
+}
+
+void
+CCommandQueue::
+closeRead()
+{
+  readClosed_.store(true);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  cond_.notify_all();
+}
+
+void
+CCommandQueue::
+wakeReader()
+{
+  if (readerWaiting_.load()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    cond_.notify_all();
+  }
+}
+
+void
+CCommandQueue::
+wakeWriter()
+{
+  if (writerWaiting_.load()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    cond_.notify_all();
+  }
+}
@@ -0,0 +1,191 @@
+#include <CCommandRangeFileSrc.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CCommandRangeFileSrc::
+CCommandRangeFileSrc(CCommand *command, const std::string &file,
+                     off_t start, off_t end, char delim) :
+ CCommandStreamSrc(command), file_(file), start_(start), end_(end), delim_(delim)
+{
+}
+
+CCommandRangeFileSrc::
+~CCommandRangeFileSrc()
+{
+  if (file_fd_ != -1)
+    ::close(file_fd_);
+}
+
+bool
+CCommandRangeFileSrc::
+splitFile(const std::string &file, int n, Ranges &ranges, char delim)
+{
+  ranges.clear();
+
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  off_t size = st.st_size;
+
+  if (n < 1) n = 1;
+
+  off_t start = 0;
+
+  for (int i = 1; i <= n && start < size; ++i) {
+    off_t end = (i < n ? alignOffset(fd, off_t(size*i/n), size, delim) : size);
+
+    // part smaller than a record
+    if (end <= start)
+      continue;
+
+    ranges.emplace_back(start, end);
+
+    start = end;
+  }
+
+  ::close(fd);
+
+  return true;
+}
+
+off_t
+CCommandRangeFileSrc::
+alignOffset(int fd, off_t pos, off_t size, char delim)
+{
+  if (pos <= 0)
+    return 0;
+
+  if (pos >= size)
+    return size;
+
+  // record starts after first delimiter at or after pos - 1
+  char buffer[4096];
+
+  off_t pos1 = pos - 1;
+
+  while (pos1 < size) {
+    ssize_t len = ::pread(fd, buffer, sizeof(buffer), pos1);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len <= 0)
+      break;
+
+    auto *p = static_cast<const char *>(memchr(buffer, delim, size_t(len)));
+
+    if (p)
+      return pos1 + (p - buffer) + 1;
+
+    pos1 += len;
+  }
+
+  return size;
+}
+
+void
+CCommandRangeFileSrc::
+initStream()
+{
+  file_fd_ = ::open(file_.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (file_fd_ < 0) {
+    setStreamError(std::string("open: ") + file_ + " " + strerror(errno));
+    return;
+  }
+
+  struct stat st;
+
+  if (fstat(file_fd_, &st) < 0) {
+    setStreamError(std::string("stat: ") + file_ + " " + strerror(errno));
+    return;
+  }
+
+  range_.start = alignOffset(file_fd_, start_, st.st_size, delim_);
+  range_.end   = alignOffset(file_fd_, end_  , st.st_size, delim_);
+
+  if (range_.end < range_.start)
+    range_.end = range_.start;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(file_fd_, range_.start, range_.size(), POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void
+CCommandRangeFileSrc::
+writeStream(int fd)
+{
+  if (file_fd_ < 0)
+    return;
+
+  off_t pos = range_.start;
+
+#ifdef __linux__
+  // move file pages into the pipe without copying through user space
+  while (pos < range_.end) {
+    loff_t off = pos;
+
+    ssize_t len = ::splice(file_fd_, &off, fd, nullptr, size_t(range_.end - pos), SPLICE_F_MOVE);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    // reader stopped early
+    if (len < 0 && errno == EPIPE)
+      return;
+
+    // not supported (fall back to copy)
+    if (len <= 0)
+      break;
+
+    pos += len;
+  }
+#endif
+
+  char buffer[65536];
+
+  while (pos < range_.end) {
+    size_t len = size_t(std::min(off_t(sizeof(buffer)), range_.end - pos));
+
+    ssize_t len1 = ::pread(file_fd_, buffer, len, pos);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      setStreamError(std::string("read: ") + file_ + " " + strerror(errno));
+      return;
+    }
+
+    // file truncated
+    if (len1 == 0)
+      return;
+
+    if (! writeData(fd, buffer, size_t(len1)))
+      return;
+
+    pos += len1;
+  }
+}
+
+void
+CCommandRangeFileSrc::
+termStream()
+{
+  if (file_fd_ != -1) {
+    ::close(file_fd_);
+
+    file_fd_ = -1;
+  }
+}
@@ -0,0 +1,367 @@
+#include <CCommandReaper.h>
+#include <CCommand.h>
+#include <CCommandOutputDest.h>
+#include <CCommandUtil.h>
+#include <cerrno>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+// epoll data (nullptr for event fd)
+struct CCommandReaper::Watch {
+  Job  *job    { nullptr };
+  bool  stream { false };
+};
+
+// captured output stream
+struct CCommandReaper::Stream : public Watch {
+  CCommandOutputDest *dest { nullptr };
+  std::string        *str  { nullptr };
+  bool                eof  { true };
+};
+
+// async command
+struct CCommandReaper::Job : public Watch {
+  CCommand                     *command { nullptr };
+  std::promise<CCommandResult>  promise;
+  CCommandResult                result;
+  Stream                        out;
+  Stream                        err;
+  int                           pidfd   { -1 };
+  bool                          poll    { false };
+  bool                          exited  { false };
+};
+
+//---
+
+CCommandReaper::
+CCommandReaper()
+{
+  eventFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  epfd_    = epoll_create1(EPOLL_CLOEXEC);
+
+  struct epoll_event event;
+
+  event.events   = EPOLLIN;
+  event.data.ptr = nullptr;
+
+  epoll_ctl(epfd_, EPOLL_CTL_ADD, eventFd_, &event);
+
+  thread_ = CCommandUtil::createThread(runThread, this);
+}
+
+CCommandReaper::
+~CCommandReaper()
+{
+  Message message;
+
+  message.type = MessageType::STOP;
+
+  post(message);
+
+  thread_.join();
+
+  // unfinished futures get broken promise
+  for (auto &pj : jobs_) {
+    if (pj.second->pidfd >= 0)
+      ::close(pj.second->pidfd);
+
+    delete pj.second;
+  }
+
+  ::close(epfd_);
+  ::close(eventFd_);
+}
+
+std::future<CCommandResult>
+CCommandReaper::
+start(CCommand *command, bool captureOutput, bool captureError)
+{
+  auto *job = new Job;
+
+  job->job     = job;
+  job->command = command;
+
+  auto initStream = [&](Stream &stream, std::string &str, int fd) {
+    stream.job    = job;
+    stream.stream = true;
+    stream.dest   = command->addOutputDest(fd);
+    stream.str    = &str;
+    stream.eof    = false;
+  };
+
+  if (captureOutput)
+    initStream(job->out, job->result.output, 1);
+
+  if (captureError)
+    initStream(job->err, job->result.error, 2);
+
+  auto future = job->promise.get_future();
+
+  // set before start so SIGCHLD handler never reaps command
+  command->async_ = true;
+
+  job->result.startTime = CCommandResult::Clock::now();
+
+  try {
+    command->start();
+  }
+  catch (...) {
+    command->async_ = false;
+
+    delete job;
+
+    throw;
+  }
+
+  Message message;
+
+  message.type = MessageType::ADD;
+  message.job  = job;
+
+  post(message);
+
+  return future;
+}
+
+void
+CCommandReaper::
+threadDone(CCommand *command)
+{
+  Message message;
+
+  message.type    = MessageType::THREAD_DONE;
+  message.command = command;
+
+  post(message);
+}
+
+void
+CCommandReaper::
+post(const Message &message)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  messages_.push_back(message);
+  }
+
+  uint64_t value = 1;
+
+  while (::write(eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+    ;
+}
+
+void
+CCommandReaper::
+runThread(CCommandReaper *reaper)
+{
+  reaper->run();
+}
+
+void
+CCommandReaper::
+run()
+{
+  struct epoll_event events[64];
+
+  for (;;) {
+    int n = epoll_wait(epfd_, events, 64, (numPolls_ > 0 ? 10 : -1));
+
+    for (int i = 0; i < n; ++i) {
+      auto *watch = static_cast<Watch *>(events[i].data.ptr);
+
+      if      (! watch) {
+        if (! processMessages())
+          return;
+      }
+      else if (watch->stream)
+        readStream(static_cast<Stream *>(watch));
+      else
+        reap(watch->job);
+    }
+
+    // no pidfd so check exit of all polled jobs
+    if (numPolls_ > 0) {
+      std::vector<Job *> polls;
+
+      for (auto &pj : jobs_)
+        if (pj.second->poll)
+          polls.push_back(pj.second);
+
+      for (auto *job : polls)
+        reap(job);
+    }
+  }
+}
+
+bool
+CCommandReaper::
+processMessages()
+{
+  uint64_t value;
+
+  while (::read(eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+    ;
+
+  Messages messages;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  std::swap(messages, messages_);
+  }
+
+  for (const auto &message : messages) {
+    if      (message.type == MessageType::ADD)
+      addJob(message.job);
+    else if (message.type == MessageType::THREAD_DONE) {
+      auto p = jobs_.find(message.command);
+
+      // thread can finish before its job is added
+      if (p != jobs_.end())
+        reap((*p).second);
+      else
+        doneThreads_.insert(message.command);
+    }
+    else
+      return false;
+  }
+
+  return true;
+}
+
+void
+CCommandReaper::
+addJob(Job *job)
+{
+  auto *command = job->command;
+
+  jobs_[command] = job;
+
+  for (auto *stream : {&job->out, &job->err}) {
+    if (stream->eof)
+      continue;
+
+    struct epoll_event event;
+
+    event.events   = EPOLLIN;
+    event.data.ptr = stream;
+
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, stream->dest->getFd(), &event);
+  }
+
+  if (command->isThread()) {
+    auto p = doneThreads_.find(command);
+
+    if (p != doneThreads_.end()) {
+      doneThreads_.erase(p);
+
+      reap(job);
+    }
+
+    return;
+  }
+
+  // pidfd is readable when process exits
+  if (command->getDoFork() && command->getPid() > 0) {
+    job->pidfd = int(syscall(SYS_pidfd_open, command->getPid(), 0));
+
+    if (job->pidfd >= 0) {
+      struct epoll_event event;
+
+      event.events   = EPOLLIN;
+      event.data.ptr = job;
+
+      if (epoll_ctl(epfd_, EPOLL_CTL_ADD, job->pidfd, &event) == 0)
+        return;
+
+      ::close(job->pidfd);
+
+      job->pidfd = -1;
+    }
+
+    job->poll = true;
+
+    ++numPolls_;
+
+    return;
+  }
+
+  // run in process (or failed to start)
+  job->exited = true;
+
+  job->result.endTime = CCommandResult::Clock::now();
+
+  checkDone(job);
+}
+
+void
+CCommandReaper::
+reap(Job *job)
+{
+  if (job->exited || ! job->command->reapAsync())
+    return;
+
+  job->exited = true;
+
+  job->result.endTime = CCommandResult::Clock::now();
+
+  if (job->pidfd >= 0) {
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, job->pidfd, nullptr);
+
+    ::close(job->pidfd);
+
+    job->pidfd = -1;
+  }
+
+  if (job->poll) {
+    job->poll = false;
+
+    --numPolls_;
+  }
+
+  checkDone(job);
+}
+
+void
+CCommandReaper::
+readStream(Stream *stream)
+{
+  if (! stream->dest->readAvailable(*stream->str))
+    return;
+
+  epoll_ctl(epfd_, EPOLL_CTL_DEL, stream->dest->getFd(), nullptr);
+
+  stream->dest->close();
+
+  stream->eof = true;
+
+  checkDone(stream->job);
+}
+
+void
+CCommandReaper::
+checkDone(Job *job)
+{
+  if (! job->exited || ! job->out.eof || ! job->err.eof)
+    return;
+
+  auto *command = job->command;
+
+  job->result.returnCode = command->getReturnCode();
+  job->result.signalNum  = command->getSignalNum();
+  job->result.usage      = command->getUsage();
+
+  jobs_.erase(command);
+
+  job->promise.set_value(std::move(job->result));
+
+  delete job;
+}
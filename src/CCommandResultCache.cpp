@@ -0,0 +1,661 @@
+#include <CCommandResultCache.h>
+#include <CCommandMgr.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char *indexMagic  = "CCMDRC1";
+const char *resultMagic = "CCMDRR1";
+
+bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t len1 = ::write(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0)
+      return false;
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+bool readAll(int fd, char *data, size_t len) {
+  while (len > 0) {
+    ssize_t len1 = ::read(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 <= 0)
+      return false;
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+struct ResultHeader {
+  char     magic[8];
+  int32_t  returnCode;
+  int32_t  signalNum;
+  uint64_t outputLen;
+  uint64_t errorLen;
+};
+
+}
+
+//---
+
+struct CCommandResultCache::Header {
+  char     magic[8];
+  uint64_t capacity;
+  uint64_t numEntries;
+  uint64_t totalSize;
+  uint64_t clock;      // last use counter
+};
+
+struct CCommandResultCache::Entry {
+  uint64_t h1;
+  uint64_t h2;
+  uint64_t size;
+  uint64_t lastUsed;   // 0 for empty entry
+};
+
+//---
+
+CCommandResultCache::
+CCommandResultCache(const std::string &dir, size_t maxSize, size_t maxEntries) :
+ dir_(dir), maxSize_(maxSize), maxEntries_(std::max(maxEntries, size_t(1)))
+{
+  envVars_ = {{ "LANG", "LC_ALL", "LC_COLLATE", "LC_CTYPE", "LC_NUMERIC", "TZ" }};
+
+  if (! open()) {
+    if (header_)
+      ::munmap(header_, indexSize_);
+
+    if (fd_ >= 0)
+      ::close(fd_);
+
+    header_ = nullptr;
+    index_  = nullptr;
+    fd_     = -1;
+  }
+}
+
+CCommandResultCache::
+~CCommandResultCache()
+{
+  if (header_)
+    ::munmap(header_, indexSize_);
+
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+bool
+CCommandResultCache::
+open()
+{
+  if (::mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST) {
+    CCommandMgrInst->throwError(std::string("mkdir: ") + strerror(errno));
+    return false;
+  }
+
+  if (::mkdir((dir_ + "/data").c_str(), 0755) < 0 && errno != EEXIST) {
+    CCommandMgrInst->throwError(std::string("mkdir: ") + strerror(errno));
+    return false;
+  }
+
+  fd_ = ::open((dir_ + "/index").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+  if (fd_ < 0) {
+    CCommandMgrInst->throwError(std::string("open: ") + strerror(errno));
+    return false;
+  }
+
+  // table at most half full
+  capacity_ = 16;
+
+  while (capacity_ < 2*maxEntries_)
+    capacity_ *= 2;
+
+  ::flock(fd_, LOCK_EX);
+
+  bool ok = true;
+
+  struct stat st;
+
+  if (::fstat(fd_, &st) < 0) {
+    CCommandMgrInst->throwError(std::string("fstat: ") + strerror(errno));
+    ok = false;
+  }
+
+  // use existing index (keeping its capacity) if valid
+  if (ok && st.st_size > off_t(sizeof(Header))) {
+    Header header;
+
+    if (::pread(fd_, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+        memcmp(header.magic, indexMagic, 8) == 0 &&
+        st.st_size == off_t(sizeof(Header) + header.capacity*sizeof(Entry)))
+      capacity_ = header.capacity;
+    else
+      st.st_size = 0;
+  }
+  else
+    st.st_size = 0;
+
+  indexSize_ = sizeof(Header) + capacity_*sizeof(Entry);
+
+  bool init = (st.st_size == 0);
+
+  if (ok && init) {
+    if (::ftruncate(fd_, 0) < 0 || ::ftruncate(fd_, off_t(indexSize_)) < 0) {
+      CCommandMgrInst->throwError(std::string("ftruncate: ") + strerror(errno));
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    void *p = ::mmap(nullptr, indexSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if (p == MAP_FAILED) {
+      CCommandMgrInst->throwError(std::string("mmap: ") + strerror(errno));
+      ok = false;
+    }
+    else {
+      header_ = static_cast<Header *>(p);
+      index_  = reinterpret_cast<Entry *>(header_ + 1);
+    }
+  }
+
+  if (ok && init) {
+    memcpy(header_->magic, indexMagic, 8);
+
+    header_->capacity   = capacity_;
+    header_->numEntries = 0;
+    header_->totalSize  = 0;
+    header_->clock      = 0;
+  }
+
+  ::flock(fd_, LOCK_UN);
+
+  // can't hold more than half capacity of existing index
+  maxEntries_ = std::min(maxEntries_, size_t(capacity_/2));
+
+  return ok;
+}
+
+bool
+CCommandResultCache::
+run(CCommand *command, CCommandResult &result)
+{
+  Key key;
+
+  bool cacheable = (isValid() && getKey(command, key));
+
+  if (cacheable && lookup(key, result))
+    return true;
+
+  result = command->startAsync(true, true).get();
+
+  // signalled (or failed to start) commands may not be repeatable
+  if (cacheable && result.returnCode >= 0 && result.signalNum < 0)
+    store(key, result);
+
+  return false;
+}
+
+bool
+CCommandResultCache::
+getKey(CCommand *command, Key &key) const
+{
+  CCommandHash hash;
+
+  hash.addString("CCommandResultCache");
+
+  if (! hash.addCommand(command, envVars_))
+    return false;
+
+  key = hash.getKey();
+
+  return true;
+}
+
+bool
+CCommandResultCache::
+lookup(const Key &key, CCommandResult &result)
+{
+  if (! isValid())
+    return false;
+
+  lock();
+
+  auto *entry = findEntry(key);
+
+  if (entry)
+    entry->lastUsed = ++header_->clock;
+
+  unlock();
+
+  if (entry && readResult(resultFile(key), result)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    ++numHits_;
+
+    return true;
+  }
+
+  // result file removed or corrupt
+  if (entry)
+    remove(key);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  ++numMisses_;
+
+  return false;
+}
+
+bool
+CCommandResultCache::
+store(const Key &key, const CCommandResult &result)
+{
+  if (! isValid())
+    return false;
+
+  auto filename = resultFile(key);
+
+  // write to temporary file and rename so readers never see a partial result
+  static std::atomic<uint> tmpCount;
+
+  auto tmpFilename = filename + ".tmp." + std::to_string(getpid()) + "." +
+                     std::to_string(tmpCount++);
+
+  size_t size;
+
+  if (! writeResult(tmpFilename, result, size)) {
+    ::unlink(tmpFilename.c_str());
+    return false;
+  }
+
+  if (size > maxSize_) {
+    ::unlink(tmpFilename.c_str());
+    return false;
+  }
+
+  lock();
+
+  bool ok = true;
+
+  if (::rename(tmpFilename.c_str(), filename.c_str()) < 0) {
+    CCommandMgrInst->throwError(std::string("rename: ") + strerror(errno));
+
+    ::unlink(tmpFilename.c_str());
+
+    ok = false;
+  }
+
+  if (ok) {
+    auto *entry = findEntry(key);
+
+    if (entry)
+      header_->totalSize -= entry->size;
+    else
+      entry = addEntry(key);
+
+    entry->size     = size;
+    entry->lastUsed = ++header_->clock;
+
+    header_->totalSize += size;
+
+    evict();
+  }
+
+  unlock();
+
+  return ok;
+}
+
+void
+CCommandResultCache::
+remove(const Key &key)
+{
+  if (! isValid())
+    return;
+
+  lock();
+
+  auto *entry = findEntry(key);
+
+  if (entry)
+    removeEntry(entry);
+
+  unlock();
+}
+
+void
+CCommandResultCache::
+clear()
+{
+  if (! isValid())
+    return;
+
+  lock();
+
+  for (uint64_t i = 0; i < capacity_; ++i) {
+    auto &entry = index_[i];
+
+    if (entry.lastUsed == 0)
+      continue;
+
+    Key key;
+
+    key.h1 = entry.h1;
+    key.h2 = entry.h2;
+
+    ::unlink(resultFile(key).c_str());
+
+    memset(&entry, 0, sizeof(entry));
+  }
+
+  header_->numEntries = 0;
+  header_->totalSize  = 0;
+
+  unlock();
+}
+
+size_t
+CCommandResultCache::
+getNumHits() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numHits_;
+}
+
+size_t
+CCommandResultCache::
+getNumMisses() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numMisses_;
+}
+
+size_t
+CCommandResultCache::
+getSize() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return (header_ ? size_t(header_->totalSize) : 0);
+}
+
+size_t
+CCommandResultCache::
+getNumEntries() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return (header_ ? size_t(header_->numEntries) : 0);
+}
+
+void
+CCommandResultCache::
+lock()
+{
+  // flock excludes other processes, mutex other threads
+  mutex_.lock();
+
+  ::flock(fd_, LOCK_EX);
+}
+
+void
+CCommandResultCache::
+unlock()
+{
+  ::flock(fd_, LOCK_UN);
+
+  mutex_.unlock();
+}
+
+CCommandResultCache::Entry *
+CCommandResultCache::
+findEntry(const Key &key) const
+{
+  uint64_t mask = capacity_ - 1;
+
+  for (uint64_t i = key.h1 & mask; ; i = (i + 1) & mask) {
+    auto *entry = &index_[i];
+
+    if (entry->lastUsed == 0)
+      return nullptr;
+
+    if (entry->h1 == key.h1 && entry->h2 == key.h2)
+      return entry;
+  }
+}
+
+CCommandResultCache::Entry *
+CCommandResultCache::
+addEntry(const Key &key)
+{
+  // make room (table is never full as entries are limited to half capacity)
+  if (header_->numEntries >= maxEntries_) {
+    uint64_t oldest = 0;
+
+    for (uint64_t i = 0; i < capacity_; ++i)
+      if (index_[i].lastUsed != 0 &&
+          (oldest == 0 || index_[i].lastUsed < index_[oldest - 1].lastUsed))
+        oldest = i + 1;
+
+    if (oldest > 0)
+      removeEntry(&index_[oldest - 1]);
+  }
+
+  uint64_t mask = capacity_ - 1;
+
+  uint64_t i = key.h1 & mask;
+
+  while (index_[i].lastUsed != 0)
+    i = (i + 1) & mask;
+
+  auto *entry = &index_[i];
+
+  entry->h1   = key.h1;
+  entry->h2   = key.h2;
+  entry->size = 0;
+
+  ++header_->numEntries;
+
+  return entry;
+}
+
+void
+CCommandResultCache::
+removeEntry(Entry *entry)
+{
+  Key key;
+
+  key.h1 = entry->h1;
+  key.h2 = entry->h2;
+
+  ::unlink(resultFile(key).c_str());
+
+  header_->totalSize -= entry->size;
+
+  --header_->numEntries;
+
+  // backward shift following entries of probe sequence into hole (no tombstones)
+  uint64_t mask = capacity_ - 1;
+
+  uint64_t i = uint64_t(entry - index_);
+  uint64_t j = i;
+
+  for (;;) {
+    j = (j + 1) & mask;
+
+    if (index_[j].lastUsed == 0)
+      break;
+
+    uint64_t k = index_[j].h1 & mask; // home of entry j
+
+    // move j to hole if its home is not cyclically in (i, j]
+    bool inRange = (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+
+    if (! inRange) {
+      index_[i] = index_[j];
+
+      i = j;
+    }
+  }
+
+  memset(&index_[i], 0, sizeof(Entry));
+}
+
+void
+CCommandResultCache::
+evict()
+{
+  if (header_->totalSize <= maxSize_)
+    return;
+
+  // remove least recently used down to 90% of max size (so evictions are batched)
+  std::vector<std::pair<uint64_t, Key>> entries;
+
+  for (uint64_t i = 0; i < capacity_; ++i) {
+    if (index_[i].lastUsed == 0)
+      continue;
+
+    Key key;
+
+    key.h1 = index_[i].h1;
+    key.h2 = index_[i].h2;
+
+    entries.push_back(std::make_pair(index_[i].lastUsed, key));
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<uint64_t, Key> &e1, const std::pair<uint64_t, Key> &e2) {
+              return e1.first < e2.first;
+            });
+
+  uint64_t targetSize = maxSize_ - maxSize_/10;
+
+  for (const auto &e : entries) {
+    if (header_->totalSize <= targetSize)
+      break;
+
+    // keep just stored result
+    if (e.first == header_->clock)
+      continue;
+
+    auto *entry = findEntry(e.second);
+
+    if (entry)
+      removeEntry(entry);
+  }
+}
+
+std::string
+CCommandResultCache::
+resultFile(const Key &key) const
+{
+  return dir_ + "/data/" + key.toString();
+}
+
+bool
+CCommandResultCache::
+readResult(const std::string &filename, CCommandResult &result) const
+{
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    return false;
+
+  ResultHeader header;
+
+  bool ok = readAll(fd, reinterpret_cast<char *>(&header), sizeof(header)) &&
+            memcmp(header.magic, resultMagic, 8) == 0;
+
+  // lengths must match file size (truncated or corrupt file is a miss)
+  if (ok) {
+    struct stat st;
+
+    uint64_t dataLen = uint64_t(sizeof(header)) + header.outputLen;
+
+    ok = (::fstat(fd, &st) == 0 && st.st_size >= 0 &&
+          header.outputLen <= uint64_t(st.st_size) &&
+          header.errorLen  <= uint64_t(st.st_size) &&
+          dataLen + header.errorLen == uint64_t(st.st_size));
+  }
+
+  if (ok) {
+    result = CCommandResult();
+
+    result.returnCode = header.returnCode;
+    result.signalNum  = header.signalNum;
+
+    result.output.resize(header.outputLen);
+    result.error .resize(header.errorLen);
+
+    ok = readAll(fd, &result.output[0], header.outputLen) &&
+         readAll(fd, &result.error [0], header.errorLen);
+
+    result.startTime = CCommandResult::Clock::now();
+    result.endTime   = result.startTime;
+  }
+
+  ::close(fd);
+
+  return ok;
+}
+
+bool
+CCommandResultCache::
+writeResult(const std::string &filename, const CCommandResult &result, size_t &size) const
+{
+  int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd < 0) {
+    CCommandMgrInst->throwError(std::string("open: ") + strerror(errno));
+    return false;
+  }
+
+  ResultHeader header;
+
+  memcpy(header.magic, resultMagic, 8);
+
+  header.returnCode = result.returnCode;
+  header.signalNum  = result.signalNum;
+  header.outputLen  = result.output.size();
+  header.errorLen   = result.error .size();
+
+  bool ok = writeAll(fd, reinterpret_cast<const char *>(&header), sizeof(header)) &&
+            writeAll(fd, result.output.data(), result.output.size()) &&
+            writeAll(fd, result.error .data(), result.error .size());
+
+  if (! ok)
+    CCommandMgrInst->throwError(std::string("write: ") + strerror(errno));
+
+  ::close(fd);
+
+  size = sizeof(header) + result.output.size() + result.error.size();
+
+  return ok;
+}
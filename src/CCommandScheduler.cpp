@@ -0,0 +1,563 @@
+#include <CCommandScheduler.h>
+#include <CCommand.h>
+#include <CCommandMgr.h>
+#include <CCommandOutputDest.h>
+#include <CCommandUtil.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+// interval between load average checks (ms)
+const int loadInterval = 1000;
+
+}
+
+// captured output stream
+struct CCommandScheduler::Stream {
+  Job                *job  { nullptr };
+  CCommandOutputDest *dest { nullptr };
+  std::string        *str  { nullptr };
+  bool                eof  { true };
+};
+
+// submitted command
+struct CCommandScheduler::Job {
+  enum class State {
+    QUEUED,
+    RUNNING,
+    PAUSED
+  };
+
+  CCommandScheduler            *scheduler     { nullptr };
+  CCommand                     *command       { nullptr };
+  Priority                      priority      { Priority::HIGH };
+  State                         state         { State::QUEUED };
+  bool                          captureOutput { false };
+  bool                          captureError  { false };
+  std::promise<CCommandResult>  promise;
+  CCommandResult                result;
+  Stream                        out;
+  Stream                        err;
+  bool                          failed        { false };
+  bool                          exited        { false };
+};
+
+//---
+
+CCommandScheduler::
+CCommandScheduler(int maxJobs)
+{
+  if (maxJobs <= 0)
+    maxJobs = std::max(int(std::thread::hardware_concurrency()), 1);
+
+  maxJobs_ = maxJobs;
+
+  // SIGCHLD handler only reaps any child if there is no reaper
+  (void) CCommandMgrInst->getReaper();
+
+  eventFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+  thread_ = CCommandUtil::createThread(runThread, this);
+}
+
+CCommandScheduler::
+~CCommandScheduler()
+{
+  wait();
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  stop_ = true;
+  }
+
+  wake();
+
+  thread_.join();
+
+  ::close(eventFd_);
+}
+
+int
+CCommandScheduler::
+getMaxJobs() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return maxJobs_;
+}
+
+void
+CCommandScheduler::
+setMaxJobs(int maxJobs)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  maxJobs_ = std::max(maxJobs, 1);
+  }
+
+  wake();
+}
+
+double
+CCommandScheduler::
+getMaxLoad() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return maxLoad_;
+}
+
+void
+CCommandScheduler::
+setMaxLoad(double load)
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  maxLoad_ = load;
+  }
+
+  wake();
+}
+
+std::future<CCommandResult>
+CCommandScheduler::
+submit(CCommand *command, Priority priority, bool captureOutput, bool captureError)
+{
+  auto *job = new Job;
+
+  job->scheduler     = this;
+  job->command       = command;
+  job->priority      = priority;
+  job->captureOutput = captureOutput;
+  job->captureError  = captureError;
+
+  auto future = job->promise.get_future();
+
+  // set before start so SIGCHLD handler never reaps command (only the
+  // scheduler thread does)
+  command->async_ = true;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  submitted_.push_back(job);
+
+  ++numActive_;
+  ++numQueued_;
+  }
+
+  wake();
+
+  return future;
+}
+
+void
+CCommandScheduler::
+wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  doneCond_.wait(lock, [&]() { return (numActive_ == 0); });
+}
+
+size_t
+CCommandScheduler::
+getNumQueued() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numQueued_;
+}
+
+size_t
+CCommandScheduler::
+getNumRunning() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numRunning_;
+}
+
+size_t
+CCommandScheduler::
+getNumPaused() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numPaused_;
+}
+
+size_t
+CCommandScheduler::
+getNumPreempted() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return numPreempted_;
+}
+
+void
+CCommandScheduler::
+wake()
+{
+  uint64_t value = 1;
+
+  while (::write(eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+    ;
+}
+
+void
+CCommandScheduler::
+runThread(CCommandScheduler *scheduler)
+{
+  scheduler->run();
+}
+
+void
+CCommandScheduler::
+run()
+{
+  executor_.watchRead(eventFd_, eventProc, this);
+
+  auto nextCheck = CCommandResult::Clock::now();
+
+  while (! done_) {
+    int timeout = -1;
+
+    if (getMaxLoad() > 0.0) {
+      auto now = CCommandResult::Clock::now();
+
+      if (now >= nextCheck) {
+        checkLoad();
+
+        nextCheck = now + std::chrono::milliseconds(loadInterval);
+      }
+
+      timeout = int(std::chrono::duration_cast<std::chrono::milliseconds>
+                      (nextCheck - now).count()) + 1;
+    }
+    else
+      overloaded_ = false;
+
+    schedule();
+
+    executor_.runOnce(timeout);
+  }
+}
+
+void
+CCommandScheduler::
+eventProc(void *data)
+{
+  auto *scheduler = static_cast<CCommandScheduler *>(data);
+
+  uint64_t value;
+
+  while (::read(scheduler->eventFd_, &value, sizeof(value)) < 0 && errno == EINTR)
+    ;
+
+  scheduler->processMessages();
+
+  if (! scheduler->done_)
+    scheduler->executor_.watchRead(scheduler->eventFd_, eventProc, scheduler);
+}
+
+void
+CCommandScheduler::
+processMessages()
+{
+  Jobs jobs;
+  bool stop;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  std::swap(jobs, submitted_);
+
+  stop = stop_;
+  }
+
+  for (auto *job : jobs) {
+    if (job->priority == Priority::HIGH)
+      highQueue_.push_back(job);
+    else
+      lowQueue_.push_back(job);
+  }
+
+  // all submitted commands have finished (see destructor)
+  if (stop)
+    done_ = true;
+}
+
+void
+CCommandScheduler::
+schedule()
+{
+  int maxJobs = getMaxJobs();
+
+  // high priority commands can use every slot
+  while (! highQueue_.empty() && numHigh_ < maxJobs) {
+    auto *job = highQueue_.front();
+
+    highQueue_.pop_front();
+
+    startJob(job);
+  }
+
+  // pause low priority commands (newest first) using slots needed by
+  // high priority commands
+  while (! lowRunning_.empty() && numHigh_ + int(lowRunning_.size()) > maxJobs)
+    pauseJob(lowRunning_.back());
+
+  if (overloaded_)
+    return;
+
+  // resume paused (oldest first) then start queued low priority commands
+  // in free slots
+  while (numHigh_ + int(lowRunning_.size()) < maxJobs) {
+    if      (! lowPaused_.empty())
+      resumeJob(lowPaused_.front());
+    else if (! lowQueue_.empty()) {
+      auto *job = lowQueue_.front();
+
+      lowQueue_.pop_front();
+
+      startJob(job);
+    }
+    else
+      break;
+  }
+}
+
+void
+CCommandScheduler::
+checkLoad()
+{
+  double maxLoad = getMaxLoad();
+
+  double load;
+
+  if (maxLoad <= 0.0 || getloadavg(&load, 1) != 1) {
+    overloaded_ = false;
+    return;
+  }
+
+  overloaded_ = (load > maxLoad);
+
+  // pause one command per check as load average is slow to fall
+  if (overloaded_ && ! lowRunning_.empty())
+    pauseJob(lowRunning_.back());
+}
+
+void
+CCommandScheduler::
+startJob(Job *job)
+{
+  auto *command = job->command;
+
+  job->state = Job::State::RUNNING;
+
+  if (job->priority == Priority::HIGH)
+    ++numHigh_;
+  else
+    lowRunning_.push_back(job);
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  --numQueued_;
+  ++numRunning_;
+  }
+
+  // pause/resume whole process tree (builtin runs on a thread which can't
+  // be stopped so always run a process)
+  if (job->priority == Priority::LOW) {
+    command->setProcessGroupLeader();
+
+    command->setAllowBuiltin(false);
+  }
+
+  auto initStream = [&](Stream &stream, std::string &str, int fd) {
+    stream.job  = job;
+    stream.dest = command->addOutputDest(fd);
+    stream.str  = &str;
+    stream.eof  = false;
+  };
+
+  if (job->captureOutput)
+    initStream(job->out, job->result.output, 1);
+
+  if (job->captureError)
+    initStream(job->err, job->result.error, 2);
+
+  job->result.startTime = CCommandResult::Clock::now();
+
+  bool failed = false;
+
+  try {
+    command->start();
+  }
+  catch (...) {
+    command->async_ = false;
+
+    job->promise.set_exception(std::current_exception());
+
+    failed = true;
+  }
+
+  // failed to start
+  if (failed || (! command->isState(CCommand::State::RUNNING) &&
+                 ! command->isState(CCommand::State::EXITED))) {
+    if (job->out.dest) job->out.dest->close();
+    if (job->err.dest) job->err.dest->close();
+
+    job->failed  = failed;
+    job->exited  = true;
+    job->out.eof = true;
+    job->err.eof = true;
+
+    job->result.endTime = CCommandResult::Clock::now();
+
+    checkDone(job);
+
+    return;
+  }
+
+  if (job->out.dest) readStream(&job->out);
+  if (job->err.dest) readStream(&job->err);
+
+  executor_.watchExit(command, exitProc, job);
+}
+
+void
+CCommandScheduler::
+pauseJob(Job *job)
+{
+  try {
+    job->command->pause(/*group*/true);
+  }
+  catch (...) {
+  }
+
+  lowRunning_.remove(job);
+  lowPaused_ .push_back(job);
+
+  job->state = Job::State::PAUSED;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  --numRunning_;
+  ++numPaused_;
+  ++numPreempted_;
+  }
+}
+
+void
+CCommandScheduler::
+resumeJob(Job *job)
+{
+  try {
+    job->command->resume(/*group*/true);
+  }
+  catch (...) {
+  }
+
+  lowPaused_ .remove(job);
+  lowRunning_.push_back(job);
+
+  job->state = Job::State::RUNNING;
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  --numPaused_;
+  ++numRunning_;
+  }
+}
+
+void
+CCommandScheduler::
+readStream(Stream *stream)
+{
+  // no more data yet
+  if (! stream->dest->readAvailable(*stream->str)) {
+    executor_.watchRead(stream->dest->getFd(), readProc, stream);
+    return;
+  }
+
+  stream->dest->close();
+
+  stream->eof = true;
+
+  checkDone(stream->job);
+}
+
+void
+CCommandScheduler::
+checkDone(Job *job)
+{
+  if (! job->exited || ! job->out.eof || ! job->err.eof)
+    return;
+
+  // set result (exception already set if start failed)
+  if (! job->failed) {
+    job->result.returnCode = job->command->getReturnCode();
+    job->result.signalNum  = job->command->getSignalNum();
+    job->result.usage      = job->command->getUsage();
+
+    job->promise.set_value(job->result);
+  }
+
+  if (job->priority == Priority::HIGH)
+    --numHigh_;
+  else {
+    lowRunning_.remove(job);
+    lowPaused_ .remove(job);
+  }
+
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (job->state == Job::State::PAUSED)
+    --numPaused_;
+  else
+    --numRunning_;
+
+  --numActive_;
+  }
+
+  delete job;
+
+  doneCond_.notify_all();
+}
+
+void
+CCommandScheduler::
+readProc(void *data)
+{
+  auto *stream = static_cast<Stream *>(data);
+
+  stream->job->scheduler->readStream(stream);
+}
+
+void
+CCommandScheduler::
+exitProc(void *data)
+{
+  auto *job = static_cast<Job *>(data);
+
+  job->exited = true;
+
+  job->result.endTime = CCommandResult::Clock::now();
+
+  job->scheduler->checkDone(job);
+}
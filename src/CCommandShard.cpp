@@ -0,0 +1,262 @@
+#include <CCommandShard.h>
+#include <CCommandBufferSrc.h>
+#include <CCommandGeneratorSrc.h>
+#include <CCommandCallbackDest.h>
+#include <CCommandStdio.h>
+#include <algorithm>
+#include <cstring>
+#include <list>
+
+struct CCommandShard::WorkerData {
+  CCommandShard *shard { nullptr };
+  std::string    block;
+  size_t         pos   { 0 };
+  std::string    output;
+  CCommand      *command { nullptr };
+};
+
+CCommandShard::
+CCommandShard(const std::string &name, const std::string &path,
+              const Args &args, int numWorkers, bool keepOrder) :
+ CCommand(name, shardProc, this, args), workerPath_(path),
+ numWorkers_(numWorkers > 0 ? numWorkers : 1), keepOrder_(keepOrder)
+{
+}
+
+CCommandShard::
+~CCommandShard()
+{
+}
+
+int
+CCommandShard::
+shardProc(const Args &, CCommandStdio &stdio, CallbackData data)
+{
+  auto *shard = static_cast<CCommandShard *>(data);
+
+  // runs on thread with stage stdin/stdout connected to stdio
+  shard->stdio_ = &stdio;
+
+  bool rc = (shard->keepOrder_ ? shard->runKeepOrder() : shard->runRoundRobin());
+
+  shard->stdio_ = nullptr;
+
+  return (rc ? 0 : 1);
+}
+
+bool
+CCommandShard::
+readBlock(std::string &block)
+{
+  block.clear();
+
+  // read until block size reached and a record end has been read
+  size_t end = std::string::npos;
+
+  for (;;) {
+    if (pending_.size() >= blockSize_) {
+      end = pending_.find(delim_, blockSize_ - 1);
+
+      if (end != std::string::npos)
+        break;
+    }
+
+    if (eof_)
+      break;
+
+    char buffer[65536];
+
+    ssize_t len = stdio_->read(buffer, sizeof(buffer));
+
+    if (len <= 0) {
+      eof_ = true;
+      continue;
+    }
+
+    pending_.append(buffer, size_t(len));
+  }
+
+  if (end == std::string::npos) {
+    block.swap(pending_);
+  }
+  else {
+    block = pending_.substr(0, end + 1);
+
+    pending_.erase(0, end + 1);
+  }
+
+  return ! block.empty();
+}
+
+bool
+CCommandShard::
+runRoundRobin()
+{
+  auto numWorkers = size_t(numWorkers_);
+
+  std::vector<WorkerData> workerData(numWorkers);
+
+  std::vector<CCommand *> workers;
+
+  for (auto &data : workerData) {
+    auto *worker = new CCommand(getName(), workerPath_, getArgs());
+
+    data.shard   = this;
+    data.command = worker;
+
+    worker->addGeneratorSrc(workerInput, &data);
+    worker->addCallbackDest(workerOutput, &data);
+
+    workers.push_back(worker);
+  }
+
+  for (auto *worker : workers)
+    worker->start();
+
+  bool rc = true;
+
+  for (auto &data : workerData) {
+    data.command->wait();
+
+    if (! data.command->isState(State::EXITED) || data.command->getReturnCode() != 0)
+      rc = false;
+
+    // output with no trailing record delimiter
+    if (! data.output.empty())
+      writeOutput(data.output.c_str(), data.output.size());
+
+    delete data.command;
+  }
+
+  return rc;
+}
+
+bool
+CCommandShard::
+runKeepOrder()
+{
+  std::list<WorkerData *> running;
+
+  bool rc = true;
+
+  auto finishOldest = [&]() {
+    auto *data = running.front();
+
+    running.pop_front();
+
+    data->command->wait();
+
+    if (! data->command->isState(State::EXITED) || data->command->getReturnCode() != 0)
+      rc = false;
+
+    writeOutput(data->output.c_str(), data->output.size());
+
+    delete data->command;
+    delete data;
+  };
+
+  for (;;) {
+    auto *data = new WorkerData;
+
+    if (! readBlock(data->block)) {
+      delete data;
+      break;
+    }
+
+    if (int(running.size()) >= numWorkers_)
+      finishOldest();
+
+    data->shard   = this;
+    data->command = new CCommand(getName(), workerPath_, getArgs());
+
+    // block is owned by worker data so can be passed without a copy
+    data->command->addBufferSrc()->addBuffer(data->block);
+
+    data->command->addCallbackDest(appendOutput, &data->output);
+
+    data->command->start();
+
+    running.push_back(data);
+  }
+
+  while (! running.empty())
+    finishOldest();
+
+  return rc;
+}
+
+void
+CCommandShard::
+writeOutput(const char *data, size_t len)
+{
+  // workers' output callbacks run on their stream threads
+  std::unique_lock<std::mutex> lock(outputMutex_);
+
+  stdio_->write(data, len);
+}
+
+size_t
+CCommandShard::
+workerInput(char *buffer, size_t size, CallbackData data)
+{
+  auto *workerData = static_cast<WorkerData *>(data);
+
+  auto *shard = workerData->shard;
+
+  // take next block when previous one has been written
+  if (workerData->pos >= workerData->block.size()) {
+    std::unique_lock<std::mutex> lock(shard->inputMutex_);
+
+    workerData->pos = 0;
+
+    if (! shard->readBlock(workerData->block))
+      return 0;
+  }
+
+  size_t len = std::min(size, workerData->block.size() - workerData->pos);
+
+  memcpy(buffer, &workerData->block[workerData->pos], len);
+
+  workerData->pos += len;
+
+  return len;
+}
+
+void
+CCommandShard::
+workerOutput(const char *buffer, size_t len, CallbackData data)
+{
+  auto *workerData = static_cast<WorkerData *>(data);
+
+  // only write complete records so outputs of workers don't mix in a record
+  auto &output = workerData->output;
+
+  const char *p = buffer + len;
+
+  while (p > buffer && p[-1] != workerData->shard->delim_)
+    --p;
+
+  if (p == buffer) {
+    output.append(buffer, len);
+    return;
+  }
+
+  if (! output.empty()) {
+    output.append(buffer, size_t(p - buffer));
+
+    workerData->shard->writeOutput(output.c_str(), output.size());
+
+    output.clear();
+  }
+  else
+    workerData->shard->writeOutput(buffer, size_t(p - buffer));
+
+  output.append(p, size_t(buffer + len - p));
+}
+
+void
+CCommandShard::
+appendOutput(const char *buffer, size_t len, CallbackData data)
+{
+  static_cast<std::string *>(data)->append(buffer, len);
+}
@@ -0,0 +1,243 @@
+#include <CCommandStdio.h>
+#include <CCommandQueue.h>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t BufferSize = 65536;
+
+}
+
+CCommandStdio::
+CCommandStdio()
+{
+  for (int i = 0; i < 3; ++i) {
+    fds_   [i] = -1;
+    queues_[i] = nullptr;
+  }
+}
+
+CCommandStdio::
+~CCommandStdio()
+{
+  close();
+}
+
+int
+CCommandStdio::
+getFd(int fd) const
+{
+  if (fd < 0 || fd > 2)
+    return -1;
+
+  return fds_[fd];
+}
+
+bool
+CCommandStdio::
+setFd(int fd, int fd1)
+{
+  if (fd < 0 || fd > 2)
+    return false;
+
+  int fd2 = ::fcntl(fd1, F_DUPFD_CLOEXEC, 0);
+
+  if (fd2 < 0)
+    return false;
+
+  if (fds_[fd] != -1)
+    ::close(fds_[fd]);
+
+  fds_[fd] = fd2;
+
+  return true;
+}
+
+void
+CCommandStdio::
+setQueue(int fd, CCommandQueue *queue)
+{
+  if (fd < 0 || fd > 2)
+    return;
+
+  queues_[fd] = queue;
+}
+
+ssize_t
+CCommandStdio::
+read(char *buffer, size_t size)
+{
+  // return data buffered by readLine first
+  if (inPos_ < inBuffer_.size()) {
+    size_t len = std::min(size, inBuffer_.size() - inPos_);
+
+    inBuffer_.copy(buffer, len, inPos_);
+
+    inPos_ += len;
+
+    return ssize_t(len);
+  }
+
+  if (queues_[0])
+    return queues_[0]->read(buffer, size);
+
+  if (fds_[0] == -1)
+    return 0;
+
+  for (;;) {
+    ssize_t len = ::read(fds_[0], buffer, size);
+
+    if (len < 0 && errno == EINTR) continue;
+
+    return len;
+  }
+}
+
+bool
+CCommandStdio::
+readLine(std::string &line)
+{
+  for (;;) {
+    auto p = inBuffer_.find('\n', inPos_);
+
+    if (p != std::string::npos) {
+      line   = inBuffer_.substr(inPos_, p - inPos_);
+      inPos_ = p + 1;
+
+      return true;
+    }
+
+    if (! fillInput()) {
+      // last line with no newline
+      if (inPos_ >= inBuffer_.size())
+        return false;
+
+      line   = inBuffer_.substr(inPos_);
+      inPos_ = inBuffer_.size();
+
+      return true;
+    }
+  }
+}
+
+bool
+CCommandStdio::
+fillInput()
+{
+  if (inEof_ || (fds_[0] == -1 && ! queues_[0]))
+    return false;
+
+  inBuffer_.erase(0, inPos_);
+
+  inPos_ = 0;
+
+  char buffer[BufferSize];
+
+  for (;;) {
+    ssize_t len = (queues_[0] ? queues_[0]->read(buffer, sizeof(buffer)) :
+                                ::read(fds_[0], buffer, sizeof(buffer)));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len <= 0) {
+      inEof_ = true;
+      return false;
+    }
+
+    inBuffer_.append(buffer, size_t(len));
+
+    return true;
+  }
+}
+
+bool
+CCommandStdio::
+write(const char *data, size_t len, int fd)
+{
+  if (fd == 2) {
+    if (queues_[2])
+      return (flush() && queues_[2]->write(data, len));
+
+    return writeData(fds_[2], data, len);
+  }
+
+  if (outBuffer_.size() + len > BufferSize && ! flush())
+    return false;
+
+  if (len > BufferSize)
+    return (queues_[1] ? queues_[1]->write(data, len) : writeData(fds_[1], data, len));
+
+  outBuffer_.append(data, len);
+
+  return true;
+}
+
+bool
+CCommandStdio::
+write(const std::string &str, int fd)
+{
+  return write(str.c_str(), str.size(), fd);
+}
+
+bool
+CCommandStdio::
+flush()
+{
+  if (outBuffer_.empty())
+    return true;
+
+  bool rc = (queues_[1] ? queues_[1]->write(outBuffer_.c_str(), outBuffer_.size()) :
+                          writeData(fds_[1], outBuffer_.c_str(), outBuffer_.size()));
+
+  outBuffer_.clear();
+
+  return rc;
+}
+
+void
+CCommandStdio::
+close()
+{
+  flush();
+
+  for (int i = 0; i < 3; ++i) {
+    if (fds_[i] != -1)
+      ::close(fds_[i]);
+
+    fds_[i] = -1;
+
+    if (queues_[i]) {
+      if (i == 0)
+        queues_[i]->closeRead();
+      else
+        queues_[i]->closeWrite();
+    }
+
+    queues_[i] = nullptr;
+  }
+}
+
+bool
+CCommandStdio::
+writeData(int fd, const char *data, size_t len)
+{
+  if (fd == -1)
+    return false;
+
+  while (len > 0) {
+    ssize_t len1 = ::write(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 <= 0)
+      return false;
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
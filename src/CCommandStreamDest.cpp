@@ -0,0 +1,203 @@
+#include <CCommandStreamDest.h>
+#include <CCommandStdio.h>
+#include <CCommandPipe.h>
+#include <CCommand.h>
+#include <CCommandUtil.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+
+CCommandStreamDest::
+CCommandStreamDest(CCommand *command, int dest_fd) :
+ CCommandDest(command), dest_fd_(dest_fd)
+{
+}
+
+CCommandStreamDest::
+~CCommandStreamDest()
+{
+  if (thread_.joinable())
+    thread_.join();
+
+  delete pipe_;
+}
+
+void
+CCommandStreamDest::
+initParent()
+{
+  delete pipe_;
+
+  pipe_ = new CCommandPipe(command_);
+
+  pipe_->setDest(command_);
+
+  started_    = false;
+  terminated_ = false;
+}
+
+void
+CCommandStreamDest::
+initChild()
+{
+  if (command_->getDoFork()) {
+    // redirect command output to pipe output
+    int error = ::close(dest_fd_);
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    // close pipe (read by parent)
+    error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    initChildStream();
+  }
+  else {
+    // save command output and redirect to pipe output
+    save_fd_ = ::dup(dest_fd_);
+    if (save_fd_ < 0) throwError(std::string("dup: ") + strerror(errno));
+
+    int error = ::dup2(pipe_->getOutput(), dest_fd_);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    // callback runs in this process so pipe must be drained while it runs
+    startStream();
+  }
+}
+
+void
+CCommandStreamDest::
+initThread(CCommandStdio &stdio)
+{
+  if (! stdio.setFd(dest_fd_, pipe_->getOutput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
+void
+CCommandStreamDest::
+process()
+{
+  if (terminated_)
+    return;
+
+  // close parent's copy of pipe output so reader sees EOF on exit
+  int error = pipe_->closeOutput();
+  if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+  startStream();
+}
+
+void
+CCommandStreamDest::
+term()
+{
+  if (command_->isChild() || ! pipe_ || terminated_)
+    return;
+
+  terminated_ = true;
+
+  // restore redirected output (non-fork)
+  if (save_fd_ != -1) {
+    ::dup2(save_fd_, dest_fd_);
+
+    ::close(save_fd_);
+
+    save_fd_ = -1;
+  }
+
+  int error = pipe_->closeOutput();
+  if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+  // command exited before stream was started (all data already in pipe)
+  if (! started_) {
+    initStream();
+
+    // read on this thread with SIGPIPE blocked (as on stream thread)
+    sigset_t mask, oldMask;
+
+    sigemptyset(&mask);
+    sigaddset  (&mask, SIGPIPE);
+
+    pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+
+    readStream(pipe_->getInput());
+
+    // discard SIGPIPE raised by write to closed pipe
+    if (! sigismember(&oldMask, SIGPIPE)) {
+      sigset_t pending;
+
+      sigpending(&pending);
+
+      if (sigismember(&pending, SIGPIPE)) {
+        struct timespec timeout = { 0, 0 };
+
+        sigtimedwait(&mask, nullptr, &timeout);
+      }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+  }
+  else
+    stopStream();
+
+  error = pipe_->closeInput();
+  if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+  termStream();
+
+  if (streamError_ != "") {
+    std::string msg = streamError_;
+
+    streamError_ = "";
+
+    throwError(msg);
+  }
+}
+
+void
+CCommandStreamDest::
+startStream()
+{
+  if (started_)
+    return;
+
+  started_ = true;
+
+  initStream();
+
+  // SIGCHLD handler joins this thread so it must never run on it
+  thread_ = CCommandUtil::createThread(streamThread, this);
+}
+
+void
+CCommandStreamDest::
+stopStream()
+{
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void
+CCommandStreamDest::
+setStreamError(const std::string &msg)
+{
+  if (streamError_ == "")
+    streamError_ = msg;
+}
+
+void
+CCommandStreamDest::
+streamThread(CCommandStreamDest *dest)
+{
+  dest->readStream(dest->pipe_->getInput());
+}
@@ -0,0 +1,192 @@
+#include <CCommandStreamSrc.h>
+#include <CCommandStdio.h>
+#include <CCommandPipe.h>
+#include <CCommand.h>
+#include <CCommandUtil.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+CCommandStreamSrc::
+CCommandStreamSrc(CCommand *command) :
+ CCommandSrc(command)
+{
+}
+
+CCommandStreamSrc::
+~CCommandStreamSrc()
+{
+  if (thread_.joinable())
+    thread_.join();
+
+  delete pipe_;
+}
+
+void
+CCommandStreamSrc::
+initParent()
+{
+  delete pipe_;
+
+  pipe_ = new CCommandPipe(command_);
+
+  pipe_->setSrc(command_);
+
+  started_ = false;
+}
+
+void
+CCommandStreamSrc::
+initChild()
+{
+  if (command_->getDoFork()) {
+    // redirect pipe input to stdin
+    int error = ::close(0);
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = ::dup2(pipe_->getInput(), 0);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    // close pipe (written by parent)
+    error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    error = pipe_->closeOutput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+  }
+  else {
+    // save stdin and redirect pipe input to stdin
+    save_stdin_ = ::dup(0);
+    if (save_stdin_ < 0) throwError(std::string("dup: ") + strerror(errno));
+
+    int error = ::dup2(pipe_->getInput(), 0);
+    if (error < 0) throwError(std::string("dup2: ") + strerror(errno));
+
+    error = pipe_->closeInput();
+    if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+    // callback runs in this process so pipe must be written while it runs
+    startStream();
+  }
+}
+
+void
+CCommandStreamSrc::
+initThread(CCommandStdio &stdio)
+{
+  if (! stdio.setFd(0, pipe_->getInput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
+void
+CCommandStreamSrc::
+process()
+{
+  if (! pipe_)
+    return;
+
+  // close parent's copy of pipe input (child reads it)
+  int error = pipe_->closeInput();
+  if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+  startStream();
+}
+
+void
+CCommandStreamSrc::
+term()
+{
+  if (command_->isChild() || ! pipe_)
+    return;
+
+  // restore redirected stdin (non-fork), this closes the last pipe input so
+  // a writer blocked on a reader which has stopped gets EPIPE
+  if (save_stdin_ != -1) {
+    ::dup2(save_stdin_, 0);
+
+    ::close(save_stdin_);
+
+    save_stdin_ = -1;
+  }
+
+  int error = pipe_->closeInput();
+  if (error < 0) throwError(std::string("close: ") + strerror(errno));
+
+  stopStream();
+
+  termStream();
+
+  if (streamError_ != "") {
+    std::string msg = streamError_;
+
+    streamError_ = "";
+
+    throwError(msg);
+  }
+}
+
+void
+CCommandStreamSrc::
+startStream()
+{
+  if (started_)
+    return;
+
+  started_ = true;
+
+  initStream();
+
+  // stream thread must not run the SIGCHLD handler (which joins it) and
+  // should get EPIPE rather than SIGPIPE when the reader has gone
+  thread_ = CCommandUtil::createThread(streamThread, this);
+}
+
+void
+CCommandStreamSrc::
+stopStream()
+{
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void
+CCommandStreamSrc::
+setStreamError(const std::string &msg)
+{
+  if (streamError_ == "")
+    streamError_ = msg;
+}
+
+bool
+CCommandStreamSrc::
+writeData(int fd, const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t len1 = ::write(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      // reader stopped early
+      if (errno != EPIPE)
+        setStreamError(std::string("write: ") + strerror(errno));
+
+      return false;
+    }
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+void
+CCommandStreamSrc::
+streamThread(CCommandStreamSrc *src)
+{
+  src->writeStream(src->pipe_->getOutput());
+
+  // close pipe output so command sees EOF
+  src->pipe_->closeOutput();
+}
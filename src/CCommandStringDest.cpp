@@ -1,4 +1,6 @@
 #include <CCommandStringDest.h>
+#include <CCommandStdio.h>
+#include <CCommand.h>
 #include <CCommandPipe.h>
 #include <CCommandMgr.h>
 #include <CCommandUtil.h>
@@ -31,6 +33,10 @@ initParent()
 #ifdef USE_PIPE
   pipe_ = new CCommandPipe(command_);
 
+  // thread command writes pipe output directly
+  if (command_->isThread())
+    return;
+
   save_fd_ = dup(dest_fd_);
 
   if (save_fd_ < 0)
@@ -51,6 +57,10 @@ initParent()
   if (fd_ < 0)
     throwError("COSFile::getTempFileNum: failed");
 
+  // thread command writes temp file directly
+  if (command_->isThread())
+    return;
+
   save_fd_ = dup(dest_fd_);
 
   if (save_fd_ < 0)
@@ -71,6 +81,19 @@ initChild()
 {
 }
 
+void
+CCommandStringDest::
+initThread(CCommandStdio &stdio)
+{
+#ifdef USE_PIPE
+  if (! stdio.setFd(dest_fd_, pipe_->getOutput()))
+    throwError(std::string("dup: ") + strerror(errno));
+#else
+  if (! stdio.setFd(dest_fd_, fd_))
+    throwError(std::string("dup: ") + strerror(errno));
+#endif
+}
+
 void
 CCommandStringDest::
 term()
@@ -1,4 +1,7 @@
 #include <CCommandStringSrc.h>
+#include <CCommandStdio.h>
+#include <CCommand.h>
+#include <CCommandHash.h>
 #include <CCommandPipe.h>
 #include <cerrno>
 #include <cstring>
@@ -24,6 +27,10 @@ initParent()
 {
   pipe_ = new CCommandPipe(command_);
 
+  // thread command reads pipe input directly
+  if (command_->isThread())
+    return;
+
   save_stdin_ = dup(0);
 
   if (save_stdin_ < 0)
@@ -52,6 +59,14 @@ term()
 {
 }
 
+void
+CCommandStringSrc::
+initThread(CCommandStdio &stdio)
+{
+  if (! stdio.setFd(0, pipe_->getInput()))
+    throwError(std::string("dup: ") + strerror(errno));
+}
+
 void
 CCommandStringSrc::
 process()
@@ -83,3 +98,13 @@ process()
       throwError(std::string("close: ") + strerror(errno));
   }
 }
+
+bool
+CCommandStringSrc::
+hashData(CCommandHash &hash) const
+{
+  hash.addString("string");
+  hash.addString(str_);
+
+  return true;
+}
@@ -0,0 +1,119 @@
+#include <CCommandTailDest.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+CCommandTailDest::
+CCommandTailDest(CCommand *command, std::string &str, size_t tailSize,
+                 size_t headSize, int dest_fd) :
+ CCommandStreamDest(command, dest_fd), str_(str), headSize_(headSize), tailSize_(tailSize)
+{
+}
+
+CCommandTailDest::
+~CCommandTailDest()
+{
+}
+
+size_t
+CCommandTailDest::
+getSkippedSize() const
+{
+  return totalSize_ - headLen_ - tailLen_;
+}
+
+std::string
+CCommandTailDest::
+getHead() const
+{
+  return std::string(head_.data(), headLen_);
+}
+
+std::string
+CCommandTailDest::
+getTail() const
+{
+  if (tailLen_ < tailSize_)
+    return std::string(tail_.data(), tailLen_);
+
+  // ring is full, oldest data starts at write position
+  std::string str(tail_.data() + tailPos_, tailSize_ - tailPos_);
+
+  str.append(tail_.data(), tailPos_);
+
+  return str;
+}
+
+void
+CCommandTailDest::
+initStream()
+{
+  head_.resize(headSize_);
+  tail_.resize(tailSize_);
+
+  headLen_   = 0;
+  tailPos_   = 0;
+  tailLen_   = 0;
+  totalSize_ = 0;
+}
+
+void
+CCommandTailDest::
+readStream(int fd)
+{
+  char discard[4096];
+
+  for (;;) {
+    // read directly into head buffer and then into the free space of the ring
+    char   *buffer;
+    size_t  len;
+
+    if      (headLen_ < headSize_) {
+      buffer = &head_[headLen_];
+      len    = headSize_ - headLen_;
+    }
+    else if (tailSize_ > 0) {
+      buffer = &tail_[tailPos_];
+      len    = tailSize_ - tailPos_;
+    }
+    else {
+      buffer = discard;
+      len    = sizeof(discard);
+    }
+
+    ssize_t len1 = ::read(fd, buffer, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    if (len1 < 0) {
+      setStreamError(std::string("read: ") + strerror(errno));
+      break;
+    }
+
+    if (len1 == 0)
+      break;
+
+    totalSize_ += size_t(len1);
+
+    if      (buffer == discard) {
+    }
+    else if (headLen_ < headSize_) {
+      headLen_ += size_t(len1);
+    }
+    else {
+      tailPos_ += size_t(len1);
+      tailLen_  = std::min(tailLen_ + size_t(len1), tailSize_);
+
+      if (tailPos_ == tailSize_)
+        tailPos_ = 0;
+    }
+  }
+}
+
+void
+CCommandTailDest::
+termStream()
+{
+  str_ = getHead() + getTail();
+}
@@ -0,0 +1,421 @@
+#include <CCommandTeeDest.h>
+#include <CCommandPipeDest.h>
+#include <CCommandPipe.h>
+#include <CCommandMgr.h>
+#include <CCommand.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t TEE_CHUNK_SIZE = 65536;
+
+}
+
+CCommandTeeDest::
+CCommandTeeDest(CCommand *command, int dest_fd) :
+ CCommandStreamDest(command, dest_fd)
+{
+}
+
+CCommandTeeDest::
+~CCommandTeeDest()
+{
+  for (auto *pipeDest : pipeDests_)
+    delete pipeDest;
+}
+
+void
+CCommandTeeDest::
+addPipe()
+{
+  if (CCommandMgrInst->getPipeDest() != nullptr) {
+    throwError("Pipe Destination already pending");
+    return;
+  }
+
+  // pipe dest is only used to create the pipe and hand it to the pipe source,
+  // it is not in the command's dest list so it is never redirected
+  auto *pipeDest = new CCommandPipeDest(command_);
+
+  pipeDests_.push_back(pipeDest);
+
+  CCommandMgrInst->setPipeDest(pipeDest);
+}
+
+void
+CCommandTeeDest::
+addFile(const std::string &filename, bool append)
+{
+  FileData file;
+
+  file.filename = filename;
+  file.append   = append;
+
+  files_.push_back(file);
+}
+
+void
+CCommandTeeDest::
+addString(std::string &str)
+{
+  strs_.push_back(&str);
+}
+
+void
+CCommandTeeDest::
+initStream()
+{
+  for (auto *pipeDest : pipeDests_)
+    pipeDest->initParent();
+
+  for (auto &file : files_) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (file.append ? O_APPEND : O_TRUNC);
+
+    file.fd = ::open(file.filename.c_str(), flags, 0666);
+
+    if (file.fd < 0)
+      throwError(std::string("open: ") + file.filename + " " + strerror(errno));
+  }
+}
+
+void
+CCommandTeeDest::
+initChildStream()
+{
+  // branch pipes are created after fork so nothing to close in the child
+}
+
+void
+CCommandTeeDest::
+readStream(int fd)
+{
+  Fds pipeFds;
+
+  for (auto *pipeDest : pipeDests_) {
+    auto *pipe = pipeDest->getPipe();
+
+    if (pipe && pipe->getOutput() != -1)
+      pipeFds.push_back(pipe->getOutput());
+  }
+
+  if (! spliceStream(fd, pipeFds))
+    copyStream(fd, pipeFds);
+
+  // close branch pipe outputs so pipe sources see EOF
+  for (auto *pipeDest : pipeDests_) {
+    auto *pipe = pipeDest->getPipe();
+
+    if (pipe)
+      pipe->closeOutput();
+  }
+
+  // all branches closed or write error so rest of output is not used, read
+  // it so command is not blocked writing to a full pipe
+  drainStream(fd);
+}
+
+bool
+CCommandTeeDest::
+spliceStream(int fd, const Fds &pipeFds)
+{
+#ifdef __linux__
+  // string branches need the data in user space
+  if (! strs_.empty() || files_.size() > 1)
+    return false;
+
+  // each chunk is tee'd to all but one branch and then moved (spliced) to the
+  // last branch (file or pipe) which consumes it from the command pipe
+  Fds teeFds = pipeFds;
+
+  int sinkFd = -1;
+
+  if (! files_.empty()) {
+    // splice does not support append mode files
+    if (files_[0].append)
+      return false;
+
+    sinkFd = files_[0].fd;
+  }
+  else {
+    if (teeFds.empty())
+      return false;
+
+    sinkFd = teeFds.back();
+
+    teeFds.pop_back();
+  }
+
+  // pipe branch readers may exit early (branch is dropped)
+  bool sinkPipe = files_.empty();
+
+  bool consumed = false;
+
+  std::vector<char> buffer;
+
+  for (;;) {
+    ssize_t len = 0;
+
+    // all branches closed (rest of output drained by caller)
+    if (sinkFd == -1)
+      break;
+
+    if (teeFds.empty()) {
+      len = ::splice(fd, nullptr, sinkFd, nullptr, TEE_CHUNK_SIZE, SPLICE_F_MOVE);
+
+      if (len < 0) {
+        if (errno == EINTR) continue;
+
+        // nothing consumed yet so can fall back to copy
+        if (errno == EINVAL && ! consumed)
+          return false;
+
+        if (errno == EPIPE && sinkPipe) {
+          sinkFd = -1;
+          continue;
+        }
+
+        setStreamError(std::string("splice: ") + strerror(errno));
+        return true;
+      }
+
+      if (len == 0)
+        break;
+
+      consumed = true;
+
+      continue;
+    }
+
+    // duplicate pending data into first branch pipe without consuming it
+    len = ::tee(fd, teeFds[0], TEE_CHUNK_SIZE, 0);
+
+    if (len < 0) {
+      if (errno == EINTR) continue;
+
+      if (errno == EINVAL && ! consumed)
+        return false;
+
+      // nothing consumed so just drop branch
+      if (errno == EPIPE) {
+        teeFds.erase(teeFds.begin());
+        continue;
+      }
+
+      setStreamError(std::string("tee: ") + strerror(errno));
+      return true;
+    }
+
+    if (len == 0)
+      break;
+
+    // if another branch pipe was too full to take the whole chunk the
+    // remainder is written from user space once the chunk is read
+    std::vector<std::pair<int, size_t>> partial;
+
+    Fds closed;
+
+    for (size_t i = 1; i < teeFds.size(); ++i) {
+      ssize_t len1;
+
+      while ((len1 = ::tee(fd, teeFds[i], size_t(len), 0)) < 0 && errno == EINTR)
+        ;
+
+      if      (len1 < 0 && errno == EPIPE)
+        closed.push_back(teeFds[i]);
+      else if (len1 < len)
+        partial.emplace_back(teeFds[i], size_t(len1 > 0 ? len1 : 0));
+    }
+
+    consumed = true;
+
+    size_t pos = 0;
+
+    bool sinkClosed = false;
+
+    if (partial.empty()) {
+      while (pos < size_t(len)) {
+        ssize_t len1 = ::splice(fd, nullptr, sinkFd, nullptr, size_t(len) - pos, SPLICE_F_MOVE);
+
+        if (len1 < 0 && errno == EINTR) continue;
+
+        if (len1 < 0 && errno == EPIPE && sinkPipe)
+          sinkClosed = true;
+
+        if (len1 <= 0)
+          break;
+
+        pos += size_t(len1);
+      }
+
+      if (pos == size_t(len)) {
+        removeFds(teeFds, closed);
+        continue;
+      }
+    }
+
+    // read rest of chunk and write it to partial branches and sink
+    buffer.resize(size_t(len));
+
+    size_t pos1 = pos;
+
+    while (pos1 < size_t(len)) {
+      ssize_t len1 = ::read(fd, &buffer[pos1], size_t(len) - pos1);
+
+      if (len1 < 0 && errno == EINTR) continue;
+
+      if (len1 <= 0) {
+        setStreamError(std::string("read: ") + strerror(errno));
+        return true;
+      }
+
+      pos1 += size_t(len1);
+    }
+
+    for (const auto &p : partial) {
+      if (! writeData(p.first, &buffer[p.second], size_t(len) - p.second, /*branch*/true)) {
+        if (errno != EPIPE)
+          return true;
+
+        closed.push_back(p.first);
+      }
+    }
+
+    if (! sinkClosed && ! writeData(sinkFd, &buffer[pos], size_t(len) - pos, sinkPipe)) {
+      if (errno != EPIPE)
+        return true;
+
+      sinkClosed = true;
+    }
+
+    removeFds(teeFds, closed);
+
+    // chunk has already been tee'd to the other branches so the next one
+    // becomes the sink from the next chunk
+    if (sinkClosed) {
+      if (! teeFds.empty()) {
+        sinkFd = teeFds.back();
+
+        teeFds.pop_back();
+      }
+      else
+        sinkFd = -1;
+    }
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+CCommandTeeDest::
+copyStream(int fd, Fds pipeFds)
+{
+  char buffer[TEE_CHUNK_SIZE];
+
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, sizeof(buffer));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len < 0) {
+      setStreamError(std::string("read: ") + strerror(errno));
+      return;
+    }
+
+    if (len == 0)
+      break;
+
+    for (auto p = pipeFds.begin(); p != pipeFds.end(); ) {
+      if (! writeData(*p, buffer, size_t(len), /*branch*/true)) {
+        if (errno != EPIPE)
+          return;
+
+        // branch reader has exited
+        p = pipeFds.erase(p);
+
+        continue;
+      }
+
+      ++p;
+    }
+
+    for (const auto &file : files_) {
+      if (! writeData(file.fd, buffer, size_t(len)))
+        return;
+    }
+
+    for (auto *str : strs_)
+      str->append(buffer, size_t(len));
+  }
+}
+
+bool
+CCommandTeeDest::
+writeData(int fd, const char *data, size_t len, bool branch)
+{
+  while (len > 0) {
+    ssize_t len1 = ::write(fd, data, len);
+
+    if (len1 < 0 && errno == EINTR) continue;
+
+    // closed branch pipe is not an error (caller drops it)
+    if (len1 < 0 && errno == EPIPE && branch)
+      return false;
+
+    if (len1 <= 0) {
+      setStreamError(std::string("write: ") + strerror(errno));
+      return false;
+    }
+
+    data += len1;
+    len  -= size_t(len1);
+  }
+
+  return true;
+}
+
+void
+CCommandTeeDest::
+drainStream(int fd)
+{
+  char buffer[TEE_CHUNK_SIZE];
+
+  for (;;) {
+    ssize_t len = ::read(fd, buffer, sizeof(buffer));
+
+    if (len < 0 && errno == EINTR) continue;
+
+    if (len <= 0)
+      break;
+  }
+}
+
+void
+CCommandTeeDest::
+removeFds(Fds &fds, const Fds &closed)
+{
+  for (const auto &fd : closed)
+    fds.erase(std::remove(fds.begin(), fds.end(), fd), fds.end());
+}
+
+void
+CCommandTeeDest::
+termStream()
+{
+  for (auto &file : files_) {
+    if (file.fd != -1) {
+      int error = ::close(file.fd);
+
+      if (error < 0)
+        throwError(std::string("close: ") + strerror(errno));
+
+      file.fd = -1;
+    }
+  }
+}
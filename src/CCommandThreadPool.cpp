@@ -0,0 +1,130 @@
+#include <CCommandThreadPool.h>
+#include <CCommandUtil.h>
+
+class CCommandThreadJob {
+ public:
+  CCommandThreadJob(CCommandThreadPool::Proc proc, void *data) :
+   proc_(proc), data_(data) {
+  }
+
+ private:
+  friend class CCommandThreadPool;
+
+  CCommandThreadPool::Proc proc_ { nullptr };
+  void*                    data_ { nullptr };
+  bool                     done_ { false };
+};
+
+//---
+
+CCommandThreadPool::
+CCommandThreadPool()
+{
+}
+
+CCommandThreadPool::
+~CCommandThreadPool()
+{
+  {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  stop_ = true;
+  }
+
+  jobCond_.notify_all();
+
+  for (auto &thread : threads_)
+    thread.join();
+}
+
+int
+CCommandThreadPool::
+getNumThreads() const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return int(threads_.size());
+}
+
+CCommandThreadJob *
+CCommandThreadPool::
+start(Proc proc, void *data)
+{
+  auto *job = new CCommandThreadJob(proc, data);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  jobs_.push_back(job);
+
+  // one idle thread per queued job (jobs can block waiting on each other)
+  if (int(jobs_.size()) > numIdle_ &&
+      (maxThreads_ <= 0 || int(threads_.size()) < maxThreads_)) {
+    // write errors are reported as EPIPE (like a command killed by SIGPIPE)
+    threads_.push_back(CCommandUtil::createThread(workerThread, this));
+  }
+
+  jobCond_.notify_one();
+
+  return job;
+}
+
+void
+CCommandThreadPool::
+wait(CCommandThreadJob *job)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  doneCond_.wait(lock, [&]() { return job->done_; });
+
+  lock.unlock();
+
+  delete job;
+}
+
+bool
+CCommandThreadPool::
+isDone(CCommandThreadJob *job) const
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  return job->done_;
+}
+
+void
+CCommandThreadPool::
+workerThread(CCommandThreadPool *pool)
+{
+  pool->worker();
+}
+
+void
+CCommandThreadPool::
+worker()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  for (;;) {
+    ++numIdle_;
+
+    jobCond_.wait(lock, [&]() { return stop_ || ! jobs_.empty(); });
+
+    --numIdle_;
+
+    if (jobs_.empty())
+      break;
+
+    auto *job = jobs_.front();
+
+    jobs_.pop_front();
+
+    lock.unlock();
+
+    job->proc_(job->data_);
+
+    lock.lock();
+
+    job->done_ = true;
+
+    doneCond_.notify_all();
+  }
+}
@@ -0,0 +1,1817 @@
+#include <CCommandMgr.h>
+#include <CCommandPipeline.h>
+#include <CCommandBufferSrc.h>
+#include <CCommandBuiltins.h>
+#include <CCommandCallbackDest.h>
+#include <CCommandCollector.h>
+#include <CCommandCompressDest.h>
+#include <CCommandGeneratorSrc.h>
+#include <CCommandHedger.h>
+#include <CCommandMapFileSrc.h>
+#include <CCommandMerge.h>
+#include <CCommandParser.h>
+#include <CCommandQueue.h>
+#include <CCommandResultCache.h>
+#include <CCommandScheduler.h>
+#include <CCommandShard.h>
+#include <CCommandStdio.h>
+#include <CCommandTailDest.h>
+#include <CCommandTeeDest.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+
+// Behavioural checks of the command library (run by 'make check'):
+//
+//   CCommandCheck [<check> ...]
+//
+// Runs the named checks (all if none) and returns non-zero if any fail.
+
+namespace {
+
+bool checkPipeline();
+bool checkReap();
+bool checkTee();
+bool checkCallback();
+bool checkTail();
+bool checkCompress();
+bool checkMapFile();
+bool checkBuffer();
+bool checkGenerator();
+bool checkSink();
+bool checkRange();
+bool checkShard();
+bool checkMerge();
+bool checkBuiltins();
+bool checkQueue();
+bool checkAsync();
+bool checkParser();
+bool checkMap();
+bool checkBatched();
+bool checkCollector();
+bool checkCache();
+bool checkShared();
+bool checkHedge();
+bool checkSched();
+
+struct Check {
+  const char *name;
+  bool      (*proc)();
+};
+
+Check checks[] = {
+  { "pipeline" , checkPipeline  },
+  { "reap"     , checkReap      },
+  { "tee"      , checkTee       },
+  { "callback" , checkCallback  },
+  { "tail"     , checkTail      },
+  { "compress" , checkCompress  },
+  { "mapfile"  , checkMapFile   },
+  { "buffer"   , checkBuffer    },
+  { "generator", checkGenerator },
+  { "sink"     , checkSink      },
+  { "range"    , checkRange     },
+  { "shard"    , checkShard     },
+  { "merge"    , checkMerge     },
+  { "builtins" , checkBuiltins  },
+  { "queue"    , checkQueue     },
+  { "async"    , checkAsync     },
+  { "parser"   , checkParser    },
+  { "map"      , checkMap       },
+  { "batched"  , checkBatched   },
+  { "collector", checkCollector },
+  { "cache"    , checkCache     },
+  { "shared"   , checkShared    },
+  { "hedge"    , checkHedge     },
+  { "sched"    , checkSched     },
+};
+
+bool
+runCheck(const Check &check)
+{
+  bool rc = false;
+
+  try {
+    rc = check.proc();
+  }
+  catch (...) {
+    std::cerr << check.name << ": exception" << std::endl;
+  }
+
+  std::cout << (rc ? "PASS " : "FAIL ") << check.name << std::endl;
+
+  return rc;
+}
+
+//---
+
+// pipeline stages reaped by the SIGCHLD handler on another thread must still
+// have their output captured and their end time set by wait
+bool
+checkPipeline()
+{
+  // SIGCHLD is delivered to this thread while the pipeline waits (main
+  // thread blocks it)
+  std::atomic<bool> done { false };
+
+  std::thread thread([&]() { while (! done) usleep(1000); });
+
+  bool rc = true;
+
+  for (int i = 0; i < 200 && rc; ++i) {
+    CCommandPipeline pipeline;
+
+    pipeline.addStage("seq", "seq", CCommand::Args({"1", "1000"}));
+
+    auto *cat = pipeline.addStage("cat", "cat");
+
+    std::string tail;
+
+    cat->addTailDest(tail, 5);
+
+    pipeline.start();
+    pipeline.wait ();
+
+    if (tail != "1000\n") {
+      std::cerr << "pipeline: bad output '" << tail << "'" << std::endl;
+      rc = false;
+    }
+
+    for (const auto &result : pipeline.getResults()) {
+      if (result.returnCode != 0 || result.endTime < result.startTime ||
+          result.endTime == CCommandResult::TimePoint()) {
+        std::cerr << "pipeline: bad result (rc " << result.returnCode << ")" << std::endl;
+        rc = false;
+      }
+    }
+  }
+
+  done = true;
+
+  thread.join();
+
+  return rc;
+}
+
+// commands started and waited on several threads (each of which may run
+// the SIGCHLD handler) must all get their exit status
+bool
+checkReap()
+{
+  std::atomic<int> bad { 0 };
+
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 200; ++i) {
+        CCommand command((i & 1 ? "false" : "true"), (i & 1 ? "false" : "true"));
+
+        // run process (not builtin)
+        command.setAllowBuiltin(false);
+
+        command.start();
+        command.wait ();
+
+        if (command.getReturnCode() != (i & 1))
+          ++bad;
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  if (bad > 0)
+    std::cerr << "reap: " << bad << " bad return codes" << std::endl;
+
+  return (bad == 0);
+}
+
+// output of 'seq 1 <n>'
+std::string
+seqOutput(int n)
+{
+  std::string str;
+
+  for (int i = 1; i <= n; ++i)
+    str += std::to_string(i) + "\n";
+
+  return str;
+}
+
+// file contents
+std::string
+readFile(const std::string &filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// tee output is copied to all branches, and a failed branch (write error)
+// does not stop the command (rest of its output is drained)
+bool
+checkTee()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/tee";
+
+  bool rc = true;
+
+  {
+  CCommand seq("seq", "seq", CCommand::Args({"1", "10000"}));
+
+  auto *tee = seq.addTeeDest();
+
+  std::string str, output;
+
+  tee->addFile  (filename);
+  tee->addString(str);
+  tee->addPipe  ();
+
+  CCommand cat("cat", "cat");
+
+  cat.addPipeSrc();
+  cat.addStringDest(output);
+
+  seq.start();
+  cat.start();
+
+  seq.wait();
+  cat.wait();
+
+  if (str != seqOutput(10000) || readFile(filename) != str || output != str) {
+    std::cerr << "tee: branch output differs" << std::endl;
+    rc = false;
+  }
+  }
+
+  // file only (splice) and file and string (copy) branch on full device
+  for (int withString = 0; withString < 2; ++withString) {
+    CCommand command("seq", "seq", CCommand::Args({"1", "2000000"}));
+
+    auto *tee = command.addTeeDest();
+
+    std::string str;
+
+    tee->addFile("/dev/full");
+
+    if (withString)
+      tee->addString(str);
+
+    command.start();
+    command.wait ();
+
+    if (command.getReturnCode() != 0) {
+      std::cerr << "tee: command failed after write error (rc " <<
+                   command.getReturnCode() << ")" << std::endl;
+      rc = false;
+    }
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// callback dest gets all output as chunks (of at most chunk size) or as
+// lines without newlines, with long lines split at max line length
+bool
+checkCallback()
+{
+  struct Data {
+    std::string   str;
+    StringVectorT lines;
+    size_t        maxLen { 0 };
+  };
+
+  auto chunkProc = [](const char *buffer, size_t len, CCommand::CallbackData data) {
+    auto *d = static_cast<Data *>(data);
+
+    d->str.append(buffer, len);
+
+    d->maxLen = std::max(d->maxLen, len);
+  };
+
+  auto lineProc = [](const char *buffer, size_t len, CCommand::CallbackData data) {
+    auto *d = static_cast<Data *>(data);
+
+    d->lines.push_back(std::string(buffer, len));
+  };
+
+  bool rc = true;
+
+  Data chunkData;
+
+  CCommand seq("seq", "seq", CCommand::Args({"1", "100000"}));
+
+  auto *dest = seq.addCallbackDest(chunkProc, &chunkData);
+
+  dest->setChunkSize(1000);
+
+  seq.start();
+  seq.wait ();
+
+  if (chunkData.str != seqOutput(100000) || chunkData.maxLen > 1000) {
+    std::cerr << "callback: bad chunks" << std::endl;
+    rc = false;
+  }
+
+  // last line has no newline, long line is split
+  Data lineData;
+
+  CCommand sh("sh", "sh", CCommand::Args({"-c", "seq 1 3; printf '%0100d\\n' 0; printf end"}));
+
+  auto *lineDest = sh.addCallbackDest(lineProc, &lineData, /*lines*/true);
+
+  lineDest->setMaxLineLen(60);
+
+  sh.start();
+  sh.wait ();
+
+  if (lineData.lines != StringVectorT({"1", "2", "3", std::string(60, '0'),
+                                       std::string(40, '0'), "end"})) {
+    std::cerr << "callback: bad lines" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// tail dest keeps first and last bytes of output (string is set)
+bool
+checkTail()
+{
+  bool rc = true;
+
+  std::string output = seqOutput(100000);
+
+  std::string str("old");
+
+  CCommand seq("seq", "seq", CCommand::Args({"1", "100000"}));
+
+  auto *dest = seq.addTailDest(str, 100, 50);
+
+  seq.start();
+  seq.wait ();
+
+  if (str != output.substr(0, 50) + output.substr(output.size() - 100) ||
+      dest->getTotalSize() != output.size() ||
+      dest->getSkippedSize() != output.size() - 150 || ! dest->isTruncated()) {
+    std::cerr << "tail: bad head/tail '" << str << "'" << std::endl;
+    rc = false;
+  }
+
+  // output shorter than head (nothing skipped)
+  CCommand seq1("seq", "seq", CCommand::Args({"1", "3"}));
+
+  auto *dest1 = seq1.addTailDest(str, 100, 50);
+
+  seq1.start();
+  seq1.wait ();
+
+  if (str != "1\n2\n3\n" || dest1->isTruncated()) {
+    std::cerr << "tail: bad short output '" << str << "'" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// compressed output decompresses to command output, and a write error
+// does not stop the command (rest of its output is drained)
+bool
+checkCompress()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/seq.gz";
+
+  bool rc = true;
+
+  CCommand seq("seq", "seq", CCommand::Args({"1", "100000"}));
+
+  auto *dest = seq.addCompressFileDest(filename);
+
+  dest->setBlockSize(1000);
+
+  seq.start();
+  seq.wait ();
+
+  CCommand gzip("gzip", "gzip", CCommand::Args({"-dc", filename}));
+
+  std::string output;
+
+  gzip.addStringDest(output);
+
+  gzip.start();
+  gzip.wait ();
+
+  if (output != seqOutput(100000) || dest->getInputSize() != output.size() ||
+      dest->getOutputSize() == 0 || dest->getOutputSize() >= output.size()) {
+    std::cerr << "compress: bad round trip" << std::endl;
+    rc = false;
+  }
+
+  CCommand seq1("seq", "seq", CCommand::Args({"1", "2000000"}));
+
+  seq1.addCompressFileDest("/dev/full");
+
+  seq1.start();
+  seq1.wait ();
+
+  if (seq1.getReturnCode() != 0) {
+    std::cerr << "compress: command failed after write error (rc " <<
+                 seq1.getReturnCode() << ")" << std::endl;
+    rc = false;
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// callback command reads mapped file source directly, exec'd command gets
+// the file on stdin
+bool
+checkMapFile()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/in";
+
+  auto data = seqOutput(100000);
+
+  {
+  std::ofstream file(filename, std::ios::binary);
+
+  file << data;
+  }
+
+  bool rc = true;
+
+  auto callbackProc = [](const CCommand::Args &, CCommand::CallbackData data) {
+    auto *src = CCommandMapFileSrc::current();
+
+    if (src)
+      static_cast<std::string *>(data)->assign(src->getData(), src->getSize());
+  };
+
+  std::string str;
+
+  CCommand callback("callback", callbackProc, &str);
+
+  callback.addMapFileSrc(filename);
+
+  callback.start();
+  callback.wait ();
+
+  if (str != data || CCommandMapFileSrc::current()) {
+    std::cerr << "mapfile: bad callback data" << std::endl;
+    rc = false;
+  }
+
+  CCommand wc("wc", "wc", CCommand::Args({"-c"}));
+
+  wc.setAllowBuiltin(false);
+
+  wc.addMapFileSrc(filename);
+
+  std::string output;
+
+  wc.addStringDest(output);
+
+  wc.start();
+  wc.wait ();
+
+  if (output != std::to_string(data.size()) + "\n") {
+    std::cerr << "mapfile: bad stdin '" << output << "'" << std::endl;
+    rc = false;
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// buffer source larger than the pipe must not block start before the
+// reader has started (vmsplice and writev)
+bool
+checkBuffer()
+{
+  std::string data;
+
+  for (int i = 0; i < 200000; ++i)
+    data += "record " + std::to_string(i) + "\n";
+
+  bool rc = true;
+
+  for (int useSplice = 0; useSplice < 2; ++useSplice) {
+    CCommandPipeline pipeline;
+
+    auto *cat = pipeline.addStage("cat", "cat");
+
+    auto *src = cat->addBufferSrc();
+
+    src->setUseSplice(useSplice);
+    src->addBuffer(data);
+
+    auto *wc = pipeline.addStage("wc", "wc", CCommand::Args({"-c"}));
+
+    std::string output;
+
+    wc->addStringDest(output);
+
+    pipeline.start();
+    pipeline.wait ();
+
+    if (std::stol(output) != long(data.size())) {
+      std::cerr << "buffer: bad output '" << output << "'" << std::endl;
+      rc = false;
+    }
+  }
+
+  return rc;
+}
+
+// generator data is written to stdin until it ends, an unbounded generator
+// is stopped when the command closes stdin
+bool
+checkGenerator()
+{
+  struct Data {
+    int n    { 0 };
+    int last { 0 };
+  };
+
+  auto seqProc = [](char *buffer, size_t size, CCommand::CallbackData data) {
+    auto *d = static_cast<Data *>(data);
+
+    size_t len = 0;
+
+    while (d->n < d->last) {
+      auto line = std::to_string(d->n + 1) + "\n";
+
+      if (len + line.size() > size)
+        break;
+
+      memcpy(&buffer[len], line.data(), line.size());
+
+      len += line.size();
+
+      ++d->n;
+    }
+
+    return len;
+  };
+
+  auto yesProc = [](char *buffer, size_t size, CCommand::CallbackData) {
+    memset(buffer, 'y', size);
+
+    return size;
+  };
+
+  bool rc = true;
+
+  Data data;
+
+  data.last = 100000;
+
+  CCommand cat("cat", "cat");
+
+  cat.setAllowBuiltin(false);
+
+  auto *src = cat.addGeneratorSrc(seqProc, &data);
+
+  src->setChunkSize(1000);
+
+  std::string output;
+
+  cat.addStringDest(output);
+
+  cat.start();
+  cat.wait ();
+
+  if (output != seqOutput(100000) || src->getNumWritten() != output.size()) {
+    std::cerr << "generator: bad output" << std::endl;
+    rc = false;
+  }
+
+  CCommand head("head", "head", CCommand::Args({"-c", "1000"}));
+
+  head.setAllowBuiltin(false);
+
+  head.addGeneratorSrc(yesProc, nullptr);
+
+  std::string headOutput;
+
+  head.addStringDest(headOutput);
+
+  head.start();
+  head.wait ();
+
+  if (headOutput != std::string(1000, 'y') || head.getReturnCode() != 0) {
+    std::cerr << "generator: bad unbounded output" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// sink mode file is replaced only when the command succeeds, commands
+// writing the same file concurrently each replace it whole
+bool
+checkSink()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/out";
+
+  bool rc = true;
+
+  auto runSeq = [&](const std::string &last, bool fail) {
+    CCommand command("sh", "sh", CCommand::Args({"-c",
+      "seq 1 " + last + (fail ? "; exit 1" : "")}));
+
+    command.addFileDest(filename);
+
+    command.setFileDestSinkMode(true, 4096);
+
+    command.start();
+    command.wait ();
+  };
+
+  runSeq("1000", false);
+
+  bool ok = (readFile(filename) == seqOutput(1000));
+
+  // failed command leaves file unchanged
+  runSeq("10", true);
+
+  ok = ok && (readFile(filename) == seqOutput(1000));
+
+  if (! ok) {
+    std::cerr << "sink: bad file contents" << std::endl;
+    rc = false;
+  }
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back([&, i]() { runSeq(std::to_string(10000 + i), false); });
+
+  for (auto &thread : threads)
+    thread.join();
+
+  auto str = readFile(filename);
+
+  ok = false;
+
+  for (int i = 0; i < 8; ++i)
+    if (str == seqOutput(10000 + i))
+      ok = true;
+
+  // no temporary files left
+  std::string lsCmd = std::string("test $(ls ") + dir + " | wc -l) -eq 1";
+
+  if (! ok || system(lsCmd.c_str()) != 0) {
+    std::cerr << "sink: bad concurrent file contents" << std::endl;
+    rc = false;
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// file ranges are moved to record boundaries, so parts of a file run in
+// parallel together have every record once (in part order)
+bool
+checkRange()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/in";
+
+  auto data = seqOutput(100000);
+
+  {
+  std::ofstream file(filename, std::ios::binary);
+
+  file << data;
+  }
+
+  bool rc = true;
+
+  // range starting and ending mid record ("1001\n" is at offset 3893)
+  CCommand cat("cat", "cat");
+
+  cat.addRangeFileSrc(filename, 3890, 3900);
+
+  std::string output;
+
+  cat.addStringDest(output);
+
+  cat.start();
+  cat.wait ();
+
+  if (output != "1001\n1002\n") {
+    std::cerr << "range: bad aligned range '" << output << "'" << std::endl;
+    rc = false;
+  }
+
+  StringVectorT outputs;
+
+  if (! CCommandMgrInst->execFileParts("cat", CCommand::Args(), filename, 7, outputs) ||
+      outputs.size() != 7 || std::accumulate(outputs.begin(), outputs.end(),
+                                             std::string()) != data) {
+    std::cerr << "range: bad file parts" << std::endl;
+    rc = false;
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// sharded stage output has every worker output record (in input order if
+// kept), workers are started by the stage in this process
+bool
+checkShard()
+{
+  bool rc = true;
+
+  std::string expected;
+
+  for (int i = 1; i <= 100000; ++i)
+    expected += std::to_string(2*i) + "\n";
+
+  for (int keepOrder = 0; keepOrder < 2; ++keepOrder) {
+    CCommand seq("seq", "seq", CCommand::Args({"1", "100000"}));
+
+    seq.addPipeDest();
+
+    CCommandShard shard("awk", "awk", CCommand::Args({"{ print $1*2 }"}), 4, keepOrder);
+
+    shard.setBlockSize(10000);
+
+    shard.addPipeSrc();
+
+    std::string output;
+
+    shard.addStringDest(output);
+
+    seq  .start();
+    shard.start();
+
+    seq  .wait();
+    shard.wait();
+
+    // unordered output has same lines
+    if (! keepOrder) {
+      std::vector<long> values;
+
+      std::istringstream stream(output);
+
+      long value;
+
+      while (stream >> value)
+        values.push_back(value);
+
+      std::sort(values.begin(), values.end());
+
+      output.clear();
+
+      for (auto v : values)
+        output += std::to_string(v) + "\n";
+    }
+
+    if (output != expected || shard.getReturnCode() != 0) {
+      std::cerr << "shard: bad output (keep order " << keepOrder << ")" << std::endl;
+      rc = false;
+    }
+  }
+
+  return rc;
+}
+
+// merged output of sorted inputs is sorted (numeric or by key field)
+bool
+checkMerge()
+{
+  bool rc = true;
+
+  // forked merge (output larger than pipe)
+  {
+  std::vector<CCommand *> inputs;
+
+  CCommandMerge merge("merge", /*doFork*/true);
+
+  merge.setNumeric(true);
+
+  for (int i = 1; i <= 3; ++i) {
+    auto *seq = new CCommand("seq", "seq", CCommand::Args({std::to_string(i), "3", "100000"}));
+
+    merge.addInput(seq);
+
+    inputs.push_back(seq);
+  }
+
+  std::string output;
+
+  merge.addStringDest(output);
+
+  for (auto *seq : inputs)
+    seq->start();
+
+  merge.start();
+
+  for (auto *seq : inputs)
+    seq->wait();
+
+  merge.wait();
+
+  for (auto *seq : inputs)
+    delete seq;
+
+  if (output != seqOutput(100000)) {
+    std::cerr << "merge: bad numeric merge" << std::endl;
+    rc = false;
+  }
+  }
+
+  // in process merge on second field, reversed
+  {
+  CCommand input1("printf", "printf", CCommand::Args({"a\\t3\\nb\\t1\\n"}));
+  CCommand input2("printf", "printf", CCommand::Args({"c\\t4\\nd\\t2\\n"}));
+
+  CCommandMerge merge;
+
+  merge.setKeyField(2);
+  merge.setReverse(true);
+
+  merge.addInput(&input1);
+  merge.addInput(&input2);
+
+  std::string output;
+
+  merge.addStringDest(output);
+
+  input1.start();
+  input2.start();
+
+  input1.wait();
+  input2.wait();
+
+  merge.start();
+  merge.wait ();
+
+  if (output != "c\t4\na\t3\nd\t2\nb\t1\n") {
+    std::cerr << "merge: bad key merge '" << output << "'" << std::endl;
+    rc = false;
+  }
+  }
+
+  return rc;
+}
+
+// builtins give the same output as the commands they replace, unsupported
+// args run the real command
+bool
+checkBuiltins()
+{
+  auto input = seqOutput(100000);
+
+  auto runCommand = [&](const CCommand::Args &args, bool allowBuiltin, bool &isThread) {
+    CCommand command(args[0], args[0], CCommand::Args(args.begin() + 1, args.end()));
+
+    command.setAllowBuiltin(allowBuiltin);
+
+    command.addStringSrc(input);
+
+    std::string output;
+
+    command.addStringDest(output);
+
+    command.start();
+    command.wait ();
+
+    isThread = command.isThread();
+
+    return output + "rc=" + std::to_string(command.getReturnCode());
+  };
+
+  CCommandMgrInst->addStdBuiltins();
+
+  bool rc = true;
+
+  std::vector<CCommand::Args> argsList = {
+    {"cat"}, {"head", "-n", "5"}, {"head", "-c", "10"}, {"tail", "-n", "5"},
+    {"tail", "-n", "+99995"}, {"wc", "-l"}, {"wc"}, {"grep", "-F", "999"},
+    {"grep", "-F", "-v", "-c", "9"}, {"grep", "-F", "-q", "none"}, {"cat", "-n"}};
+
+  for (const auto &args : argsList) {
+    bool isBuiltin, isThread;
+
+    auto output1 = runCommand(args, true , isBuiltin);
+    auto output2 = runCommand(args, false, isThread);
+
+    bool supported = (args != CCommand::Args({"cat", "-n"}));
+
+    if (output1 != output2 || isBuiltin != supported || isThread) {
+      std::cerr << "builtins: bad output for " << args[0] << " " <<
+                   (args.size() > 1 ? args[1] : "") << std::endl;
+      rc = false;
+    }
+  }
+
+  for (const auto &name : {"cat", "head", "tail", "wc", "tee", "grep"})
+    CCommandMgrInst->removeBuiltin(name);
+
+  return rc;
+}
+
+// queue passes all data between threads, piped thread commands are connected
+// by a queue (or pipe if disabled) with the same output
+bool
+checkQueue()
+{
+  bool rc = true;
+
+  {
+  CCommandQueue queue(4096);
+
+  std::string data = seqOutput(100000), output;
+
+  std::thread writer([&]() {
+    for (size_t pos = 0; pos < data.size(); pos += 1000)
+      queue.write(&data[pos], std::min(size_t(1000), data.size() - pos));
+
+    queue.closeWrite();
+  });
+
+  char buffer[777];
+
+  ssize_t len;
+
+  while ((len = queue.read(buffer, sizeof(buffer))) > 0)
+    output.append(buffer, size_t(len));
+
+  writer.join();
+
+  if (output != data) {
+    std::cerr << "queue: bad queue data" << std::endl;
+    rc = false;
+  }
+
+  // write fails once reader has closed
+  queue.closeRead();
+
+  if (queue.write("x", 1)) {
+    std::cerr << "queue: write after reader closed" << std::endl;
+    rc = false;
+  }
+  }
+
+  auto seqProc = [](const CCommand::Args &, CCommandStdio &stdio, CCommand::CallbackData) {
+    for (int i = 1; i <= 100000; ++i)
+      stdio.write(std::to_string(i) + "\n");
+
+    return 0;
+  };
+
+  auto catProc = [](const CCommand::Args &, CCommandStdio &stdio, CCommand::CallbackData data) {
+    *static_cast<bool *>(data) = (stdio.getFd(0) < 0);
+
+    std::string line;
+
+    while (stdio.readLine(line))
+      stdio.write(line + "\n");
+
+    return 0;
+  };
+
+  for (int useQueues = 0; useQueues < 2; ++useQueues) {
+    CCommandMgrInst->setUseQueues(useQueues);
+
+    bool queued = false;
+
+    CCommand seq("seq", seqProc, nullptr);
+    CCommand cat("cat", catProc, &queued);
+
+    seq.addPipeDest();
+    cat.addPipeSrc ();
+
+    std::string output;
+
+    cat.addStringDest(output);
+
+    seq.start();
+    cat.start();
+
+    seq.wait();
+    cat.wait();
+
+    if (output != seqOutput(100000) || queued != bool(useQueues)) {
+      std::cerr << "queue: bad thread command output (queues " << useQueues << ")" << std::endl;
+      rc = false;
+    }
+  }
+
+  return rc;
+}
+
+// async commands (process and thread) complete their futures with exit
+// status, captured output and times
+bool
+checkAsync()
+{
+  bool rc = true;
+
+  std::vector<CCommand *> commands;
+
+  std::vector<std::future<CCommandResult>> futures;
+
+  for (int i = 0; i < 50; ++i) {
+    auto job = std::to_string(i);
+
+    auto *command = new CCommand("sh", "sh", CCommand::Args({"-c",
+      "echo out" + job + "; echo err" + job + " >&2; exit " + std::to_string(i % 3)}));
+
+    futures.push_back(command->startAsync(/*captureOutput*/true, /*captureError*/true));
+
+    commands.push_back(command);
+  }
+
+  for (int i = 0; i < 50; ++i) {
+    auto result = futures[size_t(i)].get();
+
+    auto job = std::to_string(i);
+
+    if (result.returnCode != i % 3 || result.output != "out" + job + "\n" ||
+        result.error != "err" + job + "\n" || result.endTime < result.startTime) {
+      std::cerr << "async: bad result for job " << i << std::endl;
+      rc = false;
+    }
+
+    delete commands[size_t(i)];
+  }
+
+  // signalled command
+  CCommand kill("sh", "sh", CCommand::Args({"-c", "kill -9 $$"}));
+
+  auto killResult = kill.startAsync().get();
+
+  if (killResult.signalNum != SIGKILL || killResult.returnCode != -1) {
+    std::cerr << "async: bad signalled result" << std::endl;
+    rc = false;
+  }
+
+  // thread command
+  auto threadProc = [](const CCommand::Args &, CCommandStdio &stdio, CCommand::CallbackData) {
+    stdio.write("thread\n");
+
+    return 3;
+  };
+
+  CCommand thread("thread", threadProc, nullptr);
+
+  auto threadResult = thread.startAsync(/*captureOutput*/true).get();
+
+  if (threadResult.returnCode != 3 || threadResult.output != "thread\n") {
+    std::cerr << "async: bad thread command result" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// command lines are split into stages with quoting and redirects, lines
+// are cached (least recently used dropped) and run with their redirects
+bool
+checkParser()
+{
+  bool rc = true;
+
+  CCommandParser parser(2);
+
+  std::string error;
+
+  auto line = parser.compile("grep -v 'a b' \"c \\\"d\\\" $x\" e\\ f < in > out 2>> err | "
+                             "sort |& cat -n # comment", error);
+
+  using Args = CCommand::Args;
+
+  if (! line || line->getNumStages() != 3) {
+    std::cerr << "parser: bad stages " << error << std::endl;
+    return false;
+  }
+
+  const auto &stage1 = line->getStage(0);
+  const auto &stage3 = line->getStage(2);
+
+  if (stage1.name != "grep" || stage1.args != Args({"-v", "a b", "c \"d\" $x", "e f"}) ||
+      stage1.inputs != StringVectorT({"in"}) || stage1.outputs.size() != 2 ||
+      stage1.outputs[0].file != "out" || stage1.outputs[0].fd != 1 ||
+      stage1.outputs[0].append || stage1.outputs[1].file != "err" ||
+      stage1.outputs[1].fd != 2 || ! stage1.outputs[1].append) {
+    std::cerr << "parser: bad quoting or redirects" << std::endl;
+    rc = false;
+  }
+
+  if (stage3.name != "cat" || stage3.args != Args({"-n"}) || ! stage3.pipeError) {
+    std::cerr << "parser: bad pipe stage" << std::endl;
+    rc = false;
+  }
+
+  for (const auto &str : {"echo 'x", "| cat", "cat >"}) {
+    if (parser.compile(str, error) || error == "") {
+      std::cerr << "parser: no error for '" << str << "'" << std::endl;
+      rc = false;
+    }
+  }
+
+  // cache of two lines (b is least recently used when c is added)
+  parser.clearCache();
+
+  auto a1 = parser.compile("echo a", error);
+  auto b1 = parser.compile("echo b", error);
+  auto a2 = parser.compile("echo a", error);
+  auto c1 = parser.compile("echo c", error);
+  auto a3 = parser.compile("echo a", error);
+  auto b2 = parser.compile("echo b", error);
+
+  if (a1 != a2 || a1 != a3 || b1 == b2 || parser.getNumHits() != 2) {
+    std::cerr << "parser: bad cache" << std::endl;
+    rc = false;
+  }
+
+  // run line with pipe and redirects
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string outFile = std::string(dir) + "/out";
+  std::string errFile = std::string(dir) + "/err";
+
+  if (! CCommandMgrInst->execCommand("sh -c 'seq 1 5; echo error >&2' 2> " + errFile +
+                                     " | wc -l > " + outFile) ||
+      readFile(outFile) != "5\n" || readFile(errFile) != "error\n") {
+    std::cerr << "parser: bad exec output" << std::endl;
+    rc = false;
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// map results are in input order with input substituted (or appended), at
+// most numJobs commands are run at once
+bool
+checkMap()
+{
+  bool rc = true;
+
+  StringVectorT inputs;
+
+  for (int i = 0; i < 40; ++i)
+    inputs.push_back(std::to_string(i));
+
+  std::vector<CCommandResult> results;
+
+  // later inputs finish first
+  if (! CCommandMgrInst->mapParallel(CCommand::Args({"sh", "-c",
+        "sleep 0.0$(( (40 - {}) % 4 )); echo in {}"}), inputs, 8, results) ||
+      results.size() != 40) {
+    std::cerr << "map: failed" << std::endl;
+    return false;
+  }
+
+  for (int i = 0; i < 40; ++i) {
+    if (results[size_t(i)].output != "in " + inputs[size_t(i)] + "\n") {
+      std::cerr << "map: bad output for input " << i << std::endl;
+      rc = false;
+    }
+  }
+
+  // input appended, failed command
+  if (CCommandMgrInst->mapParallel(CCommand::Args({"test", "2", "-gt"}),
+        StringVectorT({"1", "3"}), 0, results) ||
+      results[0].returnCode != 0 || results[1].returnCode != 1) {
+    std::cerr << "map: bad appended input results" << std::endl;
+    rc = false;
+  }
+
+  // four 0.2s commands two at a time
+  auto startTime = CCommandResult::Clock::now();
+
+  CCommandMgrInst->mapParallel(CCommand::Args({"sleep", "0.2"}),
+    StringVectorT({"0", "0", "0", "0"}), 2, results);
+
+  double elapsed = std::chrono::duration<double>(CCommandResult::Clock::now() - startTime).count();
+
+  if (elapsed < 0.4) {
+    std::cerr << "map: too many jobs run at once (" << elapsed << "s)" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// args too large for one exec are split into batches which each fit, run
+// output is in arg order
+bool
+checkBatched()
+{
+  bool rc = true;
+
+  // enough args for at least two batches (each arg uses its string and pointer)
+  auto maxSize = CCommandMgr::getMaxArgSize();
+
+  StringVectorT args;
+
+  std::string expected;
+
+  for (size_t i = 0, size = 0; size < 2*maxSize; ++i) {
+    auto arg = "arg" + std::to_string(i);
+
+    args.push_back(arg);
+
+    expected += arg + "\n";
+
+    size += arg.size() + 1 + sizeof(char *);
+  }
+
+  CCommand::Args templ({"printf", "%s\\n"});
+
+  std::vector<CCommand::Args> batches;
+
+  CCommandMgr::batchArgs(templ, args, 4096, batches);
+
+  StringVectorT batchedArgs;
+
+  for (const auto &batch : batches) {
+    size_t size = sizeof(char *);
+
+    for (const auto &arg : batch)
+      size += arg.size() + 1 + sizeof(char *);
+
+    if (size > 4096 || CCommand::Args(batch.begin(), batch.begin() + 2) != templ)
+      rc = false;
+
+    batchedArgs.insert(batchedArgs.end(), batch.begin() + 2, batch.end());
+  }
+
+  if (! rc || batchedArgs != args) {
+    std::cerr << "batched: bad batches" << std::endl;
+    rc = false;
+  }
+
+  std::string output;
+
+  std::vector<CCommandResult> results;
+
+  if (! CCommandMgrInst->execBatched(templ, args, 0, output, &results) ||
+      results.size() < 3 || output != expected) {
+    std::cerr << "batched: bad output (" << results.size() << " batches)" << std::endl;
+    rc = false;
+  }
+
+  // nothing run for no args
+  if (! CCommandMgrInst->execBatched(templ, StringVectorT(), 0, output, &results) ||
+      ! results.empty() || output != "") {
+    std::cerr << "batched: command run for no args" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// collected command outputs are written as whole blocks (in submission
+// order if requested), including outputs spilled to disk
+bool
+checkCollector()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string filename = std::string(dir) + "/out";
+
+  bool rc = true;
+
+  using Order = CCommandCollector::Order;
+
+  for (auto order : {Order::SUBMISSION, Order::COMPLETION}) {
+    FILE *fp = fopen(filename.c_str(), "w");
+
+    if (! fp)
+      return false;
+
+    size_t numSpilled = 0;
+
+    {
+    CCommandCollector collector(fileno(fp), order);
+
+    collector.setMemoryLimit(10000);
+
+    // commands finish in different order to submission
+    std::vector<CCommand *> commands;
+
+    for (int i = 0; i < 20; ++i) {
+      auto job = std::to_string(i);
+
+      auto *command = new CCommand("sh", "sh", CCommand::Args({"-c",
+        "for j in 1 2 3; do echo job" + job + "; seq 1 500; sleep 0.0" +
+        std::to_string((i*7) % 10) + "; done"}));
+
+      collector.addCommand(command);
+
+      commands.push_back(command);
+    }
+
+    for (auto *command : commands)
+      command->start();
+
+    for (auto *command : commands) {
+      command->wait();
+
+      delete command;
+    }
+
+    numSpilled = collector.getNumSpilled();
+    }
+
+    fclose(fp);
+
+    // each job's lines are together
+    std::vector<int> jobs;
+
+    std::ifstream file(filename);
+
+    std::string line;
+
+    int numLines = 0;
+
+    while (std::getline(file, line)) {
+      ++numLines;
+
+      if (line.compare(0, 3, "job") != 0)
+        continue;
+
+      int job = std::stoi(line.substr(3));
+
+      if (jobs.empty() || jobs.back() != job)
+        jobs.push_back(job);
+    }
+
+    bool sorted = std::is_sorted(jobs.begin(), jobs.end());
+
+    if (jobs.size() != 20 || numLines != 20*3*501 || numSpilled == 0 ||
+        (order == Order::SUBMISSION && ! sorted)) {
+      std::cerr << "collector: bad output (" << jobs.size() << " blocks, " <<
+                   numLines << " lines, " << numSpilled << " spilled)" << std::endl;
+      rc = false;
+    }
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// repeated command is returned from the result cache, least recently used
+// results are evicted and a corrupt result file is a miss
+bool
+checkCache()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  bool rc = true;
+
+  {
+  CCommandResultCache cache(std::string(dir) + "/cache", 2048);
+
+  CCommand::Args args({"-c", "date +%s%N"});
+
+  CCommand command1("sh", "sh", args);
+  CCommand command2("sh", "sh", args);
+
+  CCommandResult result1, result2;
+
+  if (cache.run(&command1, result1) || ! cache.run(&command2, result2) ||
+      result1.output != result2.output || result2.returnCode != 0 ||
+      cache.getNumHits() != 1) {
+    std::cerr << "cache: repeated command not cached" << std::endl;
+    rc = false;
+  }
+
+  // fill cache so first results are evicted (about 50 bytes each)
+  CCommandResultCache::Key key1, key2;
+
+  for (int i = 0; i < 100; ++i) {
+    CCommand command("sh", "sh", CCommand::Args({"-c", "echo " + std::to_string(i)}));
+
+    // key of command before it is run (capture adds dests)
+    if      (i == 0)
+      cache.getKey(&command, key1);
+    else if (i == 99)
+      cache.getKey(&command, key2);
+
+    CCommandResult result;
+
+    cache.run(&command, result);
+  }
+
+  CCommandResult result;
+
+  if (cache.getSize() > 2048 || cache.lookup(key1, result) ||
+      ! cache.lookup(key2, result) || result.output != "99\n") {
+    std::cerr << "cache: least recently used results not evicted" << std::endl;
+    rc = false;
+  }
+
+  // overwrite result lengths (after magic) with huge values
+  std::string filename = std::string(dir) + "/cache/data/" + key2.toString();
+
+  {
+  std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+
+  file.seekp(8);
+
+  std::string garbage(24, '\xff');
+
+  file.write(garbage.data(), std::streamsize(garbage.size()));
+  }
+
+  if (cache.lookup(key2, result)) {
+    std::cerr << "cache: corrupt result file returned" << std::endl;
+    rc = false;
+  }
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// identical concurrent runShared commands are run once, different ones and
+// later ones are run again
+bool
+checkShared()
+{
+  std::mutex            mutex;
+  std::set<std::string> outputs, otherOutputs;
+  std::atomic<int>      numShared { 0 };
+
+  auto runShared = [&](const std::string &cmd, std::set<std::string> &outs) {
+    CCommand command("sh", "sh", CCommand::Args({"-c", cmd}));
+
+    CCommandResult result;
+
+    if (CCommandMgrInst->runShared(&command, result))
+      ++numShared;
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    outs.insert(result.output);
+  };
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back(runShared, "sleep 0.3; echo $$", std::ref(outputs));
+
+  for (int i = 0; i < 2; ++i)
+    threads.emplace_back(runShared, "sleep 0.3; echo other $$", std::ref(otherOutputs));
+
+  for (auto &thread : threads)
+    thread.join();
+
+  // one run of each command (output is pid of shell)
+  bool rc = (outputs.size() == 1 && otherOutputs.size() == 1 && numShared == 8);
+
+  if (! rc)
+    std::cerr << "shared: " << numShared << " shared, " << outputs.size() << " and " <<
+                 otherOutputs.size() << " distinct outputs" << std::endl;
+
+  // finished command is not shared
+  std::set<std::string> laterOutputs;
+
+  runShared("sleep 0.3; echo $$", laterOutputs);
+
+  if (laterOutputs == outputs) {
+    std::cerr << "shared: finished command was shared" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// process state (from /proc/<pid>/stat, e.g. R, S, T or Z)
+std::string
+processState(pid_t pid)
+{
+  std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+
+  std::string id, name, state;
+
+  if (! (file >> id >> name >> state))
+    return "";
+
+  return state;
+}
+
+// process exists and is not a zombie
+bool
+isAlive(pid_t pid)
+{
+  auto state = processState(pid);
+
+  if (state == "")
+    return (kill(pid, 0) == 0);
+
+  return (state != "Z");
+}
+
+// slow command is hedged by a duplicate which wins, and the slow one (and
+// the process it started) is killed
+bool
+checkHedge()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string lockDir = std::string(dir) + "/lock";
+  std::string pidFile = std::string(dir) + "/pid";
+
+  // first copy takes lock and waits for background sleep, duplicate is fast
+  // (once sleep pid is recorded)
+  CCommand::Args args({"sh", "-c", "if mkdir " + lockDir + " 2>/dev/null; then "
+                       "sleep 30 & echo $! > " + pidFile + "; wait; else "
+                       "while [ ! -s " + pidFile + " ]; do sleep 0.01; done; fi; echo fast"});
+
+  bool rc = true;
+
+  // no hedge without latency history
+  CCommandHedger hedger;
+
+  hedger.setMinHistory(1);
+
+  CCommandResult result;
+
+  if (hedger.run(CCommand::Args({"sh", "-c", "echo first"}), result) ||
+      result.output != "first\n" || hedger.getNumHedged() != 0) {
+    std::cerr << "hedge: hedged without history" << std::endl;
+    rc = false;
+  }
+
+  hedger.clearHistory();
+
+  // hedge after 200ms
+  hedger.addLatency("sh", 0.2);
+
+  if (! hedger.run(args, result) || result.output != "fast\n" ||
+      hedger.getNumHedged() != 1 || hedger.getNumHedgeWins() != 1) {
+    std::cerr << "hedge: duplicate did not win '" << result.output << "'" << std::endl;
+    rc = false;
+  }
+
+  // loser's process group is killed (background sleep is reaped by init)
+  std::ifstream file(pidFile);
+
+  pid_t pid = 0;
+
+  if (! (file >> pid) || pid <= 0) {
+    std::cerr << "hedge: slow command did not start" << std::endl;
+    rc = false;
+  }
+  else {
+    bool alive = true;
+
+    for (int i = 0; i < 100 && alive; ++i) {
+      alive = isAlive(pid);
+
+      if (alive)
+        usleep(10000);
+    }
+
+    if (alive) {
+      std::cerr << "hedge: slow command child not killed" << std::endl;
+
+      kill(pid, SIGKILL);
+
+      rc = false;
+    }
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+// low priority commands (and processes they start) are paused while high
+// priority commands use their slots and resumed afterwards
+bool
+checkSched()
+{
+  char dir[] = "/tmp/CCommandCheckXXXXXX";
+
+  if (! mkdtemp(dir))
+    return false;
+
+  std::string pidFile = std::string(dir) + "/pid";
+
+  bool rc = true;
+
+  {
+  CCommandScheduler scheduler(2);
+
+  using Priority = CCommandScheduler::Priority;
+
+  CCommand low1("sh", "sh", CCommand::Args({"-c", "sleep 0.5 & echo $! > " + pidFile +
+                                             "; wait; echo low1"}));
+  CCommand low2("sh", "sh", CCommand::Args({"-c", "sleep 0.5; echo low2"}));
+
+  auto lowFuture1 = scheduler.submit(&low1, Priority::LOW, /*captureOutput*/true);
+  auto lowFuture2 = scheduler.submit(&low2, Priority::LOW, /*captureOutput*/true);
+
+  // wait for low priority commands to be running
+  pid_t pid = 0;
+
+  for (int i = 0; i < 500 && pid <= 0; ++i) {
+    std::ifstream file(pidFile);
+
+    if (! (file >> pid))
+      usleep(10000);
+  }
+
+  CCommand high1("sh", "sh", CCommand::Args({"-c", "sleep 0.5; echo high1"}));
+  CCommand high2("sh", "sh", CCommand::Args({"-c", "sleep 0.5; echo high2"}));
+
+  auto highFuture1 = scheduler.submit(&high1, Priority::HIGH, /*captureOutput*/true);
+  auto highFuture2 = scheduler.submit(&high2, Priority::HIGH, /*captureOutput*/true);
+
+  // both low priority commands and background sleep are stopped
+  bool stopped = false;
+
+  for (int i = 0; i < 100 && ! stopped; ++i) {
+    stopped = (pid > 0 && scheduler.getNumPaused() == 2 && processState(pid) == "T");
+
+    if (! stopped)
+      usleep(10000);
+  }
+
+  if (! stopped) {
+    std::cerr << "sched: low priority commands not paused" << std::endl;
+    rc = false;
+  }
+
+  auto lowResult1  = lowFuture1 .get();
+  auto lowResult2  = lowFuture2 .get();
+  auto highResult1 = highFuture1.get();
+  auto highResult2 = highFuture2.get();
+
+  if (lowResult1 .output != "low1\n"  || lowResult2 .output != "low2\n" ||
+      highResult1.output != "high1\n" || highResult2.output != "high2\n") {
+    std::cerr << "sched: bad output" << std::endl;
+    rc = false;
+  }
+
+  // low priority commands are not resumed until a high priority one finishes
+  // (sleep time has passed while paused so they then exit at once)
+  if (std::min(lowResult1.endTime, lowResult2.endTime) <
+      std::min(highResult1.endTime, highResult2.endTime)) {
+    std::cerr << "sched: low priority command finished first" << std::endl;
+    rc = false;
+  }
+
+  if (scheduler.getNumPreempted() != 2) {
+    std::cerr << "sched: " << scheduler.getNumPreempted() << " preempted" << std::endl;
+    rc = false;
+  }
+
+  // low priority command with builtin is run as a process (can be paused)
+  CCommandMgrInst->addBuiltin("wc", CCommandBuiltins::wc, CCommandBuiltins::wcCheck);
+
+  CCommand wc("wc", "wc", CCommand::Args({"-c"}));
+
+  wc.addStringSrc("abc");
+
+  auto wcResult = scheduler.submit(&wc, Priority::LOW, /*captureOutput*/true).get();
+
+  CCommandMgrInst->removeBuiltin("wc");
+
+  if (wc.isThread() || wc.getPid() <= 0 || wcResult.returnCode != 0) {
+    std::cerr << "sched: low priority builtin run on thread" << std::endl;
+    rc = false;
+  }
+  }
+
+  std::string rmCmd = std::string("rm -rf ") + dir;
+
+  if (system(rmCmd.c_str()) != 0)
+    rc = false;
+
+  return rc;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  bool rc = true;
+
+  if (argc < 2) {
+    for (const auto &check : checks)
+      if (! runCheck(check))
+        rc = false;
+
+    return (rc ? 0 : 1);
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    bool found = false;
+
+    for (const auto &check : checks) {
+      if (strcmp(argv[i], check.name) == 0) {
+        if (! runCheck(check))
+          rc = false;
+
+        found = true;
+      }
+    }
+
+    if (! found) {
+      std::cerr << "Invalid check " << argv[i] << std::endl;
+      rc = false;
+    }
+  }
+
+  return (rc ? 0 : 1);
+}
@@ -0,0 +1,283 @@
+#include <CCommandCoro.h>
+#include <CCommandMgr.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// Behavioural checks of the coroutine interface (run by 'make check', built
+// as C++20):
+//
+//   CCommandCoroCheck [<check> ...]
+//
+// Runs the named checks (all if none) and returns non-zero if any fail.
+
+#ifdef CCOMMAND_CORO
+
+namespace {
+
+bool checkResult();
+bool checkLines();
+bool checkTask();
+
+struct Check {
+  const char *name;
+  bool      (*proc)();
+};
+
+Check checks[] = {
+  { "result", checkResult },
+  { "lines" , checkLines  },
+  { "task"  , checkTask   },
+};
+
+bool
+runCheck(const Check &check)
+{
+  bool rc = false;
+
+  try {
+    rc = check.proc();
+  }
+  catch (...) {
+    std::cerr << check.name << ": exception" << std::endl;
+  }
+
+  std::cout << (rc ? "PASS " : "FAIL ") << check.name << std::endl;
+
+  return rc;
+}
+
+//---
+
+// output of 'seq 1 <n>'
+std::string
+seqOutput(int n)
+{
+  std::string str;
+
+  for (int i = 1; i <= n; ++i)
+    str += std::to_string(i) + "\n";
+
+  return str;
+}
+
+// run command and return its result (with captured output), args are
+// passed by value as the task runs after the caller's expression
+CCommandTask<CCommandResult>
+runCommand(CCommandExecutor &executor, CCommand::Args args)
+{
+  CCommand command(args[0], args[0], CCommand::Args(args.begin() + 1, args.end()));
+
+  CCommandAsync async(executor, command);
+
+  async.setCapture();
+
+  co_return co_await async.run();
+}
+
+// awaited results have exit status and captured output, commands awaited
+// by several tasks run at once
+bool
+checkResult()
+{
+  CCommandExecutor executor;
+
+  std::vector<CCommandTask<CCommandResult>> tasks;
+
+  for (int i = 0; i < 20; ++i)
+    tasks.push_back(runCommand(executor, CCommand::Args({"sh", "-c",
+      "sleep 0.2; seq 1 " + std::to_string(1000*i) + "; exit " + std::to_string(i % 3)})));
+
+  auto startTime = CCommandResult::Clock::now();
+
+  for (auto &task : tasks)
+    task.start();
+
+  executor.run();
+
+  double elapsed = std::chrono::duration<double>(CCommandResult::Clock::now() - startTime).count();
+
+  bool rc = true;
+
+  for (int i = 0; i < 20; ++i) {
+    auto &task = tasks[size_t(i)];
+
+    if (! task.done()) {
+      std::cerr << "result: task " << i << " not done" << std::endl;
+      rc = false;
+      continue;
+    }
+
+    auto result = task.result();
+
+    if (result.returnCode != i % 3 || result.output != seqOutput(1000*i) ||
+        result.endTime < result.startTime) {
+      std::cerr << "result: bad result for task " << i << std::endl;
+      rc = false;
+    }
+  }
+
+  if (elapsed > 2.0) {
+    std::cerr << "result: commands not run at once (" << elapsed << "s)" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// count lines of command output and check they are in order
+CCommandTask<int>
+countLines(CCommandExecutor &executor, CCommand::Args args, StringVectorT &lines)
+{
+  CCommand command(args[0], args[0], CCommand::Args(args.begin() + 1, args.end()));
+
+  CCommandLines commandLines(executor, command);
+  CCommandAsync async       (executor, command);
+
+  command.start();
+
+  while (auto line = co_await commandLines.next())
+    lines.push_back(*line);
+
+  auto result = co_await async.run();
+
+  co_return (result.isSuccess() ? int(lines.size()) : -1);
+}
+
+// awaited lines are all output lines in order (last without newline)
+bool
+checkLines()
+{
+  CCommandExecutor executor;
+
+  StringVectorT lines1, lines2;
+
+  auto task1 = countLines(executor, CCommand::Args({"seq", "1", "100000"}), lines1);
+  auto task2 = countLines(executor, CCommand::Args({"printf", "a\\n\\nb"}), lines2);
+
+  task1.start();
+  task2.start();
+
+  executor.run();
+
+  bool rc = true;
+
+  StringVectorT expected;
+
+  for (int i = 1; i <= 100000; ++i)
+    expected.push_back(std::to_string(i));
+
+  if (! task1.done() || task1.result() != 100000 || lines1 != expected) {
+    std::cerr << "lines: bad seq lines" << std::endl;
+    rc = false;
+  }
+
+  if (! task2.done() || task2.result() != 3 || lines2 != StringVectorT({"a", "", "b"})) {
+    std::cerr << "lines: bad partial last line" << std::endl;
+    rc = false;
+  }
+
+  return rc;
+}
+
+// run command and throw if it fails
+CCommandTask<std::string>
+checkedOutput(CCommandExecutor &executor, CCommand::Args args)
+{
+  auto result = co_await runCommand(executor, args);
+
+  if (! result.isSuccess())
+    throw std::runtime_error(args[0] + " failed");
+
+  co_return result.output;
+}
+
+// get output of a command and check failing command throws
+CCommandTask<>
+nestedTask(CCommandExecutor &executor, std::string &output, bool &thrown)
+{
+  // (args are not built in co_await expression, g++ 12 rejects initializer
+  // list temporaries there)
+  CCommand::Args echoArgs({"echo", "ok"}), falseArgs({"false"});
+
+  output = co_await checkedOutput(executor, echoArgs);
+
+  try {
+    co_await checkedOutput(executor, falseArgs);
+  }
+  catch (const std::runtime_error &) {
+    thrown = true;
+  }
+}
+
+// tasks awaiting tasks get their values (and exceptions)
+bool
+checkTask()
+{
+  CCommandExecutor executor;
+
+  std::string output;
+  bool        thrown = false;
+
+  auto task = nestedTask(executor, output, thrown);
+
+  task.start();
+
+  executor.run();
+
+  bool rc = (task.done() && output == "ok\n" && thrown);
+
+  if (! rc)
+    std::cerr << "task: bad nested task result '" << output << "'" << std::endl;
+
+  return rc;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  bool rc = true;
+
+  if (argc < 2) {
+    for (const auto &check : checks)
+      if (! runCheck(check))
+        rc = false;
+
+    return (rc ? 0 : 1);
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    bool found = false;
+
+    for (const auto &check : checks) {
+      if (strcmp(argv[i], check.name) == 0) {
+        if (! runCheck(check))
+          rc = false;
+
+        found = true;
+      }
+    }
+
+    if (! found) {
+      std::cerr << "Invalid check " << argv[i] << std::endl;
+      rc = false;
+    }
+  }
+
+  return (rc ? 0 : 1);
+}
+
+#else
+
+int
+main()
+{
+  std::cerr << "Coroutines not supported" << std::endl;
+
+  return 1;
+}
+
+#endif